@@ -7,30 +7,151 @@
 #include <stdbool.h>
 #include <math.h>
 #include <time.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #define MAX_WORDS 3000000
 #define MAX_WORD_LENGTH 50
 #define MAX_STOPWORDS 500
 #define MAX_TEXT_LENGTH 2000000
-#define MAX_VARIANTS 300
-#define MAX_TOXIC_WORDS 1000
-#define MAX_PHRASES 500
+#define VARIANT_INDEX_INITIAL 1024
+#define LEET_CACHE_SIZE 4096 // Direct-mapped, must be a power of two
+#define TOXIC_DICT_INITIAL 256 // Starting capacity of the word/phrase arrays (they double as needed)
 #define MAX_TEXT_LENGTH_ADV 50000
+#define TOXIC_BIN_MAGIC "TOXDICT"
+#define TOXIC_BIN_VERSION 1
+#define TOXIC_JOURNAL_COMPACT_AT 200 // Journal entries before the text file is rewritten
+#define TOKEN_NONE 0xFFFFFFFFu      // Token ID meaning "no token" / empty hash slot
+#define INTERN_INITIAL 4096         // Starting number of interned words (doubles as needed)
+#define SEARCH_MAX_SHOWN 50         // Matches listed by a vocabulary search (all are counted)
+#define KWIC_CONTEXT_DEFAULT 5      // Tokens shown on each side of a concordance hit
+#define KWIC_CONTEXT_MAX 50
+#define KWIC_MAX_WORDS 8            // Words in a concordance phrase query
+#define KWIC_LEFT_WIDTH 40          // Characters of left context (the hits line up after it)
+#define TOXIC_SENTENCES_TOP 10      // Most toxic sentences kept by the bounded heap
+#define TOXIC_SENTENCE_PREVIEW 100  // Characters of sentence text shown in rankings
+#define HOTSPOT_WINDOW_DEFAULT 50   // Tokens per window in the toxicity hotspot scan
+#define HOTSPOT_TOP_DEFAULT 5       // Hotspot windows reported (non-overlapping)
+#define HOTSPOT_TOP_MAX 20
+#define SEVERITY_CLASSES 7          // Scoring classes: 0 = clean, 1-5 = severity, 6 = toxic, no severity
+#define SEVERITY_LUT_PAD 3          // Gathers load 4 bytes, so the table runs 3 past the last ID
+#define STREAM_WINDOW_DEFAULT 10000 // Tokens in the sliding window (--window)
+#define STREAM_WINDOW_MAX 10000000
+#define STREAM_SNAPSHOT_DEFAULT 10000 // Tokens between snapshots (--every)
+#define STREAM_MAX_VOCAB 262144     // Distinct words tracked one by one; later new words only reach the totals
+#define STREAM_TOP_WORDS 5
+#define STREAM_BUFFER 8192
+#define CMS_WIDTH 4096              // Counters per sketch row, power of two (overcount <= e/width * total)
+#define CMS_DEPTH 4                 // Sketch rows (bound holds with probability 1 - e^-depth)
+#define APPROX_TOP_CAPACITY 256     // Heavy-hitter candidates kept by each Space-Saving summary
+#define METRICS_JSONL_PATH "metrics.jsonl" // One JSON object per run, appended
+#define HLL_PRECISION 12            // 2^12 one-byte registers, ~1.6% standard error
+#define BENCH_SIZES_DEFAULT "1,10,100,1000" // Corpus sizes in MB for --bench
+#define BENCH_MAX_SIZES 8
+#define BENCH_MAX_SIZE_MB 4096
+#define BENCH_VOCAB_DEFAULT 50000
+#define BENCH_ZIPF_DEFAULT 1.07
+#define BENCH_TOXIC_RATE_DEFAULT 0.02
+#define BENCH_WORD_LENGTH 16        // Buffer per generated word: at most 7 syllables (14 letters) + NUL
+#define BENCH_MAX_PAIRS 6000        // Same unique-word cap as the Stage 4 reports
+#define BENCH_RESULTS_PATH "bench_results.csv"
+#define BENCH_SORT_SIZES_DEFAULT "1000,10000,100000,1000000" // Pair counts for --bench-sort
+#define BENCH_SORT_MAX_N 10000000
+#define BENCH_SORT_REPS_DEFAULT 5
+#define BENCH_SORT_MAX_REPS 101
+#define BENCH_SORT_QUADRATIC_MAX 10000 // Largest n timed for O(n^2) cases
+#define BENCH_SORT_RESULTS_PATH "sort_bench.csv"
+#define AUTO_INSERTION_MAX 16        // ALG_AUTO: insertion sort at or below this n
+#define AUTO_RUN_RATIO 32           // ALG_AUTO: merge existing runs when runs <= 1 + n / ratio
+#define AUTO_COUNTING_RANGE_RATIO 4 // ALG_AUTO: counting sort when max - min count <= ratio * n
+#define TIM_MIN_GALLOP 7            // ALG_TIM: wins in a row before a merge starts galloping
+#define TIM_MAX_RUNS 64             // ALG_TIM: pending-run stack (powersort keeps it <= log2(n) + 1)
+#define VERIFY_RUNS_DEFAULT 20      // Fuzzed corpora checked by --verify
+#define VERIFY_SIZE_KB_DEFAULT 64
+#define VERIFY_VOCAB_DEFAULT 5000
+#define VERIFY_SEARCH_QUERIES 50    // Patterns checked against a linear scan per corpus
+#define VERIFY_HOTSPOT_WINDOWS 8    // Window sizes checked against direct sums per corpus
 
 #define ISALPHA(c) isalpha((unsigned char)(c))
 #define TOLOWER(c) tolower((unsigned char)(c))
 
 // ====== STAGE 2 DATA STRUCTURES ======
-// Stores a unique word and its frequency count
-struct WordInfo {
-    char word[MAX_WORD_LENGTH];
-    int count;
+// Token ID -> slot in a unique-word table. Entries are checked against the
+// table before use, so the map is never cleared between counting passes.
+struct IdSlotMap {
+    int* slot;
+    uint32_t cap;
+};
+
+// Unique words and their counts, one column per field. Frequency, toxicity
+// and density passes scan only the columns they need.
+struct VocabTable {
+    uint32_t* ids;            // Interned token ID per row
+    uint32_t* offsets;        // Offset of the word in the intern pool
+    int* counts;
+    unsigned char* toxic;     // Filled by vocab_mark_toxicity()
+    unsigned char* severity;  // 0 when not toxic
+    int size;
+    int capacity;
+    struct IdSlotMap rows;    // Token ID -> row
+};
+
+// Sorted views of a vocabulary for pattern search, built on first use
+struct VocabSearchIndex {
+    int* by_word;               // Rows in A-Z order
+    int* by_suffix;             // Rows in A-Z order of the reversed word
+    char* reversed;             // Reversed words, NUL-terminated
+    uint32_t* reversed_offset;  // Row -> offset in reversed
+    int size;
+    int built;                  // Cleared whenever the vocabulary is recounted
+};
+
+// Where each original token sits, built when a file is tokenised
+struct PositionIndex {
+    uint32_t* start;            // ID -> offset of its position list in gaps (ids + 1 entries)
+    int* freq;                  // ID -> occurrences
+    unsigned char* gaps;        // Varint gaps between positions; NULL = no index
+    uint32_t ids;               // IDs interned when the index was built
+    int* line_start;            // First token position of each line
+    int lines, line_cap;
+    int* sentence_start;        // First token position of each sentence
+    int* sentence_offset;       // Text offset where each sentence starts
+    int sentences, sentence_cap;
+    int* sentence_filtered;     // First filtered_word_ids position of each sentence
+    int sentence_filtered_cap;
+};
+
+// HyperLogLog distinct-word estimate in a fixed 4 KB
+struct HyperLogLog {
+    unsigned char registers[1 << HLL_PRECISION];
 };
 
 // Maps a non-standard word variant to a normalised base form
 struct VariantMap {
     char variant[MAX_WORD_LENGTH];
     char standard[MAX_WORD_LENGTH];
+    // Expansion pre-split at load time: parts holds the standard form with
+    // '\0' in place of spaces, part_offset[] marks where each token starts.
+    char parts[MAX_WORD_LENGTH];
+    unsigned char part_offset[MAX_WORD_LENGTH / 2];
+    int part_count;
+};
+
+// Memoised leetspeak decode of one raw token ("sh1t" -> "shit").
+// canonical is empty when the token does not decode to a dictionary word.
+struct LeetCacheEntry {
+    char word[MAX_WORD_LENGTH];
+    char canonical[MAX_WORD_LENGTH];
+    unsigned int generation; // Matches g_toxic_generation while still valid
 };
 // ========== END OF STAGE 2 STRUCTURES ==========
 
@@ -39,6 +160,60 @@ struct ToxicWord {
     char word[MAX_WORD_LENGTH];
     int severity; // 1-5 scale
     int frequency;
+    int fuzzy_frequency; // Near-miss spellings credited to this word
+};
+
+// Compiled dictionary file (toxicwords.bin) layout:
+//   header | entries[word_count + phrase_count] | word index | phrase index | string pool
+// Index slots hold an entry number (phrases numbered from 0) or 0xFFFFFFFF when empty,
+// so they can be copied straight into the in-memory int index.
+struct ToxicBinHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t word_count;
+    uint32_t phrase_count;
+    uint32_t word_index_size;
+    uint32_t phrase_index_size;
+    uint32_t pool_size;
+    uint32_t checksum; // FNV-1a over everything after the header
+};
+
+struct ToxicBinEntry {
+    uint32_t offset;   // Into the string pool
+    uint8_t severity;
+    uint8_t ngram_len;
+    uint16_t length;
+};
+
+// BK-tree node over the dictionary words (children linked as first-child/next-sibling)
+struct BKNode {
+    int word;         // Index into g_dict->words
+    int dist;         // Edit distance to the parent node
+    int first_child;
+    int next_sibling;
+};
+
+// Memoised fuzzy result for one distinct token
+struct FuzzyMemo {
+    char token[MAX_WORD_LENGTH];
+    int match;    // Index into g_dict->words, -1 if nothing within range
+    int distance;
+    int hits;     // Occurrences in the current analysis run
+};
+
+// Toxic words in one sentence, for the most-toxic-sentences ranking
+struct ToxicSentence {
+    int sentence;      // 0-based index into the position index's sentence tables
+    int toxic;         // Toxic words (filtered list)
+    int max_severity;  // 1-5, or 0 when no hit has a severity
+    int words;         // Filtered words in the sentence
+};
+
+// One window of the toxicity hotspot scan
+struct ToxicHotspot {
+    int start;  // First token of the window in the scored list
+    int toxic;  // Toxic words in the window
+    int score;  // Severity-weighted: levels 1-5, 1 for a toxic word without a level
 };
 
 struct ToxicPhrase {
@@ -47,13 +222,47 @@ struct ToxicPhrase {
     int frequency;
     int ngram_len; // 2 = bigram, 3 = trigram
 };
+
+// Dictionary verdict for one interned token, reused while stamp is current.
+struct TokenToxicity {
+    unsigned int stamp;  // Dictionary generation and leet setting it was resolved under (0 = never)
+    int severity;        // 1-5, or 0 when not toxic
+    int dict_index;      // Entry credited for a hit (leet spellings credit the decoded word), -1 if none
+    bool toxic;
+};
+
+// Toxic phrase keyed by the token IDs of its words (c is TOKEN_NONE for bigrams).
+struct NgramSlot {
+    uint32_t a, b, c;
+    int phrase;          // Index into the phrase list, -1 = empty slot
+};
+
+// The toxic dictionary shared by Stage 3 and Stage 4: entries plus lookup indexes.
+// Readers pin it with toxic_dict_acquire(); an edit made while it is pinned
+// goes to a private copy, so a pinned snapshot never changes underneath them.
+struct ToxicDictionary {
+    struct ToxicWord* words;      // Grows on demand
+    struct ToxicPhrase* phrases;
+    int word_count;
+    int phrase_count;
+    int word_capacity;
+    int phrase_capacity;
+    int* word_index;              // Hash slots into words (-1 = empty)
+    int word_index_size;
+    int* phrase_index;            // Hash slots into phrases
+    int phrase_index_size;
+    int* word_order;              // words indices in A-Z order (built on demand)
+    int refs;                     // Current-dictionary reference + one per reader
+};
 // ========== END OF STAGE 3 STRUCTURES ==========
 
 // ===== MASTER ANALYSIS DATA STRUCT =====
 struct AnalysisData {
     char* text;
-    struct WordInfo* words;
-    int word_count;
+    struct VocabTable vocab;             // Unique filtered words and counts
+    int vocab_dropped;                   // Tokens the full vocab table could not count
+    struct VocabSearchIndex search;      // Pattern search over vocab
+    struct HyperLogLog unique_estimate;  // Distinct filtered words, updated per token
     int total_words_filtered;
     int total_chars;
     int sentences;
@@ -61,41 +270,106 @@ struct AnalysisData {
     int total_words_original;
     char stopwords[MAX_STOPWORDS][MAX_WORD_LENGTH];
     int stop_count;
-    char** filtered_word_list;
+    uint32_t* filtered_word_ids;         // Token IDs after stopword/variant filtering
     int filtered_word_count;
-    struct VariantMap variant_mappings[MAX_VARIANTS];
+    struct VariantMap* variant_mappings; // Growable, kept in load order
     int variant_count;
+    int variant_capacity;
+    int* variant_index;                  // Open-addressing hash slots (-1 = empty)
+    int variant_index_size;              // Always a power of two
     bool variant_processing_enabled;
-    char** original_word_list;
+    bool leet_normalisation_enabled;
+    uint32_t* original_word_ids;         // Token IDs as read from the file
     int original_word_count;
+    struct PositionIndex positions;      // Positions of original_word_ids
     bool text_filtered;
 
     // ===== STAGE 3 TOXICITY FIELDS =====
-    struct ToxicWord toxic_words_list[MAX_TOXIC_WORDS];
-    struct ToxicPhrase toxic_phrases_list[MAX_PHRASES];
-    int toxic_words_count;
-    int toxic_phrases_count;
+    struct ToxicSentence top_sentences[TOXIC_SENTENCES_TOP]; // Most toxic first after a run
+    int top_sentence_count;
     int total_toxic_occurrences;
     int severity_count[6]; // 1-5 for severity levels
     float toxicity_density;
     int bigram_toxic_occurrences;
     int trigram_toxic_occurrences;
+    bool fuzzy_matching_enabled;
+    int fuzzy_max_distance;       // k for the bounded edit-distance search
+    int fuzzy_toxic_occurrences;  // Reported separately, not in the total
     // ===== END STAGE 3 =====
 };
 
 // ===== SORTING SUPPORT STRUCTS =====
 typedef enum { KEY_FREQ_DESC, KEY_ALPHA } SortKey;  //Sorting key: frequency descending or alphabetically
-typedef enum { ALG_BUBBLE, ALG_QUICK, ALG_MERGE } SortAlg;  //Sorting algorithm selector
+typedef enum { ALG_BUBBLE, ALG_QUICK, ALG_MERGE, ALG_TIM, ALG_AUTO } SortAlg;  //Sorting algorithm selector
+// What actually ran: the fixed algorithms, or the one ALG_AUTO picked
+typedef enum {
+    STRATEGY_BUBBLE, STRATEGY_QUICK, STRATEGY_MERGE, STRATEGY_TIM,
+    STRATEGY_INSERTION, STRATEGY_COUNTING, STRATEGY_INTROSORT,
+    STRATEGY_LAZY, // Alphabetical listing: pages settled on demand
+    STRATEGY_NONE  // No sort has run yet
+} SortStrategy;
 typedef struct {
-    char word[50];
+    uint32_t id;   // Interned token ID (token_text() for display)
     int  count;
 } Pair;
 typedef struct {
     long long comps;   // Comparison count
     long long moves;   // Swap
     double    ms;      // Elapsed time in ms
+    SortStrategy strategy; // Set by every sort_pairs() call
 } SortStats;
 
+// Pipeline stages timed by stage_begin()/stage_end()
+typedef enum {
+    STAGE_LOAD, STAGE_CORRUPTION_CHECK, STAGE_TOKENISE, STAGE_REPROCESS,
+    STAGE_TOXIC_SCAN, STAGE_PHRASES, STAGE_PAIRS, STAGE_SORT, STAGE_REPORT,
+    STAGE_COUNT
+} StageId;
+typedef struct {
+    long long calls;
+    double    ms;          // Wall time over all calls
+    double    last_ms;
+    long long bytes;       // Input bytes processed
+    long long tokens;      // Tokens processed
+    long long allocs;      // Heap allocations while this was the innermost stage
+    long long alloc_bytes;
+} StageMetrics;
+
+// Count-Min sketch: CMS_DEPTH rows of CMS_WIDTH counters. A word's estimate
+// is its smallest counter and never undercounts.
+struct CountMinSketch {
+    uint32_t* cells;   // Row-major, CMS_DEPTH * CMS_WIDTH
+    long long total;
+};
+
+// One Space-Saving candidate; its true count lies in [count - error, count]
+struct HeavyHitter {
+    char word[MAX_WORD_LENGTH];
+    unsigned int hash;
+    long long count;
+    long long error;
+};
+
+// Space-Saving top-k summary: a fixed set of candidates where a miss evicts
+// the current minimum. Any word seen more than total / capacity times is kept.
+struct SpaceSaving {
+    struct HeavyHitter* items;
+    int* heap;         // Min-heap of item indices by count
+    int* heap_pos;     // Item -> position in heap
+    int* index;        // Open addressing over items by word (-1 = empty)
+    int index_size;    // Power of two
+    int size;
+    int capacity;
+    long long total;
+};
+
+// Approximate frequencies for vocabularies that don't fit the exact tables
+struct ApproxCounter {
+    struct CountMinSketch sketch;
+    struct SpaceSaving all;
+    struct SpaceSaving toxic;
+};
+
 // ===== GLOBAL STATE VARIABLES =====
 struct AnalysisData analysis_data;
 //Currently active file name
@@ -103,16 +377,60 @@ char current_filename[256] = "";
 char current_manual_filtered_filename[256] = "";
 bool user_manually_saved_current_session = false;
 static int g_toxic_loaded = 0;
-static int g_toxic_count = 0;
-static char g_toxic[500][MAX_WORD_LENGTH];
+// The current toxic dictionary (starts as an empty, statically allocated one)
+static struct ToxicDictionary g_toxic_dict_initial = { .refs = 1 };
+static struct ToxicDictionary* g_dict = &g_toxic_dict_initial;
+// Bumped whenever the toxic dictionary changes so cached lookups are re-checked
+static unsigned int g_toxic_generation = 1;
+
+// Leetspeak normaliser state: character rule table and token cache
+static unsigned char g_leet_map[256];
+static struct LeetCacheEntry* g_leet_cache = NULL;
+
+// Fuzzy matching state: BK-tree over the dictionary and per-token memo table
+static struct BKNode* g_bk_nodes = NULL;
+static int g_bk_count = 0;
+static unsigned int g_bk_generation = 0;
+static struct FuzzyMemo* g_fuzzy_memo = NULL;
+static int g_fuzzy_memo_size = 0;  // Slots, power of two
+static int g_fuzzy_memo_count = 0;
+static unsigned int g_fuzzy_memo_generation = 0;
+
+// Token-ID lookups: per-ID toxic verdicts and the phrase n-gram table
+static struct TokenToxicity* g_token_toxicity = NULL;
+static uint32_t g_token_toxicity_cap = 0;
+static unsigned char* g_severity_lut = NULL;  // Token ID -> scoring class
+static uint32_t g_severity_lut_cap = 0;
+static uint32_t* g_toxic_ids = NULL;          // Word list being scored, as token IDs
+static int g_toxic_id_count = 0;              // Words in g_toxic_ids from the last toxic analysis
+static struct VocabTable g_toxic_vocab;       // Distinct words of that list
+static struct NgramSlot* g_ngram_slots = NULL;
+static int g_ngram_size = 0;  // Slots, power of two
+static unsigned int g_ngram_generation = 0;
+
+// Append-only edit journal for the toxic dictionary (replayed on load, compacted periodically)
+static char g_toxic_source_path[260] = "toxicwords.txt";
+static int g_toxic_journal_entries = 0;
+
+// String interner: each distinct word is stored once in g_intern_pool and
+// every stage refers to it by its 32-bit ID (index into g_intern_offset).
+static char* g_intern_pool = NULL;
+static size_t g_intern_pool_used = 0;
+static size_t g_intern_pool_cap = 0;
+static uint32_t* g_intern_offset = NULL;  // ID -> offset of the word in the pool
+static uint32_t* g_intern_hash = NULL;    // ID -> hash_string() of the word
+static uint32_t g_intern_count = 0;
+static uint32_t g_intern_cap = 0;
+static uint32_t* g_intern_slots = NULL;   // Open addressing over IDs (TOKEN_NONE = empty)
+static uint32_t g_intern_slots_size = 0;  // Power of two
 
 // Multi-file processing support
 char inputFilePath1[256];  
 char inputFilePath2[256];  
 char outputFilePath[256];
 
-char words1[MAX_WORDS][50];     // Token list for File 1
-char words2[MAX_WORDS][50];     // Token list for File 2
+uint32_t words1[MAX_WORDS];     // Token IDs for File 1
+uint32_t words2[MAX_WORDS];     // Token IDs for File 2
 
 int  wordCount1 = 0;       // Word count for File 1
 int  wordCount2 = 0;       // Word count for File 2
@@ -121,12 +439,24 @@ int  toxicCount = 0;       // Reserved for Stage 3 expansion
 bool file1Loaded = false;  // Whether File 1 has been loaded
 bool file2Loaded = false;  // Whether File 2 has been loaded
 
+// Last Stage 1 load of each file, for per-report throughput
+struct FileLoad {
+    long long bytes;
+    double ms;
+};
+static struct FileLoad g_file_load[2];  // File 1, File 2
+
 // Global sort configuration defaults
-static SortStats g_stats;
+static SortStats g_stats = { 0, 0, 0.0, STRATEGY_NONE };
 static SortKey g_key = KEY_FREQ_DESC;   
-static SortAlg g_alg = ALG_BUBBLE;       
+static SortAlg g_alg = ALG_AUTO;
+static const char* const g_sort_alg_names[] = { "Bubble", "Quick", "Merge", "Tim", "Auto" };
+static const char* const g_sort_strategy_names[] = {
+    "Bubble", "Quick", "Merge", "Tim", "Insertion", "Counting", "Introsort", "Lazy quicksort", "n/a"
+};
 static int     g_topN = 10;           
 static int g_use_secondary_tiebreak = 1; 
+static int g_use_approx = 0; // 1 = Top N from the sketch + Space-Saving summaries
 static int g_use_file = 1; // 1=File1, 2=File2
 
 // Reset sorting statistics
@@ -150,8 +480,98 @@ static inline double now_ms(void) {
     return 1000.0 * clock() / CLOCKS_PER_SEC;
 }
 
+// ----- Per-stage instrumentation -----
+static StageMetrics g_stage_metrics[STAGE_COUNT];
+static const char* const g_stage_names[STAGE_COUNT] = {
+    "loadTextFile", "isFileCorrupted", "Tokenisation", "reprocess_with_variants",
+    "run_toxic_analysis", "detect_toxic_phrases", "Pair building", "Sorting",
+    "write_full_report"
+};
+static StageId g_stage_stack[STAGE_COUNT];  // Stages in progress (they nest)
+static int g_stage_depth = 0;
+
+// Wall-clock milliseconds (now_ms() measures CPU time)
+static double wall_ms(void) {
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);  // Strict ISO C (-std=c11) and Windows
+#endif
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static double stage_begin(StageId s) {
+    if (g_stage_depth < STAGE_COUNT) g_stage_stack[g_stage_depth] = s;
+    g_stage_depth++;
+    return wall_ms();
+}
+
+static void stage_end(StageId s, double t0, long long bytes, long long tokens) {
+    StageMetrics* m = &g_stage_metrics[s];
+    m->last_ms = wall_ms() - t0;
+    m->ms += m->last_ms;
+    m->calls++;
+    m->bytes += bytes;
+    m->tokens += tokens;
+    if (g_stage_depth > 0) g_stage_depth--;
+}
+
+// Record a heap allocation against stage s
+static void stage_count_alloc_in(StageId s, size_t bytes) {
+    StageMetrics* m = &g_stage_metrics[s];
+    m->allocs++;
+    m->alloc_bytes += (long long)bytes;
+}
+
+// Record a heap allocation against the innermost running stage
+static void stage_count_alloc(size_t bytes) {
+    if (g_stage_depth <= 0 || g_stage_depth > STAGE_COUNT) return;
+    stage_count_alloc_in(g_stage_stack[g_stage_depth - 1], bytes);
+}
+
+// Allocators used throughout, so every successful allocation (a realloc
+// counts as one of its new size) shows up in the stage table
+static void* stage_malloc(size_t bytes) {
+    void* p = malloc(bytes);
+    if (p) stage_count_alloc(bytes);
+    return p;
+}
+
+static void* stage_calloc(size_t count, size_t size) {
+    void* p = calloc(count, size);
+    if (p) stage_count_alloc(count * size);
+    return p;
+}
+
+static void* stage_realloc(void* old, size_t bytes) {
+    void* p = realloc(old, bytes);
+    if (p) stage_count_alloc(bytes);
+    return p;
+}
+
+// Print the stage table: CSV rows for the report, aligned columns otherwise
+static void write_stage_metrics(FILE* out, bool csv) {
+    if (csv) {
+        fprintf(out, "Stage,Calls,Total ms,Last ms,Avg ms,Bytes,Tokens,Tokens/s,Allocs,Alloc bytes\n");
+    }
+    else {
+        fprintf(out, "%-24s|%6s|%11s|%10s|%10s|%11s|%10s|%11s|%7s|%12s\n", "Stage", "Calls", "Total ms",
+            "Last ms", "Avg ms", "Bytes", "Tokens", "Tokens/s", "Allocs", "Alloc bytes");
+    }
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        const StageMetrics* m = &g_stage_metrics[i];
+        double avg = m->calls ? m->ms / m->calls : 0.0;
+        double rate = m->ms > 0.0 ? m->tokens * 1000.0 / m->ms : 0.0;
+        fprintf(out, csv ? "%s,%lld,%.3f,%.3f,%.3f,%lld,%lld,%.0f,%lld,%lld\n"
+                         : "%-24s|%6lld|%11.3f|%10.3f|%10.3f|%11lld|%10lld|%11.0f|%7lld|%12lld\n",
+            g_stage_names[i], m->calls, m->ms, m->last_ms, avg,
+            m->bytes, m->tokens, rate, m->allocs, m->alloc_bytes);
+    }
+}
+
 // Select tokens from File 1 or File 2 depending on global state
-static void pick_tokens(char (**out_words)[50], int* out_count);
+static void pick_tokens(const uint32_t** out_words, int* out_count);
 
 // Remove leading/trailing whitespace from a string
 static void trim_inplace(char* s) {
@@ -193,21 +613,37 @@ void display_advanced_analysis_menu();
 void word_analysis();
 void save_filtered_word_list_auto(const char* filename);
 void save_filtered_word_list();
-void sort_by_frequency(struct WordInfo words[], int count);
+void search_vocabulary();
+void keyword_in_context();
+void toxicity_hotspots();
+int top_count_rows(const int* counts, int n, int k, int rows[]);
 void init_basic_variants();
 int load_variant_mappings(const char* filename);
 char* normalise_variant(char* word);
 void toggle_variant_processing();
 void reprocess_with_variants();
 void add_token_to_analysis(const char* tok, int* removed_by_stopwords);
+void init_leet_rules(void);
+static void fold_leet_symbols(char* s);
+static void sort_hints_free(void);
+static const char* leet_toxic_form(const char* word);
+static int int_list_push(int** list, int* count, int* cap, int v);
+static int position_mark_sentence(struct PositionIndex* pi, int token, int offset);
+static int* sentence_filtered_table(struct PositionIndex* pi);
+static int position_marks_advance(struct PositionIndex* pi, const char* text,
+    size_t* scan, size_t upto, int* in_sentence, int next_token);
+static int position_index_build(struct PositionIndex* pi, const uint32_t* ids, int n);
+static void position_index_free(struct PositionIndex* pi);
 // ========== END OF STAGE 2 FUNCTION DECLARATIONS ==========
 
 // ========== STAGE 3 FUNCTION DECLARATIONS ==========
 void load_toxic_data(const char* filename);
-void sync_toxic_systems(void);
 int is_toxic_word(const char* word);
+static int is_toxic_exact(const char* word);
 int get_toxic_severity(const char* word);
-void detect_toxic_content(const char* word);
+void detect_toxic_content(uint32_t id, int occurrences);
+static struct FuzzyMemo* fuzzy_toxic_lookup(const char* word);
+void toggle_fuzzy_matching(void);
 void detect_toxic_phrases();
 void run_toxic_analysis();
 void reset_toxic_counts();
@@ -219,6 +655,7 @@ void display_toxic_menu();
 void toxic_analysis();
 void dictionary_management();
 void save_toxic_dictionary(const char* filename);
+void compact_toxic_journal(void);
 void view_all_toxic_words();
 
 // Stage 3 utility functions
@@ -236,13 +673,12 @@ void handleError(const char* message);
 void showFileHistory(int fileNumber);
 void handleFileMenu();
 bool isCSVFile(const char* filename);
-void processCSVFile(FILE* f, char (*targetWords)[50], int* targetWordCount);
+void processCSVFile(FILE* f, uint32_t* targetWords, int* targetWordCount);
 bool isFileCorrupted(const char* filePath, const char* fileContent, size_t contentSize);
 
 // ====== Stage 4 FUNCTION DECLARATIONS ======
-static int  build_pairs_from_tokens(char (*words)[50], int wordCount, Pair out[], int maxOut);
+static int  build_pairs_from_tokens(const uint32_t* words, int wordCount, Pair out[], int maxOut);
 static void sort_pairs(Pair a[], int n, SortKey key, SortAlg alg);
-static int  load_toxicwords(void);
 void        menu_sort_and_report(void);
 static void merge_sort_pairs(Pair a[], int l, int r, SortKey key);
 void sort_and_show_topN_all(SortKey key, SortAlg alg, int topN);
@@ -340,6 +776,264 @@ int string_case_insensitive_compare(const char* s1, const char* s2) {
     return tolower((unsigned char)*s1) - tolower((unsigned char)*s2);
 }
 
+// FNV-1a hash of a NUL-terminated string, used by the hashed lookup tables.
+static unsigned int hash_string(const char* s) {
+    unsigned int h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// FNV-1a over a byte buffer (checksums for compiled files).
+static uint32_t hash_bytes(const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*)data;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// ----- String interner -----
+
+// Word for an interned ID. The pointer is only valid until the next intern_word().
+static inline const char* token_text(uint32_t id) {
+    return g_intern_pool + g_intern_offset[id];
+}
+
+static uint32_t intern_find_hashed(const char* s, unsigned int h) {
+    if (!g_intern_slots) return TOKEN_NONE;
+    uint32_t mask = g_intern_slots_size - 1;
+    for (uint32_t slot = h & mask; g_intern_slots[slot] != TOKEN_NONE; slot = (slot + 1) & mask) {
+        uint32_t id = g_intern_slots[slot];
+        if (g_intern_hash[id] == h && strcmp(token_text(id), s) == 0) return id;
+    }
+    return TOKEN_NONE;
+}
+
+// Double the slot array, reinserting IDs from their cached hashes.
+static int intern_grow_slots(void) {
+    uint32_t new_size = g_intern_slots_size ? g_intern_slots_size * 2 : INTERN_INITIAL * 2;
+    uint32_t* slots = (uint32_t*)stage_malloc(sizeof(uint32_t) * new_size);
+    if (!slots) return 0;
+    memset(slots, 0xff, sizeof(uint32_t) * new_size);
+
+    uint32_t mask = new_size - 1;
+    for (uint32_t id = 0; id < g_intern_count; id++) {
+        uint32_t slot = g_intern_hash[id] & mask;
+        while (slots[slot] != TOKEN_NONE) slot = (slot + 1) & mask;
+        slots[slot] = id;
+    }
+    free(g_intern_slots);
+    g_intern_slots = slots;
+    g_intern_slots_size = new_size;
+    return 1;
+}
+
+// Return the ID of s, adding it on first sight. TOKEN_NONE if out of memory.
+static uint32_t intern_word(const char* s) {
+    unsigned int h = hash_string(s);
+    uint32_t id = intern_find_hashed(s, h);
+    if (id != TOKEN_NONE) return id;
+
+    if ((g_intern_count + 1) * 2 > g_intern_slots_size && !intern_grow_slots()) {
+        printf("Error: Memory allocation failed (interner)\n");
+        return TOKEN_NONE;
+    }
+    if (g_intern_count == g_intern_cap) {
+        uint32_t new_cap = g_intern_cap ? g_intern_cap * 2 : INTERN_INITIAL;
+        uint32_t* offsets = (uint32_t*)stage_realloc(g_intern_offset, sizeof(uint32_t) * new_cap);
+        if (offsets) g_intern_offset = offsets;
+        uint32_t* hashes = (uint32_t*)stage_realloc(g_intern_hash, sizeof(uint32_t) * new_cap);
+        if (hashes) g_intern_hash = hashes;
+        if (!offsets || !hashes) {
+            printf("Error: Memory allocation failed (interner)\n");
+            return TOKEN_NONE;
+        }
+        g_intern_cap = new_cap;
+    }
+    size_t len = strlen(s) + 1;
+    if (g_intern_pool_used + len > g_intern_pool_cap) {
+        size_t new_cap = g_intern_pool_cap ? g_intern_pool_cap : (size_t)INTERN_INITIAL * 8;
+        while (new_cap < g_intern_pool_used + len) new_cap *= 2;
+        char* pool = (char*)stage_realloc(g_intern_pool, new_cap);
+        if (!pool) {
+            printf("Error: Memory allocation failed (interner)\n");
+            return TOKEN_NONE;
+        }
+        g_intern_pool = pool;
+        g_intern_pool_cap = new_cap;
+    }
+
+    id = g_intern_count++;
+    g_intern_offset[id] = (uint32_t)g_intern_pool_used;
+    g_intern_hash[id] = h;
+    memcpy(g_intern_pool + g_intern_pool_used, s, len);
+    g_intern_pool_used += len;
+
+    uint32_t mask = g_intern_slots_size - 1;
+    uint32_t slot = h & mask;
+    while (g_intern_slots[slot] != TOKEN_NONE) slot = (slot + 1) & mask;
+    g_intern_slots[slot] = id;
+    return id;
+}
+
+// Release all interned words (IDs become invalid).
+static void free_interner(void) {
+    free(g_intern_pool);
+    free(g_intern_offset);
+    free(g_intern_hash);
+    free(g_intern_slots);
+    g_intern_pool = NULL;
+    g_intern_offset = g_intern_hash = g_intern_slots = NULL;
+    g_intern_pool_used = g_intern_pool_cap = 0;
+    g_intern_count = g_intern_cap = g_intern_slots_size = 0;
+}
+
+// Renumber the interner so it holds only the words in the given ID lists,
+// rewriting the lists in place. Returns 0 if out of memory; the old IDs then
+// stay valid.
+static int intern_compact(uint32_t* const lists[], const int counts[], int n_lists) {
+    uint32_t old_count = g_intern_count;
+    uint32_t* remap = (uint32_t*)stage_malloc(sizeof(uint32_t) * (old_count + 1));
+    if (!remap) return 0;
+    memset(remap, 0xff, sizeof(uint32_t) * (old_count + 1));
+
+    char* old_pool = g_intern_pool;
+    size_t old_pool_used = g_intern_pool_used, old_pool_cap = g_intern_pool_cap;
+    uint32_t* old_offset = g_intern_offset;
+    uint32_t* old_hash = g_intern_hash;
+    uint32_t* old_slots = g_intern_slots;
+    uint32_t old_cap = g_intern_cap, old_slots_size = g_intern_slots_size;
+    g_intern_pool = NULL;
+    g_intern_offset = g_intern_hash = g_intern_slots = NULL;
+    g_intern_pool_used = g_intern_pool_cap = 0;
+    g_intern_count = g_intern_cap = g_intern_slots_size = 0;
+
+    // New IDs in order of first use; the lists are only rewritten once all fit
+    for (int l = 0; l < n_lists; l++) {
+        for (int i = 0; i < counts[l]; i++) {
+            uint32_t id = lists[l][i];
+            if (id >= old_count || remap[id] != TOKEN_NONE) continue;
+            remap[id] = intern_word(old_pool + old_offset[id]);
+            if (remap[id] == TOKEN_NONE) {
+                free_interner();
+                g_intern_pool = old_pool;
+                g_intern_pool_used = old_pool_used;
+                g_intern_pool_cap = old_pool_cap;
+                g_intern_offset = old_offset;
+                g_intern_hash = old_hash;
+                g_intern_slots = old_slots;
+                g_intern_count = old_count;
+                g_intern_cap = old_cap;
+                g_intern_slots_size = old_slots_size;
+                free(remap);
+                return 0;
+            }
+        }
+    }
+    for (int l = 0; l < n_lists; l++) {
+        for (int i = 0; i < counts[l]; i++) {
+            if (lists[l][i] < old_count) lists[l][i] = remap[lists[l][i]];
+        }
+    }
+    free(old_pool);
+    free(old_offset);
+    free(old_hash);
+    free(old_slots);
+    free(remap);
+    return 1;
+}
+
+// Slot reference for id, growing the map to cover every interned ID.
+// New entries read as -1. Returns NULL if out of memory.
+static int* id_slot_ref(struct IdSlotMap* m, uint32_t id) {
+    if (id >= m->cap) {
+        uint32_t new_cap = m->cap ? m->cap : INTERN_INITIAL;
+        while (new_cap <= id || new_cap < g_intern_count) new_cap *= 2;
+        int* grown = (int*)stage_realloc(m->slot, sizeof(int) * new_cap);
+        if (!grown) return NULL;
+        memset(grown + m->cap, 0xff, sizeof(int) * (new_cap - m->cap));
+        m->slot = grown;
+        m->cap = new_cap;
+    }
+    return &m->slot[id];
+}
+
+// ----- Vocabulary table (one column per field) -----
+
+// Grow every column to hold at least need rows. Returns 0 if out of memory.
+static int vocab_reserve(struct VocabTable* v, int need) {
+    if (need <= v->capacity) return 1;
+    int new_cap = v->capacity ? v->capacity : INTERN_INITIAL;
+    while (new_cap < need) new_cap *= 2;
+
+    // Columns that did grow are kept; capacity only moves once all have
+    uint32_t* ids = (uint32_t*)stage_realloc(v->ids, sizeof(uint32_t) * new_cap);
+    if (ids) v->ids = ids;
+    uint32_t* offsets = (uint32_t*)stage_realloc(v->offsets, sizeof(uint32_t) * new_cap);
+    if (offsets) v->offsets = offsets;
+    int* counts = (int*)stage_realloc(v->counts, sizeof(int) * new_cap);
+    if (counts) v->counts = counts;
+    unsigned char* toxic = (unsigned char*)stage_realloc(v->toxic, new_cap);
+    if (toxic) v->toxic = toxic;
+    unsigned char* severity = (unsigned char*)stage_realloc(v->severity, new_cap);
+    if (severity) v->severity = severity;
+    if (!ids || !offsets || !counts || !toxic || !severity) return 0;
+
+    v->capacity = new_cap;
+    return 1;
+}
+
+// Add n occurrences of id. Returns the row, or -1 if a new row would pass
+// max_rows or memory ran out.
+static int vocab_add(struct VocabTable* v, uint32_t id, int n, int max_rows) {
+    int* slot = id_slot_ref(&v->rows, id);
+    if (!slot) return -1;
+    int r = *slot;
+    if (r >= 0 && r < v->size && v->ids[r] == id) {
+        v->counts[r] += n;
+        return r;
+    }
+    if (v->size >= max_rows || !vocab_reserve(v, v->size + 1)) return -1;
+
+    r = v->size++;
+    *slot = r;
+    v->ids[r] = id;
+    v->offsets[r] = g_intern_offset[id];
+    v->counts[r] = n;
+    v->toxic[r] = 0;
+    v->severity[r] = 0;
+    return r;
+}
+
+// Rebuild v from a token-ID list, stopping at the first token that would
+// need a row beyond max_rows. Returns the number of rows.
+static int vocab_count_tokens(struct VocabTable* v, const uint32_t* ids, int n, int max_rows) {
+    v->size = 0;
+    for (int i = 0; i < n; i++) {
+        if (vocab_add(v, ids[i], 1, max_rows) < 0) break;
+    }
+    return v->size;
+}
+
+static inline const char* vocab_text(const struct VocabTable* v, int row) {
+    return g_intern_pool + v->offsets[row];
+}
+
+static void vocab_free(struct VocabTable* v) {
+    free(v->ids);
+    free(v->offsets);
+    free(v->counts);
+    free(v->toxic);
+    free(v->severity);
+    free(v->rows.slot);
+    memset(v, 0, sizeof(*v));
+}
+
 // Check whether a file can be opened for reading.
 // Returns true if the file exists.
 bool file_exists(const char* filename) {
@@ -399,31 +1093,61 @@ static FILE* open_file_read(const char* pathIn) {
     return f;
 }
 
-// Allocate a MAX_WORDS x MAX_WORD_LENGTH string table
-static int alloc_string_table(char*** table) {
+// Modification time of a file, or 0 if it does not exist.
+static time_t file_mtime(const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+    return st.st_mtime;
+}
+
+// Map a whole file read-only (mmap on POSIX, a heap copy on Windows).
+// Returns NULL on failure; release with unmap_file.
+static void* map_file_readonly(const char* path, size_t* out_size) {
+#ifdef _WIN32
+    FILE* f = fopen_u8(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size <= 0) { fclose(f); return NULL; }
+    void* buf = stage_malloc((size_t)size);
+    if (buf && fread(buf, 1, (size_t)size, f) != (size_t)size) { free(buf); buf = NULL; }
+    fclose(f);
+    if (buf) *out_size = (size_t)size;
+    return buf;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) { close(fd); return NULL; }
+    void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return NULL;
+    *out_size = (size_t)st.st_size;
+    return p;
+#endif
+}
+
+static void unmap_file(void* p, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    free(p);
+#else
+    munmap(p, size);
+#endif
+}
+
+// Allocate a MAX_WORDS token-ID table (no-op if already allocated).
+static int alloc_id_table(uint32_t** table) {
     if (*table != NULL) {
         return 1;
     }
 
-    *table = (char**)calloc(MAX_WORDS, sizeof(char*));
+    *table = (uint32_t*)stage_calloc(MAX_WORDS, sizeof(uint32_t));
     if (!*table) {
         printf("Error: Memory allocation failed (table)\n");
         return 0;
     }
-
-    for (int i = 0; i < MAX_WORDS; i++) {
-        (*table)[i] = (char*)malloc(MAX_WORD_LENGTH);
-        if (!(*table)[i]) {
-            printf("Error: Memory allocation failed (row %d)\n", i);
-            // Free already allocated rows on failure
-            for (int j = 0; j < i; j++) {
-                free((*table)[j]);
-            }
-            free(*table);
-            *table = NULL;
-            return 0;
-        }
-    }
     return 1;
 }
 
@@ -446,7 +1170,7 @@ bool isCSVFile(const char* filename) {
 }
 
 // Parse a CSV file, normalize each column, and tokenise into words.
-void processCSVFile(FILE* f, char (*targetWords)[50], int* targetWordCount) {
+void processCSVFile(FILE* f, uint32_t* targetWords, int* targetWordCount) {
     char line[4096];
     int columnCount = 0;
     char* columns[100]; // Assume at most 100 columns per row.
@@ -473,6 +1197,7 @@ void processCSVFile(FILE* f, char (*targetWords)[50], int* targetWordCount) {
             columnText[sizeof(columnText) - 1] = '\0';
 
             // Normalise the text (e.g. lowercasing, stripping punctuation, etc.).
+            fold_leet_symbols(columnText);
             normalize_line(columnText);
 
             // Tokenise the normalised text into individual words.
@@ -480,8 +1205,8 @@ void processCSVFile(FILE* f, char (*targetWords)[50], int* targetWordCount) {
             while (word != NULL && *targetWordCount < MAX_WORDS) {
                 size_t wordLen = strlen(word);
                 if (wordLen > 0 && wordLen < 50) {
-                    strcpy(targetWords[*targetWordCount], word);
-                    (*targetWordCount)++;
+                    uint32_t id = intern_word(word);
+                    if (id != TOKEN_NONE) targetWords[(*targetWordCount)++] = id;
                 }
                 word = strtok(NULL, " \t\r\n");
             }
@@ -588,9 +1313,10 @@ bool isFileCorrupted(const char* filePath, const char* fileContent, size_t conte
 }
 
 //Updated: Load Text File Function (Supports CSV and corrupted file detection)
-void loadTextFile(int fileNumber) {
+// Load and tokenise one input file; returns the bytes it read.
+static long load_text_file(int fileNumber) {
     char* filePath = (fileNumber == 1) ? inputFilePath1 : inputFilePath2;
-    char (*targetWords)[50] = (fileNumber == 1) ? words1 : words2;
+    uint32_t* targetWords = (fileNumber == 1) ? words1 : words2;
     int* targetWordCount = (fileNumber == 1) ? &wordCount1 : &wordCount2;
     bool* targetFileLoaded = (fileNumber == 1) ? &file1Loaded : &file2Loaded;
 
@@ -603,7 +1329,7 @@ void loadTextFile(int fileNumber) {
         printf("Recovery Guide:\n");
         printf("1. Make sure the file name is correct\n");
         printf("2. Move the file to the same directory as this program\n");
-        return;
+        return 0;
     }
 
     // Important: once the file opens successfully, clean the global filePath (remove quotes and trailing problematic characters).
@@ -630,21 +1356,24 @@ void loadTextFile(int fileNumber) {
         printf("Please load a file with text content.\n");
         fclose(f);
         *targetFileLoaded = false;
-        return;
+        return 0;
     }
 
     if (fileSize > 0) {
-        char* fileContent = (char*)malloc(fileSize + 1);
+        char* fileContent = (char*)stage_malloc(fileSize + 1);
         if (fileContent) {
             size_t bytesRead = fread(fileContent, 1, fileSize, f);
             fileContent[bytesRead] = '\0';
 
             // Detect if file is corrupted or empty
-            if (isFileCorrupted(cleanPath, fileContent, bytesRead)) {
+            double t0 = stage_begin(STAGE_CORRUPTION_CHECK);
+            bool corrupted = isFileCorrupted(cleanPath, fileContent, bytesRead);
+            stage_end(STAGE_CORRUPTION_CHECK, t0, (long long)bytesRead, 0);
+            if (corrupted) {
                 free(fileContent);
                 fclose(f);
                 *targetFileLoaded = false;
-                return; // Stop loading corrupted/empty file
+                return fileSize; // Stop loading corrupted/empty file
             }
 
             free(fileContent);
@@ -663,14 +1392,15 @@ void loadTextFile(int fileNumber) {
         printf("Detected text file format: processing as text...\n");
         char line[4096];
         while (fgets(line, sizeof(line), f)) {
+            fold_leet_symbols(line);
             normalize_line(line); // Lowercase + non-alphanumeric = space
             char* tok = strtok(line, " \t\r\n");
             while (tok) {
                 size_t L = strlen(tok);
-                if (L > 0 && L < sizeof(targetWords[0])) {
+                if (L > 0 && L < 50) {
                     if (*targetWordCount < MAX_WORDS) {
-                        strcpy(targetWords[*targetWordCount], tok);
-                        (*targetWordCount)++;
+                        uint32_t id = intern_word(tok);
+                        if (id != TOKEN_NONE) targetWords[(*targetWordCount)++] = id;
                     }
                     else {
                         printf("[!] Warning: Reached maximum token limit.\n");
@@ -692,6 +1422,15 @@ void loadTextFile(int fileNumber) {
         *targetFileLoaded = true;
         printf("Loaded %d tokens from File %d.\n", *targetWordCount, fileNumber);
     }
+    return fileSize;
+}
+
+void loadTextFile(int fileNumber) {
+    double t0 = stage_begin(STAGE_LOAD);
+    long bytes = load_text_file(fileNumber);
+    stage_end(STAGE_LOAD, t0, bytes, (fileNumber == 1) ? wordCount1 : wordCount2);
+    g_file_load[fileNumber - 1].bytes = bytes;
+    g_file_load[fileNumber - 1].ms = g_stage_metrics[STAGE_LOAD].last_ms;
 }
 
 //Handle the file management submenu : loading files and viewing file history.
@@ -808,11 +1547,11 @@ void showFileHistory(int fileNumber) {
     printf("Total words loaded: %d\n", wordCount);
 
     //  Display the first 10 words as a preview sample.
-    char (*words)[50] = (fileNumber == 1) ? words1 : words2;
+    const uint32_t* words = (fileNumber == 1) ? words1 : words2;
     int sampleCount = (wordCount < 10) ? wordCount : 10;
     printf("Sample words (%d): ", sampleCount);
     for (int i = 0; i < sampleCount; i++) {
-        printf("%s", words[i]);
+        printf("%s", token_text(words[i]));
         if (i < sampleCount - 1) printf(", ");
     }
     printf("\n");
@@ -871,7 +1610,7 @@ void prompt_change_source_file(void) {
 }
 
 // Pick the currently active token buffer (File 1 or File 2) based on global flags.
-static void pick_tokens(char (**out_words)[50], int* out_count) {
+static void pick_tokens(const uint32_t** out_words, int* out_count) {
     if (g_use_file == 1 && file1Loaded) { *out_words = words1; *out_count = wordCount1; return; }
     if (g_use_file == 2 && file2Loaded) { *out_words = words2; *out_count = wordCount2; return; }
     // Auto mode: fall back to the default priority (prefer File 1 if available, otherwise File 2).
@@ -923,6 +1662,94 @@ int is_stopword(char* word, char stopwords[][MAX_WORD_LENGTH], int stop_count) {
     return 0;
 }
 
+// Find the slot index of a variant in the mapping table, or -1 if absent
+static int find_variant_index(const char* word) {
+    if (analysis_data.variant_index == NULL) return -1;
+
+    unsigned int mask = (unsigned int)analysis_data.variant_index_size - 1;
+    unsigned int slot = hash_string(word) & mask;
+    while (analysis_data.variant_index[slot] != -1) {
+        int idx = analysis_data.variant_index[slot];
+        if (strcmp(analysis_data.variant_mappings[idx].variant, word) == 0) {
+            return idx;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+// Double the hash index and re-insert every mapping (keeps load factor <= 0.5)
+static int grow_variant_index(void) {
+    int new_size = analysis_data.variant_index_size ? analysis_data.variant_index_size * 2 : VARIANT_INDEX_INITIAL;
+    int* slots = (int*)stage_malloc(sizeof(int) * new_size);
+    if (!slots) {
+        printf("Error: Memory allocation failed (variant index)\n");
+        return 0;
+    }
+    memset(slots, 0xff, sizeof(int) * new_size); // every slot = -1
+
+    unsigned int mask = (unsigned int)new_size - 1;
+    for (int i = 0; i < analysis_data.variant_count; i++) {
+        unsigned int slot = hash_string(analysis_data.variant_mappings[i].variant) & mask;
+        while (slots[slot] != -1) slot = (slot + 1) & mask;
+        slots[slot] = i;
+    }
+
+    free(analysis_data.variant_index);
+    analysis_data.variant_index = slots;
+    analysis_data.variant_index_size = new_size;
+    return 1;
+}
+
+// Add one variant -> standard mapping, pre-splitting multi-word expansions.
+// Returns 1 if stored, 0 if it was a duplicate (first mapping wins) or on error.
+static int add_variant_mapping(const char* variant, const char* standard) {
+    if (find_variant_index(variant) != -1) return 0;
+
+    if ((analysis_data.variant_count + 1) * 2 > analysis_data.variant_index_size) {
+        if (!grow_variant_index()) return 0;
+    }
+    if (analysis_data.variant_count >= analysis_data.variant_capacity) {
+        int new_cap = analysis_data.variant_capacity ? analysis_data.variant_capacity * 2 : 256;
+        struct VariantMap* grown = (struct VariantMap*)stage_realloc(analysis_data.variant_mappings,
+            sizeof(struct VariantMap) * new_cap);
+        if (!grown) {
+            printf("Error: Memory allocation failed (variant mappings)\n");
+            return 0;
+        }
+        analysis_data.variant_mappings = grown;
+        analysis_data.variant_capacity = new_cap;
+    }
+
+    struct VariantMap* vm = &analysis_data.variant_mappings[analysis_data.variant_count];
+    strncpy(vm->variant, variant, MAX_WORD_LENGTH - 1);
+    vm->variant[MAX_WORD_LENGTH - 1] = '\0';
+    strncpy(vm->standard, standard, MAX_WORD_LENGTH - 1);
+    vm->standard[MAX_WORD_LENGTH - 1] = '\0';
+
+    // Split the expansion once here so reprocessing never re-tokenises it.
+    // Parts without letters are dropped, matching the filtering in reprocess_with_variants.
+    memcpy(vm->parts, vm->standard, MAX_WORD_LENGTH);
+    vm->part_count = 0;
+    for (int i = 0; vm->parts[i]; ) {
+        if (vm->parts[i] == ' ') { vm->parts[i++] = '\0'; continue; }
+        int start = i, has_letters = 0;
+        while (vm->parts[i] && vm->parts[i] != ' ') {
+            if (ISALPHA(vm->parts[i])) has_letters = 1;
+            i++;
+        }
+        if (has_letters) vm->part_offset[vm->part_count++] = (unsigned char)start;
+    }
+
+    unsigned int mask = (unsigned int)analysis_data.variant_index_size - 1;
+    unsigned int slot = hash_string(vm->variant) & mask;
+    while (analysis_data.variant_index[slot] != -1) slot = (slot + 1) & mask;
+    analysis_data.variant_index[slot] = analysis_data.variant_count;
+
+    analysis_data.variant_count++;
+    return 1;
+}
+
 // Initialise core variant mappings
 void init_basic_variants() {
     // Keep only essential core mappings; others live in the external file
@@ -936,15 +1763,13 @@ void init_basic_variants() {
     };
 
     int num_core = sizeof(core_mappings) / sizeof(core_mappings[0]);
-    for (int i = 0; i < num_core && analysis_data.variant_count < MAX_VARIANTS; i++) {
-        strcpy(analysis_data.variant_mappings[analysis_data.variant_count].variant, core_mappings[i][0]);
-        strcpy(analysis_data.variant_mappings[analysis_data.variant_count].standard, core_mappings[i][1]);
-        analysis_data.variant_count++;
+    for (int i = 0; i < num_core; i++) {
+        add_variant_mapping(core_mappings[i][0], core_mappings[i][1]);
     }
     // Load additional mappings from file
     int loaded = load_variant_mappings("variant_mappings.txt");
-    printf("Initialised %d core variants + loaded %d mappings from file (total %d, limit %d)\n",
-        num_core, loaded, analysis_data.variant_count, MAX_VARIANTS);
+    printf("Initialised %d core variants + loaded %d mappings from file (total %d)\n",
+        num_core, loaded, analysis_data.variant_count);
 }
 
 // Load extra variant mappings from a key=value text file
@@ -957,7 +1782,7 @@ int load_variant_mappings(const char* filename) {
     int loaded = 0;
     char line[256];
 
-    while (fgets(line, sizeof(line), file) && analysis_data.variant_count < MAX_VARIANTS) {
+    while (fgets(line, sizeof(line), file)) {
         if (line[0] == '\n' || line[0] == '#' || line[0] == '\r') {
             continue;
         }
@@ -990,16 +1815,7 @@ int load_variant_mappings(const char* filename) {
         while (end > standard && *end == ' ') *end-- = '\0';
 
         if (strlen(variant) > 0 && strlen(standard) > 0) {
-            strncpy(analysis_data.variant_mappings[analysis_data.variant_count].variant,
-                variant, MAX_WORD_LENGTH - 1);
-            strncpy(analysis_data.variant_mappings[analysis_data.variant_count].standard,
-                standard, MAX_WORD_LENGTH - 1);
-
-            analysis_data.variant_mappings[analysis_data.variant_count].variant[MAX_WORD_LENGTH - 1] = '\0';
-            analysis_data.variant_mappings[analysis_data.variant_count].standard[MAX_WORD_LENGTH - 1] = '\0';
-
-            analysis_data.variant_count++;
-            loaded++;
+            loaded += add_variant_mapping(variant, standard);
         }
     }
 
@@ -1007,18 +1823,138 @@ int load_variant_mappings(const char* filename) {
     return loaded;
 }
 
+// Look up the mapping for a word if normalisation is enabled (NULL if none)
+static const struct VariantMap* lookup_variant(const char* word) {
+    if (!analysis_data.variant_processing_enabled) {
+        return NULL;
+    }
+    int idx = find_variant_index(word);
+    return (idx == -1) ? NULL : &analysis_data.variant_mappings[idx];
+}
+
 // Normalise a word using the variant mapping table if enabled
 char* normalise_variant(char* word) {
-    if (!analysis_data.variant_processing_enabled) {
-        return word;
+    const struct VariantMap* vm = lookup_variant(word);
+    return vm ? (char*)vm->standard : word;
+}
+
+// Build the character substitution table used by the leetspeak normaliser.
+// Letters map to lowercase, listed digits/symbols to the letter they imitate.
+void init_leet_rules(void) {
+    static const char rules[][2] = {
+        {'0', 'o'}, {'1', 'i'}, {'3', 'e'}, {'4', 'a'}, {'5', 's'},
+        {'7', 't'}, {'8', 'b'}, {'9', 'g'}, {'@', 'a'}, {'$', 's'},
+        {'!', 'i'}, {'|', 'l'}
+    };
+
+    for (int c = 0; c < 256; c++) {
+        g_leet_map[c] = (unsigned char)TOLOWER(c);
     }
+    for (size_t i = 0; i < sizeof(rules) / sizeof(rules[0]); i++) {
+        g_leet_map[(unsigned char)rules[i][0]] = (unsigned char)rules[i][1];
+    }
+    analysis_data.leet_normalisation_enabled = true;
+}
 
-    for (int i = 0; i < analysis_data.variant_count; i++) {
-        if (strcmp(word, analysis_data.variant_mappings[i].variant) == 0) {
-            return analysis_data.variant_mappings[i].standard;
+// Whether s[i] is a leet symbol in a position where it may stand for a letter:
+// '$' before a letter, at the start of a word or inside one; '@', '!' and '|'
+// only between letters or digits ('@user' stays a mention, "$100" a price).
+static bool leet_symbol_at(const char* s, size_t i) {
+    char c = s[i];
+    if (c != '$' && c != '@' && c != '!' && c != '|') return false;
+    bool prev_alnum = (i > 0 && isalnum((unsigned char)s[i - 1]));
+    if (c == '$') {
+        bool prev_boundary = (i == 0 || isspace((unsigned char)s[i - 1]));
+        return isalpha((unsigned char)s[i + 1]) && (prev_alnum || prev_boundary);
+    }
+    return prev_alnum && isalnum((unsigned char)s[i + 1]);
+}
+
+
+// Turn leet symbols that sit inside a word into letters before the text is
+// split on DELIMS, so "$hit" or "sh!t" survive tokenisation as one token.
+// '$' folds whenever leet_symbol_at() allows it. '@', '!' and '|' fold only
+// when the folded word is toxic, so "wow!great" or "me@home" still split.
+static void fold_leet_symbols(char* s) {
+    if (!analysis_data.leet_normalisation_enabled) return;
+
+    for (size_t i = 0; s[i]; i++) {
+        if (!leet_symbol_at(s, i)) continue;
+
+        // The word around the symbol, folded as a whole
+        size_t b = i, e = i + 1;
+        while (b > 0 && (isalnum((unsigned char)s[b - 1]) || leet_symbol_at(s, b - 1))) b--;
+        while (isalnum((unsigned char)s[e]) || leet_symbol_at(s, e)) e++;
+        if (e - b >= MAX_WORD_LENGTH) {
+            i = e - 1;
+            continue;
+        }
+
+        char candidate[MAX_WORD_LENGTH];
+        bool fold[MAX_WORD_LENGTH];
+        bool inner = false;
+        for (size_t j = b; j < e; j++) {
+            fold[j - b] = leet_symbol_at(s, j);
+            if (fold[j - b] && s[j] != '$') inner = true;
+            candidate[j - b] = fold[j - b] ? (char)g_leet_map[(unsigned char)s[j]] : s[j];
+        }
+        candidate[e - b] = '\0';
+
+        bool toxic = inner && is_toxic_word(candidate);
+        for (size_t j = b; j < e; j++) {
+            if (fold[j - b] && (s[j] == '$' || toxic)) s[j] = candidate[j - b];
+        }
+        i = e - 1;
+    }
+}
+
+// Map each character through the rule table and collapse runs longer than
+// max_run ("shiiit" -> "shiit" for 2, "shit" for 1). O(length of word).
+static void leet_decode(const char* in, char* out, int max_run) {
+    int n = 0, run = 0;
+    unsigned char prev = 0;
+    for (; *in && n < MAX_WORD_LENGTH - 1; in++) {
+        unsigned char c = g_leet_map[(unsigned char)*in];
+        run = (c == prev) ? run + 1 : 1;
+        prev = c;
+        if (run <= max_run) out[n++] = (char)c;
+    }
+    out[n] = '\0';
+}
+
+// Return the dictionary word a disguised token decodes to, or NULL when the
+// token is already an exact entry or decodes to nothing toxic. Results are
+// cached per token and invalidated when the dictionary generation changes.
+static const char* leet_toxic_form(const char* word) {
+    if (!analysis_data.leet_normalisation_enabled || !word || !*word) return NULL;
+    if (strlen(word) >= MAX_WORD_LENGTH) return NULL;
+
+    if (!g_leet_cache) {
+        g_leet_cache = (struct LeetCacheEntry*)stage_calloc(LEET_CACHE_SIZE, sizeof(struct LeetCacheEntry));
+        if (!g_leet_cache) return NULL;
+    }
+
+    struct LeetCacheEntry* e = &g_leet_cache[hash_string(word) & (LEET_CACHE_SIZE - 1)];
+    if (e->generation == g_toxic_generation && strcmp(e->word, word) == 0) {
+        return e->canonical[0] ? e->canonical : NULL;
+    }
+
+    strcpy(e->word, word);
+    e->canonical[0] = '\0';
+    e->generation = g_toxic_generation;
+
+    if (!is_toxic_exact(word)) {
+        // Prefer the lighter collapse so "ass" is not reduced to "as".
+        char decoded[MAX_WORD_LENGTH];
+        for (int max_run = 2; max_run >= 1; max_run--) {
+            leet_decode(word, decoded, max_run);
+            if (strcmp(decoded, word) != 0 && is_toxic_exact(decoded)) {
+                strcpy(e->canonical, decoded);
+                break;
+            }
         }
     }
-    return word;
+    return e->canonical[0] ? e->canonical : NULL;
 }
 
 //extra feature (last resort)
@@ -1062,7 +1998,7 @@ void toggle_variant_processing() {
         if (analysis_data.text_filtered) {
             printf("\nRe-processing text with new normalisation setting...\n");
             int previous_word_count = analysis_data.total_words_filtered;
-            int previous_unique_words = analysis_data.word_count;
+            int previous_unique_words = analysis_data.vocab.size;
 
             reprocess_with_variants();
 
@@ -1070,13 +2006,13 @@ void toggle_variant_processing() {
 
             // Show statistics changes
             int word_change = analysis_data.total_words_filtered - previous_word_count;
-            int unique_change = analysis_data.word_count - previous_unique_words;
+            int unique_change = analysis_data.vocab.size - previous_unique_words;
 
             printf("\nText statistics updated:\n");
             printf("  * Total words: %d -> %d (%+d)\n",
                 previous_word_count, analysis_data.total_words_filtered, word_change);
             printf("  * Unique words: %d -> %d (%+d)\n",
-                previous_unique_words, analysis_data.word_count, unique_change);
+                previous_unique_words, analysis_data.vocab.size, unique_change);
 
             if (word_change != 0) {
                 printf("  * Change due to normalisation: %+d words\n", word_change);
@@ -1088,6 +2024,56 @@ void toggle_variant_processing() {
     }
 }
 
+// ----- Unique-word estimate (HyperLogLog) -----
+
+static void hll_reset(struct HyperLogLog* h) {
+    memset(h->registers, 0, sizeof(h->registers));
+}
+
+// Spread a 32-bit word hash over 64 bits (splitmix64 finaliser)
+static uint64_t hll_mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static void hll_add(struct HyperLogLog* h, unsigned int hash) {
+    uint64_t x = hll_mix(hash);
+    uint32_t reg = (uint32_t)(x >> (64 - HLL_PRECISION));
+    uint64_t rest = x << HLL_PRECISION;
+
+    // Rank = position of the first 1 bit after the register bits
+    unsigned char rank = 1;
+    while (rank <= 64 - HLL_PRECISION && !(rest & 0x8000000000000000ull)) {
+        rank++;
+        rest <<= 1;
+    }
+    if (rank > h->registers[reg]) h->registers[reg] = rank;
+}
+
+static long long hll_estimate(const struct HyperLogLog* h) {
+    const int m = 1 << HLL_PRECISION;
+    double sum = 0.0;
+    int zeros = 0;
+    for (int i = 0; i < m; i++) {
+        sum += ldexp(1.0, -h->registers[i]);
+        if (h->registers[i] == 0) zeros++;
+    }
+    double est = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+
+    // Small sets: linear counting over the empty registers is more accurate
+    if (est <= 2.5 * m && zeros > 0) est = m * log((double)m / zeros);
+    return llround(est);
+}
+
+// Distinct filtered words: exact while the vocab table holds them all,
+// otherwise the HyperLogLog estimate.
+static long long unique_word_count(void) {
+    if (analysis_data.vocab_dropped == 0) return analysis_data.vocab.size;
+    return hll_estimate(&analysis_data.unique_estimate);
+}
+
 // Add one token into the analysis pipeline
 void add_token_to_analysis(const char* tok, int* removed_by_stopwords) {
     if (!tok || !*tok) return;
@@ -1105,94 +2091,87 @@ void add_token_to_analysis(const char* tok, int* removed_by_stopwords) {
         return;
     }
 
+    uint32_t id = intern_word(tok);
+    if (id == TOKEN_NONE) return;
+
     // Append token to filtered word list
-    if (analysis_data.filtered_word_list != NULL &&
+    if (analysis_data.filtered_word_ids != NULL &&
         analysis_data.filtered_word_count < MAX_WORDS) {
-        strncpy(analysis_data.filtered_word_list[analysis_data.filtered_word_count],
-            tok, MAX_WORD_LENGTH - 1);
-        analysis_data.filtered_word_list[analysis_data.filtered_word_count][MAX_WORD_LENGTH - 1] = '\0';
+        analysis_data.filtered_word_ids[analysis_data.filtered_word_count] = id;
     }
     analysis_data.filtered_word_count++;
     analysis_data.total_words_filtered++;
     analysis_data.total_chars += (int)strlen(tok);
 
-    // Update frequency statistics for unique words
-    if (analysis_data.words != NULL) {
-        int found = 0;
-        for (int k = 0; k < analysis_data.word_count; k++) {
-            if (strcmp(analysis_data.words[k].word, tok) == 0) {
-                analysis_data.words[k].count++;
-                found = 1;
-                break;
-            }
-        }
-        if (!found && analysis_data.word_count < MAX_WORDS) {
-            strcpy(analysis_data.words[analysis_data.word_count].word, tok);
-            analysis_data.words[analysis_data.word_count].count = 1;
-            analysis_data.word_count++;
-        }
+    // Update frequency statistics for unique words (one probe by token ID)
+    hll_add(&analysis_data.unique_estimate, g_intern_hash[id]);
+    if (vocab_add(&analysis_data.vocab, id, 1, MAX_WORDS) < 0) {
+        analysis_data.vocab_dropped++;
     }
 }
 
 // Dynamically reprocess text using current variant & stopword settings
 void reprocess_with_variants() {
-    if (analysis_data.original_word_list == NULL) return;
+    if (analysis_data.original_word_ids == NULL) return;
+    double t0 = stage_begin(STAGE_REPROCESS);
 
     // Reset counters for the new pass
     analysis_data.total_words_filtered = 0;
     analysis_data.total_chars = 0;
-    analysis_data.word_count = 0;
+    analysis_data.vocab.size = 0;
+    analysis_data.vocab_dropped = 0;
+    analysis_data.search.built = 0;
+    hll_reset(&analysis_data.unique_estimate);
     analysis_data.filtered_word_count = 0;
 
-    if (analysis_data.words != NULL) {
-        memset(analysis_data.words, 0, MAX_WORDS * sizeof(struct WordInfo));
-    }
-
     int variants_normalised = 0;
     int removed_by_stopwords = 0;
     int considered_tokens = 0;
 
+    // Sentences are found on the original tokens; note where each one
+    // starts in the filtered list
+    const struct PositionIndex* positions = &analysis_data.positions;
+    int* sentence_filtered = sentence_filtered_table(&analysis_data.positions);
+    int next_sentence = 0;
+
     for (int i = 0; i < analysis_data.original_word_count && analysis_data.filtered_word_count < MAX_WORDS; i++) {
+        while (sentence_filtered && next_sentence < positions->sentences &&
+            positions->sentence_start[next_sentence] <= i) {
+            sentence_filtered[next_sentence++] = analysis_data.filtered_word_count;
+        }
+
         char current_word[MAX_WORD_LENGTH];
-        strncpy(current_word, analysis_data.original_word_list[i], MAX_WORD_LENGTH - 1);
+        strncpy(current_word, token_text(analysis_data.original_word_ids[i]), MAX_WORD_LENGTH - 1);
         current_word[MAX_WORD_LENGTH - 1] = '\0';
         if (!*current_word) continue;
 
         // Apply variant mapping if enabled
-        char* normalised = normalise_variant(current_word);
+        const struct VariantMap* vm = lookup_variant(current_word);
 
-        if (normalised != current_word) {
+        if (vm != NULL) {
             variants_normalised++;
 
-            // Phrase mapping: split into multiple tokens
-            if (strchr(normalised, ' ') != NULL) {
-                char phrase_buf[MAX_WORD_LENGTH * 4];
-                strncpy(phrase_buf, normalised, sizeof(phrase_buf) - 1);
-                phrase_buf[sizeof(phrase_buf) - 1] = '\0';
-
-                char* part = strtok(phrase_buf, " ");
-                while (part && analysis_data.filtered_word_count < MAX_WORDS) {
-                    int has_letters = 0;
-                    for (int j = 0; part[j]; j++) {
-                        if (ISALPHA(part[j])) {
-                            has_letters = 1;
-                            break;
-                        }
-                    }
-
-                    if (*part && has_letters) {
-                        considered_tokens++;
-                        add_token_to_analysis(part, &removed_by_stopwords);
-                    }
-                    part = strtok(NULL, " ");
+            // Phrase mapping: emit the pre-split expansion tokens
+            if (vm->part_count > 1) {
+                for (int p = 0; p < vm->part_count && analysis_data.filtered_word_count < MAX_WORDS; p++) {
+                    considered_tokens++;
+                    add_token_to_analysis(vm->parts + vm->part_offset[p], &removed_by_stopwords);
                 }
                 continue;
             }
 
             // Single-word mapping
-            strncpy(current_word, normalised, MAX_WORD_LENGTH - 1);
+            strncpy(current_word, vm->standard, MAX_WORD_LENGTH - 1);
             current_word[MAX_WORD_LENGTH - 1] = '\0';
         }
+        else if (analysis_data.variant_processing_enabled) {
+            // Leetspeak spelling of a dictionary word: keep the decoded form
+            const char* canonical = leet_toxic_form(current_word);
+            if (canonical) {
+                strcpy(current_word, canonical);
+                variants_normalised++;
+            }
+        }
 
         // Check that current_word contains letters
         int has_letters = 0;
@@ -1209,11 +2188,15 @@ void reprocess_with_variants() {
         }
     }
 
+    while (sentence_filtered && next_sentence < positions->sentences) {
+        sentence_filtered[next_sentence++] = analysis_data.filtered_word_count;
+    }
     analysis_data.stopwords_removed = considered_tokens - analysis_data.total_words_filtered;
 
     if (analysis_data.variant_processing_enabled && variants_normalised > 0) {
         printf("  - Text forms normalised: %d (abbreviations and Leet Speak)\n", variants_normalised);
     }
+    stage_end(STAGE_REPROCESS, t0, 0, analysis_data.original_word_count);
 }
 
 // Process and analyse a text file with stopwords & variants
@@ -1248,7 +2231,7 @@ void process_text_file(const char* filename) {
     }
 
     // Allocate main text buffer
-    analysis_data.text = (char*)malloc(MAX_TEXT_LENGTH);
+    analysis_data.text = (char*)stage_malloc(MAX_TEXT_LENGTH);
     if (!analysis_data.text) {
         printf("Error: Memory allocation failed (text)\n");
         fail_and_cleanup(file);
@@ -1257,18 +2240,17 @@ void process_text_file(const char* filename) {
     memset(analysis_data.text, 0, MAX_TEXT_LENGTH);
 
     // Allocate tables for filtered and original words
-    analysis_data.words = (struct WordInfo*)calloc(MAX_WORDS, sizeof(struct WordInfo));
-    if (!analysis_data.words) {
+    if (!vocab_reserve(&analysis_data.vocab, INTERN_INITIAL)) {
         printf("Error: Memory allocation failed (words)\n");
         fail_and_cleanup(file);
         return;
     }
 
-    if (!alloc_string_table(&analysis_data.filtered_word_list)) {
+    if (!alloc_id_table(&analysis_data.filtered_word_ids)) {
         fail_and_cleanup(file);
         return;
     }
-    if (!alloc_string_table(&analysis_data.original_word_list)) {
+    if (!alloc_id_table(&analysis_data.original_word_ids)) {
         fail_and_cleanup(file);
         return;
     }
@@ -1300,20 +2282,29 @@ void process_text_file(const char* filename) {
 
     // Tokenisation pass: collect original words
     printf("Starting text processing...\n");
-    char* text_copy = (char*)malloc(strlen(analysis_data.text) + 1);
+    char* text_copy = (char*)stage_malloc(strlen(analysis_data.text) + 1);
     if (!text_copy) {
         printf("Error: Memory allocation failed\n");
         return;
     }
     strcpy(text_copy, analysis_data.text);
+    double tokenise_t0 = stage_begin(STAGE_TOKENISE);
 
+    fold_leet_symbols(text_copy);
     char* token = strtok(text_copy, DELIMS);
     analysis_data.total_chars = 0;
-    analysis_data.word_count = 0;
+    analysis_data.vocab.size = 0;
     analysis_data.filtered_word_count = 0;
     analysis_data.total_words_filtered = 0;
     analysis_data.original_word_count = 0;
 
+    // Line and sentence starts are found while the tokens are collected
+    struct PositionIndex* positions = &analysis_data.positions;
+    size_t scan = 0;
+    int sentence_open = 0;
+    int marks_ok = int_list_push(&positions->line_start, &positions->lines, &positions->line_cap, 0) &&
+        position_mark_sentence(positions, 0, 0);
+
     // Collect all original tokens before variant / stopword filtering
     while (token && analysis_data.original_word_count < MAX_WORDS) {
         char clean_word[MAX_WORD_LENGTH];
@@ -1331,10 +2322,11 @@ void process_text_file(const char* filename) {
         }
 
         // Save processed original token
-        if (strlen(clean_word) > 0) {
-            strncpy(analysis_data.original_word_list[analysis_data.original_word_count],
-                clean_word, MAX_WORD_LENGTH - 1);
-            analysis_data.original_word_list[analysis_data.original_word_count][MAX_WORD_LENGTH - 1] = '\0';
+        uint32_t id = (strlen(clean_word) > 0) ? intern_word(clean_word) : TOKEN_NONE;
+        if (id != TOKEN_NONE) {
+            marks_ok &= position_marks_advance(positions, analysis_data.text, &scan,
+                (size_t)(token - text_copy), &sentence_open, analysis_data.original_word_count);
+            analysis_data.original_word_ids[analysis_data.original_word_count] = id;
             analysis_data.original_word_count++;
             analysis_data.total_words_original++;
         }
@@ -1342,6 +2334,12 @@ void process_text_file(const char* filename) {
         token = strtok(NULL, DELIMS);
     }
 
+    if (!marks_ok || !position_index_build(positions, analysis_data.original_word_ids,
+        analysis_data.original_word_count)) {
+        printf("Error: Memory allocation failed (position index)\n");
+        position_index_free(positions);
+    }
+    stage_end(STAGE_TOKENISE, tokenise_t0, (long long)used, analysis_data.original_word_count);
     free(text_copy);
 
     // Apply variant mappings and stopword filtering
@@ -1384,7 +2382,8 @@ void word_analysis() {
     printf("\n=== WORD STATISTICS WITH ADVANCED ANALYSIS ===\n");
     printf("File Analysed: %s\n", current_filename);
     printf("Total words                   : %d\n", analysis_data.total_words_filtered);
-    printf("Unique words                  : %d\n", analysis_data.word_count);
+    printf("Unique words                  : %d\n", analysis_data.vocab.size);
+    printf("Unique words (HLL estimate)   : ~%lld\n", hll_estimate(&analysis_data.unique_estimate));
     printf("Total sentences detected      : %d\n", analysis_data.sentences);
 
     if (analysis_data.sentences > 0) {
@@ -1407,7 +2406,7 @@ void word_analysis() {
 
     float lexical_diversity = 0.0;
     if (analysis_data.total_words_filtered > 0) {
-        lexical_diversity = (float)analysis_data.word_count / analysis_data.total_words_filtered;
+        lexical_diversity = (float)unique_word_count() / analysis_data.total_words_filtered;
     }
     printf("Lexical Diversity             : %.3f", lexical_diversity);
     if (lexical_diversity > 0.8) printf(" (High - Rich vocabulary)");
@@ -1427,12 +2426,13 @@ void word_analysis() {
 
     // Show top 10 frequent words
     printf("\n--- TOP 10 FREQUENT WORDS ---\n");
-    if (analysis_data.word_count > 0) {
-        sort_by_frequency(analysis_data.words, analysis_data.word_count);
-        int n = (analysis_data.word_count < 10) ? analysis_data.word_count : 10;
+    if (analysis_data.vocab.size > 0) {
+        const struct VocabTable* v = &analysis_data.vocab;
+        int rows[10];
+        int n = top_count_rows(v->counts, v->size, 10, rows);
         for (int i = 0; i < n; i++) {
             printf("%2d. %-15s (used %d times)\n",
-                i + 1, analysis_data.words[i].word, analysis_data.words[i].count);
+                i + 1, vocab_text(v, rows[i]), v->counts[rows[i]]);
         }
     }
     else {
@@ -1449,9 +2449,7 @@ void save_filtered_word_list_auto(const char* filename) {
     FILE* file = fopen(filename, "w");
     if (file) {
         for (int i = 0; i < analysis_data.filtered_word_count; i++) {
-            if (analysis_data.filtered_word_list[i] != NULL) {
-                fprintf(file, "%s\n", analysis_data.filtered_word_list[i]);
-            }
+            fprintf(file, "%s\n", token_text(analysis_data.filtered_word_ids[i]));
         }
         fclose(file);
         // Silent save: no console message
@@ -1490,7 +2488,7 @@ void save_filtered_word_list() {
         fprintf(file, "# TextNormalisation: %s\n", analysis_data.variant_processing_enabled ? "enabled" : "disabled");
 
         for (int i = 0; i < analysis_data.filtered_word_count; i++) {
-            fprintf(file, "%s\n", analysis_data.filtered_word_list[i]);
+            fprintf(file, "%s\n", token_text(analysis_data.filtered_word_ids[i]));
         }
         fclose(file);
 
@@ -1506,50 +2504,536 @@ void save_filtered_word_list() {
     }
 }
 
-// Simple bubble sort by frequency (descending)
-void sort_by_frequency(struct WordInfo words[], int count) {
-    for (int i = 0; i < count - 1; i++) {
-        for (int j = 0; j < count - i - 1; j++) {
-            if (words[j].count < words[j + 1].count) {
-                struct WordInfo temp = words[j];
-                words[j] = words[j + 1];
-                words[j + 1] = temp;
-            }
+// Rows of the k largest counts (descending; ties keep first-seen order).
+// Scans only the count column, so the table itself is left in place.
+int top_count_rows(const int* counts, int size, int k, int rows[]) {
+    int n = 0;
+    if (k <= 0) return 0;
+    for (int r = 0; r < size; r++) {
+        int c = counts[r];
+        if (c <= 0 || (n == k && c <= counts[rows[n - 1]])) continue;
+
+        // Insert r behind every kept row with an equal or higher count
+        int pos = (n < k) ? n++ : n - 1;
+        while (pos > 0 && counts[rows[pos - 1]] < c) {
+            rows[pos] = rows[pos - 1];
+            pos--;
         }
+        rows[pos] = r;
     }
+    return n;
 }
 
-// Free all heap-allocated analysis buffers and reset counters
-void cleanup_analysis_data() {
-    if (analysis_data.text != NULL) {
-        free(analysis_data.text);
-        analysis_data.text = NULL;
-    }
-    if (analysis_data.words != NULL) {
-        free(analysis_data.words);
-        analysis_data.words = NULL;
-    }
-    if (analysis_data.filtered_word_list != NULL) {
-        for (int i = 0; i < MAX_WORDS; i++) {
-            if (analysis_data.filtered_word_list[i] != NULL) {
-                free(analysis_data.filtered_word_list[i]);
-            }
-        }
-        free(analysis_data.filtered_word_list);
-        analysis_data.filtered_word_list = NULL;
-    }
-    if (analysis_data.original_word_list != NULL) {
-        for (int i = 0; i < MAX_WORDS; i++) {
-            if (analysis_data.original_word_list[i] != NULL) {
-                free(analysis_data.original_word_list[i]);
-            }
+// ----- Vocabulary search (prefix*, *suffix, wild?card) -----
+
+// Release the search index; it is rebuilt on the next search.
+static void vocab_search_reset(struct VocabSearchIndex* s) {
+    free(s->by_word);
+    free(s->by_suffix);
+    free(s->reversed);
+    free(s->reversed_offset);
+    memset(s, 0, sizeof(*s));
+}
+
+static const struct VocabSearchIndex* g_search_sorting;  // Index being built (qsort has no context)
+
+static int cmp_search_word(const void* a, const void* b) {
+    return strcmp(vocab_text(&analysis_data.vocab, *(const int*)a),
+        vocab_text(&analysis_data.vocab, *(const int*)b));
+}
+
+static int cmp_search_suffix(const void* a, const void* b) {
+    const struct VocabSearchIndex* s = g_search_sorting;
+    return strcmp(s->reversed + s->reversed_offset[*(const int*)a],
+        s->reversed + s->reversed_offset[*(const int*)b]);
+}
+
+// Sort the vocabulary rows by word and by reversed word, once per load.
+// Returns 0 if out of memory.
+static int vocab_search_build(struct VocabSearchIndex* s) {
+    const struct VocabTable* v = &analysis_data.vocab;
+    if (s->built) return 1;
+    vocab_search_reset(s);
+
+    int n = v->size;
+    size_t pool = 0;
+    for (int r = 0; r < n; r++) pool += strlen(vocab_text(v, r)) + 1;
+    s->by_word = (int*)stage_malloc(sizeof(int) * (n > 0 ? n : 1));
+    s->by_suffix = (int*)stage_malloc(sizeof(int) * (n > 0 ? n : 1));
+    s->reversed = (char*)stage_malloc(pool > 0 ? pool : 1);
+    s->reversed_offset = (uint32_t*)stage_malloc(sizeof(uint32_t) * (n > 0 ? n : 1));
+    if (!s->by_word || !s->by_suffix || !s->reversed || !s->reversed_offset) {
+        printf("Error: Memory allocation failed (search index)\n");
+        vocab_search_reset(s);
+        return 0;
+    }
+
+    // Reversed copies make a suffix query a prefix query on by_suffix
+    size_t used = 0;
+    for (int r = 0; r < n; r++) {
+        const char* word = vocab_text(v, r);
+        size_t len = strlen(word);
+        s->reversed_offset[r] = (uint32_t)used;
+        for (size_t i = 0; i < len; i++) s->reversed[used + i] = word[len - 1 - i];
+        s->reversed[used + len] = '\0';
+        used += len + 1;
+        s->by_word[r] = r;
+        s->by_suffix[r] = r;
+    }
+    qsort(s->by_word, n, sizeof(int), cmp_search_word);
+    g_search_sorting = s;
+    qsort(s->by_suffix, n, sizeof(int), cmp_search_suffix);
+    g_search_sorting = NULL;
+
+    s->size = n;
+    s->built = 1;
+    return 1;
+}
+
+// Text of the entry at position i of one of the two orders.
+static const char* search_key(const struct VocabSearchIndex* s, int suffix_order, int i) {
+    if (suffix_order) return s->reversed + s->reversed_offset[s->by_suffix[i]];
+    return vocab_text(&analysis_data.vocab, s->by_word[i]);
+}
+
+// Positions [*lo, *hi) of the entries starting with prefix (two binary searches).
+static void search_prefix_range(const struct VocabSearchIndex* s, int suffix_order,
+    const char* prefix, int* lo, int* hi) {
+    size_t len = strlen(prefix);
+    int a = 0, b = s->size;
+    while (a < b) {
+        int mid = a + (b - a) / 2;
+        if (strcmp(search_key(s, suffix_order, mid), prefix) < 0) a = mid + 1;
+        else b = mid;
+    }
+    *lo = a;
+    b = s->size;
+    while (a < b) {
+        int mid = a + (b - a) / 2;
+        if (strncmp(search_key(s, suffix_order, mid), prefix, len) == 0) a = mid + 1;
+        else b = mid;
+    }
+    *hi = a;
+}
+
+// '*' matches any run of characters, '?' exactly one.
+static int wildcard_match(const char* pattern, const char* word) {
+    const char* star = NULL;
+    const char* resume = NULL;
+    while (*word) {
+        if (*pattern == '?' || (*pattern != '*' && *pattern == *word)) {
+            pattern++;
+            word++;
+        }
+        else if (*pattern == '*') {
+            star = pattern++;
+            resume = word;
+        }
+        else if (star) {
+            pattern = star + 1;        // Let the last '*' absorb one more character
+            word = ++resume;
+        }
+        else {
+            return 0;
+        }
+    }
+    while (*pattern == '*') pattern++;
+    return *pattern == '\0';
+}
+
+// Rows of the words matching pattern, in A-Z order. Only the narrower of
+// the literal-prefix range (by word) and the literal-suffix range (by
+// reversed word) is scanned. Returns the match count, or -1 if out of memory.
+static int vocab_search(struct VocabSearchIndex* s, const char* pattern, int** rows_out) {
+    *rows_out = NULL;
+    if (!vocab_search_build(s)) return -1;
+
+    char prefix[MAX_WORD_LENGTH + 1], suffix[MAX_WORD_LENGTH + 1];
+    size_t len = strlen(pattern);
+    size_t p = strcspn(pattern, "*?");
+    size_t q = len;                    // Literal tail starts at q
+    while (q > 0 && pattern[q - 1] != '*' && pattern[q - 1] != '?') q--;
+    if (p > MAX_WORD_LENGTH) p = MAX_WORD_LENGTH;
+    memcpy(prefix, pattern, p);
+    prefix[p] = '\0';
+    size_t tail = len - q;
+    if (tail > MAX_WORD_LENGTH) tail = MAX_WORD_LENGTH;
+    for (size_t i = 0; i < tail; i++) suffix[i] = pattern[len - 1 - i];
+    suffix[tail] = '\0';
+
+    int lo, hi, suffix_order = 0;
+    search_prefix_range(s, 0, prefix, &lo, &hi);
+    if (tail > 0 && p < len) {
+        int slo, shi;
+        search_prefix_range(s, 1, suffix, &slo, &shi);
+        if (shi - slo < hi - lo) {
+            lo = slo;
+            hi = shi;
+            suffix_order = 1;
+        }
+    }
+
+    int* rows = (int*)stage_malloc(sizeof(int) * (hi > lo ? hi - lo : 1));
+    if (!rows) return -1;
+    int n = 0;
+    for (int i = lo; i < hi; i++) {
+        int r = suffix_order ? s->by_suffix[i] : s->by_word[i];
+        if (wildcard_match(pattern, vocab_text(&analysis_data.vocab, r))) rows[n++] = r;
+    }
+    if (suffix_order) qsort(rows, n, sizeof(int), cmp_search_word);
+    *rows_out = rows;
+    return n;
+}
+
+// Prompt for a pattern and list the matching words with their counts.
+void search_vocabulary() {
+    const struct VocabTable* v = &analysis_data.vocab;
+    char pattern[MAX_WORD_LENGTH + 1];
+    printf("Pattern (stem*, *suffix, f*k, w?rd): ");
+    if (!read_line(pattern, sizeof(pattern)) || pattern[0] == '\0') {
+        printf("No pattern entered.\n");
+        return;
+    }
+    tolower_inplace(pattern);
+
+    int built = analysis_data.search.built;
+    double t0 = wall_ms();
+    int* rows;
+    int n = vocab_search(&analysis_data.search, pattern, &rows);
+    double ms = wall_ms() - t0;
+    if (n < 0) {
+        printf("Error: Memory allocation failed (search)\n");
+        return;
+    }
+
+    long long occurrences = 0;
+    for (int i = 0; i < n; i++) occurrences += v->counts[rows[i]];
+    printf("\n%d word(s) match '%s' (%lld occurrences, %.3f ms%s)\n",
+        n, pattern, occurrences, ms, built ? "" : " incl. index build");
+    for (int i = 0; i < n && i < SEARCH_MAX_SHOWN; i++) {
+        printf("  %-20s %d\n", vocab_text(v, rows[i]), v->counts[rows[i]]);
+    }
+    if (n > SEARCH_MAX_SHOWN) printf("  ... and %d more\n", n - SEARCH_MAX_SHOWN);
+    free(rows);
+}
+
+// ----- Positional index and keyword in context -----
+// Every original token's position, per token ID, as varint-encoded gaps,
+// plus the first token position of each line and sentence. A concordance
+// query decodes the rarest word's list and reads the context straight from
+// original_word_ids, so the text is never rescanned.
+
+static void position_index_free(struct PositionIndex* pi) {
+    free(pi->start);
+    free(pi->freq);
+    free(pi->gaps);
+    free(pi->line_start);
+    free(pi->sentence_start);
+    free(pi->sentence_offset);
+    free(pi->sentence_filtered);
+    memset(pi, 0, sizeof(*pi));
+}
+
+// Append v to a growable int list. Returns 0 if out of memory.
+static int int_list_push(int** list, int* count, int* cap, int v) {
+    if (*count == *cap) {
+        int new_cap = *cap ? *cap * 2 : 256;
+        int* grown = (int*)stage_realloc(*list, sizeof(int) * new_cap);
+        if (!grown) return 0;
+        *list = grown;
+        *cap = new_cap;
+    }
+    (*list)[(*count)++] = v;
+    return 1;
+}
+
+// Record a sentence starting at token position token, text offset offset.
+// Returns 0 if out of memory.
+static int position_mark_sentence(struct PositionIndex* pi, int token, int offset) {
+    if (pi->sentences == pi->sentence_cap) {
+        int new_cap = pi->sentence_cap ? pi->sentence_cap * 2 : 256;
+        int* starts = (int*)stage_realloc(pi->sentence_start, sizeof(int) * new_cap);
+        if (starts) pi->sentence_start = starts;
+        int* offsets = (int*)stage_realloc(pi->sentence_offset, sizeof(int) * new_cap);
+        if (offsets) pi->sentence_offset = offsets;
+        if (!starts || !offsets) return 0;
+        pi->sentence_cap = new_cap;
+    }
+    pi->sentence_start[pi->sentences] = token;
+    pi->sentence_offset[pi->sentences] = offset;
+    pi->sentences++;
+    return 1;
+}
+
+// Scan text[*scan..upto) for line breaks and sentence ends (the same rule
+// process_text_file counts sentences with); both start at next_token.
+// Returns 0 if out of memory.
+static int position_marks_advance(struct PositionIndex* pi, const char* text,
+    size_t* scan, size_t upto, int* in_sentence, int next_token) {
+    int ok = 1;
+    for (; *scan < upto; (*scan)++) {
+        char c = text[*scan];
+        if (c == '\n') {
+            ok &= int_list_push(&pi->line_start, &pi->lines, &pi->line_cap, next_token);
+        }
+        else if (c == '.' || c == '!' || c == '?') {
+            if (*in_sentence) {
+                ok &= position_mark_sentence(pi, next_token, (int)*scan + 1);
+                *in_sentence = 0;
+            }
+        }
+        else if (ISALPHA(c)) {
+            *in_sentence = 1;
+        }
+    }
+    return ok;
+}
+
+static int varint_length(uint32_t v) {
+    int len = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        len++;
+    }
+    return len;
+}
+
+// Position lists for ids[0..n). Returns 0 if out of memory.
+static int position_index_build(struct PositionIndex* pi, const uint32_t* ids, int n) {
+    uint32_t m = g_intern_count;
+    pi->start = (uint32_t*)stage_calloc((size_t)m + 1, sizeof(uint32_t));
+    pi->freq = (int*)stage_calloc(m > 0 ? m : 1, sizeof(int));
+    int* last = (int*)stage_malloc(sizeof(int) * (m > 0 ? m : 1));
+    if (!pi->start || !pi->freq || !last) {
+        free(last);
+        return 0;
+    }
+
+    // Size every list, then lay them out back to back
+    for (uint32_t id = 0; id < m; id++) last[id] = -1;
+    for (int i = 0; i < n; i++) {
+        uint32_t id = ids[i];
+        pi->start[id + 1] += (uint32_t)varint_length((uint32_t)(i - last[id]));
+        pi->freq[id]++;
+        last[id] = i;
+    }
+    for (uint32_t id = 0; id < m; id++) pi->start[id + 1] += pi->start[id];
+    pi->gaps = (unsigned char*)stage_malloc(pi->start[m] > 0 ? pi->start[m] : 1);
+    if (!pi->gaps) {
+        free(last);
+        return 0;
+    }
+
+    // last[] now holds each list's write cursor, minus the previous position
+    uint32_t* cursor = (uint32_t*)stage_malloc(sizeof(uint32_t) * (m > 0 ? m : 1));
+    if (!cursor) {
+        free(last);
+        free(pi->gaps);
+        pi->gaps = NULL;
+        return 0;
+    }
+    for (uint32_t id = 0; id < m; id++) {
+        cursor[id] = pi->start[id];
+        last[id] = -1;
+    }
+    for (int i = 0; i < n; i++) {
+        uint32_t id = ids[i];
+        uint32_t gap = (uint32_t)(i - last[id]);
+        while (gap >= 0x80) {
+            pi->gaps[cursor[id]++] = (unsigned char)(gap | 0x80);
+            gap >>= 7;
+        }
+        pi->gaps[cursor[id]++] = (unsigned char)gap;
+        last[id] = i;
+    }
+    free(cursor);
+    free(last);
+    pi->ids = m;
+    return 1;
+}
+
+// Table for reprocess_with_variants() to map sentences onto the filtered
+// list, sized for every sentence. NULL if there is no index or no memory.
+static int* sentence_filtered_table(struct PositionIndex* pi) {
+    if (!pi->gaps || pi->sentences == 0) return NULL;
+    if (pi->sentences > pi->sentence_filtered_cap) {
+        int* grown = (int*)stage_realloc(pi->sentence_filtered, sizeof(int) * pi->sentences);
+        if (!grown) return NULL;
+        pi->sentence_filtered = grown;
+        pi->sentence_filtered_cap = pi->sentences;
+    }
+    return pi->sentence_filtered;
+}
+
+// Decode the next position of a list; *pos starts at -1.
+static inline void position_next(const unsigned char** p, int* pos) {
+    uint32_t gap = 0;
+    int shift = 0;
+    while (**p & 0x80) {
+        gap |= (uint32_t)(*(*p)++ & 0x7F) << shift;
+        shift += 7;
+    }
+    gap |= (uint32_t)*(*p)++ << shift;
+    *pos += (int)gap;
+}
+
+// 1-based number of the line or sentence holding token pos.
+static int position_mark_number(const int* starts, int count, int pos) {
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (starts[mid] <= pos) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Print one concordance line: the hit in brackets, context on both sides.
+static void kwic_print(int at, int len, int context) {
+    const struct PositionIndex* pi = &analysis_data.positions;
+    const uint32_t* ids = analysis_data.original_word_ids;
+    int n = analysis_data.original_word_count;
+    char left[KWIC_LEFT_WIDTH * 2], right[KWIC_LEFT_WIDTH * 2], hit[MAX_WORD_LENGTH * KWIC_MAX_WORDS];
+    size_t used = 0;
+    left[0] = right[0] = hit[0] = '\0';
+
+    int from = at - context < 0 ? 0 : at - context;
+    for (int i = from; i < at; i++) {
+        used += snprintf(left + used, sizeof(left) - used, "%s%s", i > from ? " " : "", token_text(ids[i]));
+        if (used >= sizeof(left)) used = sizeof(left) - 1;
+    }
+    used = 0;
+    for (int i = at; i < at + len; i++) {
+        used += snprintf(hit + used, sizeof(hit) - used, "%s%s", i > at ? " " : "", token_text(ids[i]));
+        if (used >= sizeof(hit)) used = sizeof(hit) - 1;
+    }
+    used = 0;
+    for (int i = at + len; i < n && i < at + len + context; i++) {
+        used += snprintf(right + used, sizeof(right) - used, "%s%s", i > at + len ? " " : "", token_text(ids[i]));
+        if (used >= sizeof(right)) used = sizeof(right) - 1;
+    }
+
+    // Keep the whole words nearest the hit when the left context is too wide
+    size_t left_len = strlen(left);
+    const char* shown = left;
+    if (left_len > KWIC_LEFT_WIDTH) {
+        shown = left + left_len - KWIC_LEFT_WIDTH;
+        if (shown[-1] != ' ' && strchr(shown, ' ')) shown = strchr(shown, ' ') + 1;
+    }
+    printf("%5d %5d | %*s [%s] %s\n",
+        position_mark_number(pi->line_start, pi->lines, at),
+        position_mark_number(pi->sentence_start, pi->sentences, at),
+        KWIC_LEFT_WIDTH, shown, hit, right);
+}
+
+// Prompt for a word or phrase and show every occurrence in context.
+void keyword_in_context() {
+    const struct PositionIndex* pi = &analysis_data.positions;
+    if (!pi->gaps) {
+        printf("No position index. Please run Word Analysis first.\n");
+        return;
+    }
+
+    char query[MAX_WORD_LENGTH * KWIC_MAX_WORDS];
+    printf("Word or phrase: ");
+    if (!read_line(query, sizeof(query)) || query[0] == '\0') {
+        printf("No word entered.\n");
+        return;
+    }
+    tolower_inplace(query);
+
+    char buf[16];
+    int context = KWIC_CONTEXT_DEFAULT;
+    printf("Context tokens each side (Enter for %d): ", KWIC_CONTEXT_DEFAULT);
+    if (read_line(buf, sizeof(buf)) && buf[0] != '\0') {
+        context = atoi(buf);
+        if (context < 0) context = 0;
+        if (context > KWIC_CONTEXT_MAX) context = KWIC_CONTEXT_MAX;
+    }
+
+    // Look the words up without interning them
+    uint32_t q[KWIC_MAX_WORDS];
+    int len = 0, anchor = 0;
+    for (char* w = strtok(query, " \t"); w; w = strtok(NULL, " \t")) {
+        if (len == KWIC_MAX_WORDS) {
+            printf("At most %d words per phrase.\n", KWIC_MAX_WORDS);
+            return;
+        }
+        uint32_t id = intern_find_hashed(w, hash_string(w));
+        if (id == TOKEN_NONE || id >= pi->ids || pi->freq[id] == 0) {
+            printf("'%s' does not occur in %s.\n", w, current_filename);
+            return;
         }
-        free(analysis_data.original_word_list);
-        analysis_data.original_word_list = NULL;
+        q[len] = id;
+        if (pi->freq[id] < pi->freq[q[anchor]]) anchor = len;
+        len++;
+    }
+    if (len == 0) {
+        printf("No word entered.\n");
+        return;
+    }
+
+    // Walk the rarest word's positions; the rest of a phrase is checked in place
+    const uint32_t* ids = analysis_data.original_word_ids;
+    int n = analysis_data.original_word_count;
+    const unsigned char* p = pi->gaps + pi->start[q[anchor]];
+    int pos = -1, hits = 0;
+    double t0 = wall_ms();
+    printf("\n%5s %5s | %*s [hit] ...\n", "Line", "Sent", KWIC_LEFT_WIDTH, "...");
+    for (int k = 0; k < pi->freq[q[anchor]]; k++) {
+        position_next(&p, &pos);
+        int at = pos - anchor;
+        if (at < 0 || at + len > n) continue;
+        int match = 1;
+        for (int j = 0; j < len && match; j++) match = (ids[at + j] == q[j]);
+        if (!match) continue;
+        kwic_print(at, len, context);
+        hits++;
+    }
+    printf("%d occurrence(s) (%.3f ms)\n", hits, wall_ms() - t0);
+}
+
+// Drop every table indexed by token ID and renumber the interner down to the
+// words of the Stage 1 files, so IDs do not pile up across files and runs.
+static void reset_token_ids(void) {
+    free(g_token_toxicity);
+    g_token_toxicity = NULL;
+    g_token_toxicity_cap = 0;
+    free(g_severity_lut);
+    g_severity_lut = NULL;
+    g_severity_lut_cap = 0;
+    free(g_ngram_slots);
+    g_ngram_slots = NULL;
+    g_ngram_size = 0;
+    vocab_free(&g_toxic_vocab);
+    g_toxic_id_count = 0;
+    sort_hints_free();
+
+    uint32_t* const lists[2] = { words1, words2 };
+    const int counts[2] = { wordCount1, wordCount2 };
+    if (!intern_compact(lists, counts, 2)) {
+        printf("Error: Memory allocation failed (interner)\n");
+    }
+}
+
+// Free all heap-allocated analysis buffers and reset counters
+void cleanup_analysis_data() {
+    if (analysis_data.text != NULL) {
+        free(analysis_data.text);
+        analysis_data.text = NULL;
     }
+    vocab_free(&analysis_data.vocab);
+    vocab_search_reset(&analysis_data.search);
+    position_index_free(&analysis_data.positions);
+    analysis_data.vocab_dropped = 0;
+    hll_reset(&analysis_data.unique_estimate);
+    free(analysis_data.filtered_word_ids);
+    analysis_data.filtered_word_ids = NULL;
+    free(analysis_data.original_word_ids);
+    analysis_data.original_word_ids = NULL;
+    reset_token_ids();
 
     // Reset all Stage 2 counters
-    analysis_data.word_count = 0;
     analysis_data.total_words_filtered = 0;
     analysis_data.total_chars = 0;
     analysis_data.sentences = 0;
@@ -1564,6 +3048,7 @@ void cleanup_analysis_data() {
     analysis_data.toxicity_density = 0.0;
     analysis_data.bigram_toxic_occurrences = 0;
     analysis_data.trigram_toxic_occurrences = 0;
+    analysis_data.fuzzy_toxic_occurrences = 0;
     memset(analysis_data.severity_count, 0, sizeof(analysis_data.severity_count));
 }
 
@@ -1593,13 +3078,14 @@ void display_advanced_analysis_menu() {
         printf("2. Word Analysis\n");
         printf("3. Text Normalisation (Toggle & View Examples)\n");
         printf("4. Save Filtered Word List\n");
+        printf("5. Search Vocabulary (prefix*, *suffix, wild?card)\n");
         printf("0. Back\n");
         printf("Select: ");
 
         if (scanf("%d", &sub) != 1) {
             int c;
             while ((c = getchar()) != '\n' && c != EOF);
-            printf("Invalid input. Please enter 0-4.\n");
+            printf("Invalid input. Please enter 0-5.\n");
             sub = -1;
             continue;
         }
@@ -1643,11 +3129,19 @@ void display_advanced_analysis_menu() {
                 save_filtered_word_list();
             }
             break;
+        case 5:
+            if (!analysis_data.text_filtered) {
+                printf("No analysis available. Please use option 2 first.\n");
+            }
+            else {
+                search_vocabulary();
+            }
+            break;
         case 0:
             printf("Returning to main menu...\n");
             break;
         default:
-            printf("Invalid choice. Please enter 0-4.\n");
+            printf("Invalid choice. Please enter 0-5.\n");
         }
     } while (sub != 0);
 }
@@ -1656,2086 +3150,6034 @@ void display_advanced_analysis_menu() {
 
 // ===== 3. Stage 3 - Toxic Dictionary Management and Toxicity Analysis =====
 
-// Load toxic words from toxicwords.txt into the in-memory dictionary (Stage 4).
-static int load_toxicwords(void) {
-    if (g_toxic_loaded) return g_toxic_count;
-    FILE* f = fopen("toxicwords.txt", "r");
-    if (!f) { printf("[!] Cannot open toxicwords.txt (toxic TopN will be empty)\n"); return 0; }
-    char line[MAX_WORD_LENGTH];
-    while (g_toxic_count < 500 && fgets(line, sizeof(line), f)) {
-        line[strcspn(line, "\r\n")] = '\0';
-        for (int i = 0; line[i]; ++i) line[i] = (char)tolower((unsigned char)line[i]);
-        if (line[0]) strcpy(g_toxic[g_toxic_count++], line);
-    }
-    fclose(f);
-    g_toxic_loaded = 1;
-    printf("[i] Loaded %d toxic terms\n", g_toxic_count);
-    return g_toxic_count;
+// ----- Toxic dictionary service (one storage, one load, one lookup path) -----
+
+// Free a dictionary's arrays and indexes (not the struct itself).
+static void toxic_dict_free_storage(struct ToxicDictionary* d) {
+    free(d->words);
+    free(d->phrases);
+    free(d->word_index);
+    free(d->phrase_index);
+    free(d->word_order);
+    memset(d, 0, sizeof(*d));
 }
 
-// Sync toxic words between Stage 3 and Stage 4 systems
-void sync_toxic_systems(void) {
-    // Reset Stage 4 system
-    g_toxic_count = 0;
-    g_toxic_loaded = 0;
+// Drop one reference; the last one frees the dictionary.
+static void toxic_dict_release(struct ToxicDictionary* d) {
+    if (!d || --d->refs > 0) return;
+    toxic_dict_free_storage(d);
+    if (d != &g_toxic_dict_initial) free(d);
+}
 
-    // Copy from Stage 3 to Stage 4
-    for (int i = 0; i < analysis_data.toxic_words_count && g_toxic_count < 500; i++) {
-        strcpy(g_toxic[g_toxic_count], analysis_data.toxic_words_list[i].word);
-        g_toxic_count++;
-    }
-    g_toxic_loaded = 1;
-    printf("[i] Synced %d toxic terms between systems\n", g_toxic_count);
+// Record a content change so cached lookups (leet, BK-tree, fuzzy memo) are re-checked.
+static void toxic_dict_changed(void) {
+    g_toxic_generation++;
 }
 
-// Load toxic words and phrases from a dictionary file.
-void load_toxic_data(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        printf("Warning: Cannot open toxic data file: %s\n", filename);
-        return;
-    }
+// Load toxicwords.txt on first use. Every stage goes through here, so the
+// dictionary is read exactly once per run (edits are applied in memory).
+static void ensure_toxic_dictionary(void) {
+    if (g_toxic_loaded) return;
+    g_toxic_loaded = 1; // Set first: a missing file is not retried per token
+    printf("Loading toxic dictionary...\n");
+    load_toxic_data("toxicwords.txt");
+}
 
-    analysis_data.toxic_words_count = 0;
-    analysis_data.toxic_phrases_count = 0;
-    char line[256];
+// Pin the current dictionary for reading. Pair with toxic_dict_release().
+static struct ToxicDictionary* toxic_dict_acquire(void) {
+    ensure_toxic_dictionary();
+    g_dict->refs++;
+    return g_dict;
+}
 
-    printf("Loading toxic data from %s...\n", filename);
+// Copy n elements of size sz, or return NULL for an empty source.
+static void* dup_array(const void* src, size_t n, size_t sz, int* failed) {
+    if (!src || n == 0) return NULL;
+    void* copy = stage_malloc(n * sz);
+    if (!copy) *failed = 1;
+    else memcpy(copy, src, n * sz);
+    return copy;
+}
 
-    while (fgets(line, sizeof(line), file)) {
-        line[strcspn(line, "\n")] = '\0';
-        line[strcspn(line, "\r")] = '\0';
+// Make g_dict safe to modify: while a reader holds it, edits go to a private copy.
+static int toxic_dict_detach(void) {
+    if (g_dict->refs <= 1) return 1;
 
-        if (strlen(line) == 0 || line[0] == '#') continue;
+    struct ToxicDictionary* copy = (struct ToxicDictionary*)stage_calloc(1, sizeof(*copy));
+    if (!copy) {
+        printf("Error: Memory allocation failed (toxic dictionary)\n");
+        return 0;
+    }
+    int failed = 0;
+    *copy = *g_dict;
+    copy->words = (struct ToxicWord*)dup_array(g_dict->words, g_dict->word_capacity, sizeof(struct ToxicWord), &failed);
+    copy->phrases = (struct ToxicPhrase*)dup_array(g_dict->phrases, g_dict->phrase_capacity, sizeof(struct ToxicPhrase), &failed);
+    copy->word_index = (int*)dup_array(g_dict->word_index, g_dict->word_index_size, sizeof(int), &failed);
+    copy->phrase_index = (int*)dup_array(g_dict->phrase_index, g_dict->phrase_index_size, sizeof(int), &failed);
+    copy->word_order = (int*)dup_array(g_dict->word_order, g_dict->word_capacity, sizeof(int), &failed);
+    copy->refs = 1;
+    if (failed) {
+        printf("Error: Memory allocation failed (toxic dictionary)\n");
+        toxic_dict_release(copy);
+        return 0;
+    }
+    g_dict->refs--; // The readers keep the old snapshot alive
+    g_dict = copy;
+    return 1;
+}
 
-        char* token = strtok(line, ",");
-        if (!token) continue;
+// Swap in an empty dictionary before a full reload.
+static int toxic_dict_reset(void) {
+    struct ToxicDictionary* fresh = (struct ToxicDictionary*)stage_calloc(1, sizeof(*fresh));
+    if (!fresh) {
+        printf("Error: Memory allocation failed (toxic dictionary)\n");
+        return 0;
+    }
+    fresh->refs = 1;
+    toxic_dict_release(g_dict);
+    g_dict = fresh;
+    return 1;
+}
 
-        char word[100];
-        strcpy(word, token);
+// ----- Dictionary hash index and compiled (.bin) dictionary -----
 
-        trim_inplace(word);
-        tolower_inplace(word);
+// Make room for at least need words. The ordered index, when built, grows with it.
+static int reserve_toxic_words(int need) {
+    if (need <= g_dict->word_capacity) return 1;
+    int new_cap = g_dict->word_capacity ? g_dict->word_capacity : TOXIC_DICT_INITIAL;
+    while (new_cap < need) new_cap *= 2;
 
-        token = strtok(NULL, ",");
-        if (!token) {
-            printf("Warning: Invalid line (no severity): %s\n", line);
-            continue;
+    struct ToxicWord* grown = (struct ToxicWord*)stage_realloc(g_dict->words,
+        sizeof(struct ToxicWord) * new_cap);
+    if (!grown) {
+        printf("Error: Memory allocation failed (toxic words)\n");
+        return 0;
+    }
+    g_dict->words = grown;
+    if (g_dict->word_order) {
+        int* order = (int*)stage_realloc(g_dict->word_order, sizeof(int) * new_cap);
+        if (!order) {
+            free(g_dict->word_order); // Rebuilt on next use
         }
-        trim_inplace(token);
-        int severity = atoi(token);
-        if (severity < 1 || severity > 5) severity = 3;
-
-        if (strchr(word, ' ') != NULL) {
-            if (analysis_data.toxic_phrases_count < MAX_PHRASES) {
-                int idx = analysis_data.toxic_phrases_count;
+        g_dict->word_order = order;
+    }
+    g_dict->word_capacity = new_cap;
+    return 1;
+}
 
-                int len = 1;
-                for (char* p = word; *p; ++p) {
-                    if (*p == ' ') len++;
-                }
+// Make room for at least need phrases.
+static int reserve_toxic_phrases(int need) {
+    if (need <= g_dict->phrase_capacity) return 1;
+    int new_cap = g_dict->phrase_capacity ? g_dict->phrase_capacity : TOXIC_DICT_INITIAL;
+    while (new_cap < need) new_cap *= 2;
 
-                strncpy(analysis_data.toxic_phrases_list[idx].phrase,
-                    word, MAX_WORD_LENGTH * 3 - 1);
-                analysis_data.toxic_phrases_list[idx].phrase[MAX_WORD_LENGTH * 3 - 1] = '\0';
+    struct ToxicPhrase* grown = (struct ToxicPhrase*)stage_realloc(g_dict->phrases,
+        sizeof(struct ToxicPhrase) * new_cap);
+    if (!grown) {
+        printf("Error: Memory allocation failed (toxic phrases)\n");
+        return 0;
+    }
+    g_dict->phrases = grown;
+    g_dict->phrase_capacity = new_cap;
+    return 1;
+}
 
-                analysis_data.toxic_phrases_list[idx].severity = severity;
-                analysis_data.toxic_phrases_list[idx].frequency = 0;
+// Allocate an empty slot array (all -1) sized to keep the load factor <= 0.5.
+static int* alloc_index_slots(int count, int* out_size) {
+    int size = 64;
+    while (size < count * 2) size *= 2;
+    int* slots = (int*)stage_malloc(sizeof(int) * size);
+    if (!slots) {
+        printf("Error: Memory allocation failed (toxic index)\n");
+        return NULL;
+    }
+    memset(slots, 0xff, sizeof(int) * size);
+    *out_size = size;
+    return slots;
+}
 
-                if (len == 2 || len == 3) {
-                    analysis_data.toxic_phrases_list[idx].ngram_len = len;
-                }
-                else {
-                    analysis_data.toxic_phrases_list[idx].ngram_len = 0;
-                }
+// Rebuild the word and phrase hash indexes from the dictionary arrays.
+// The first of any duplicate entries wins, as with the old linear scans.
+static void build_toxic_index(void) {
+    if (!toxic_dict_detach()) return;
+    free(g_dict->word_index);
+    free(g_dict->phrase_index);
+    g_dict->word_index = alloc_index_slots(g_dict->word_count,
+        &g_dict->word_index_size);
+    g_dict->phrase_index = alloc_index_slots(g_dict->phrase_count,
+        &g_dict->phrase_index_size);
+    if (!g_dict->word_index || !g_dict->phrase_index) {
+        free(g_dict->word_index);
+        free(g_dict->phrase_index);
+        g_dict->word_index = g_dict->phrase_index = NULL;
+        g_dict->word_index_size = g_dict->phrase_index_size = 0;
+        return;
+    }
 
-                analysis_data.toxic_phrases_count++;
-            }
-        }
-        else {
-            if (analysis_data.toxic_words_count < MAX_TOXIC_WORDS) {
-                int idx = analysis_data.toxic_words_count;
-                strncpy(analysis_data.toxic_words_list[idx].word,
-                    word, MAX_WORD_LENGTH - 1);
-                analysis_data.toxic_words_list[idx].word[MAX_WORD_LENGTH - 1] = '\0';
-                analysis_data.toxic_words_list[idx].severity = severity;
-                analysis_data.toxic_words_list[idx].frequency = 0;
-                analysis_data.toxic_words_count++;
-            }
+    unsigned int mask = (unsigned int)g_dict->word_index_size - 1;
+    for (int i = 0; i < g_dict->word_count; i++) {
+        unsigned int slot = hash_string(g_dict->words[i].word) & mask;
+        int dup = 0;
+        while (g_dict->word_index[slot] != -1) {
+            int j = g_dict->word_index[slot];
+            if (strcmp(g_dict->words[j].word, g_dict->words[i].word) == 0) { dup = 1; break; }
+            slot = (slot + 1) & mask;
         }
+        if (!dup) g_dict->word_index[slot] = i;
     }
 
-    fclose(file);
-    printf("Loaded %d toxic words and %d toxic phrases from %s\n",
-        analysis_data.toxic_words_count, analysis_data.toxic_phrases_count, filename);
-    sync_toxic_systems();
+    mask = (unsigned int)g_dict->phrase_index_size - 1;
+    for (int i = 0; i < g_dict->phrase_count; i++) {
+        unsigned int slot = hash_string(g_dict->phrases[i].phrase) & mask;
+        int dup = 0;
+        while (g_dict->phrase_index[slot] != -1) {
+            int j = g_dict->phrase_index[slot];
+            if (strcmp(g_dict->phrases[j].phrase, g_dict->phrases[i].phrase) == 0) { dup = 1; break; }
+            slot = (slot + 1) & mask;
+        }
+        if (!dup) g_dict->phrase_index[slot] = i;
+    }
 }
 
-// Check if a word is toxic (works for both Stage 3 and Stage 4)
-int is_toxic_word(const char* word) {
-    if (!word || !*word) return 0;
+// Index of a word in the dictionary (case-insensitive), or -1.
+static int toxic_word_lookup(const char* word) {
+    if (!g_dict->word_index) return -1;
 
-    char tmp[MAX_WORD_LENGTH];
-    strncpy(tmp, word, MAX_WORD_LENGTH - 1);
-    tmp[MAX_WORD_LENGTH - 1] = '\0';
+    char key[MAX_WORD_LENGTH];
+    size_t n = 0;
+    for (; word[n] && n < MAX_WORD_LENGTH - 1; n++) key[n] = (char)TOLOWER(word[n]);
+    if (word[n]) return -1; // Longer than any stored word
+    key[n] = '\0';
 
-    size_t len = strlen(tmp);
-    while (len > 0 && isspace((unsigned char)tmp[len - 1])) {
-        tmp[--len] = '\0';
+    unsigned int mask = (unsigned int)g_dict->word_index_size - 1;
+    unsigned int slot = hash_string(key) & mask;
+    while (g_dict->word_index[slot] != -1) {
+        int i = g_dict->word_index[slot];
+        if (strcmp(g_dict->words[i].word, key) == 0) return i;
+        slot = (slot + 1) & mask;
     }
+    return -1;
+}
 
-    for (size_t i = 0; i < len; ++i) {
-        tmp[i] = (char)tolower((unsigned char)tmp[i]);
-    }
+// Index of a phrase in the dictionary (case-insensitive), or -1.
+static int toxic_phrase_lookup(const char* phrase) {
+    if (!g_dict->phrase_index) return -1;
 
-    // Check Stage 3 system first
-    for (int i = 0; i < analysis_data.toxic_words_count; i++) {
-        if (string_case_insensitive_compare(tmp, analysis_data.toxic_words_list[i].word) == 0) {
-            return 1;
-        }
-    }
+    char key[MAX_WORD_LENGTH * 3];
+    size_t n = 0;
+    for (; phrase[n] && n < sizeof(key) - 1; n++) key[n] = (char)TOLOWER(phrase[n]);
+    if (phrase[n]) return -1;
+    key[n] = '\0';
 
-    // 3) Make sure Dictionary of Stage 4 already be loaded
-    if (!g_toxic_loaded) {
-        load_toxicwords();
+    unsigned int mask = (unsigned int)g_dict->phrase_index_size - 1;
+    unsigned int slot = hash_string(key) & mask;
+    while (g_dict->phrase_index[slot] != -1) {
+        int i = g_dict->phrase_index[slot];
+        if (strcmp(g_dict->phrases[i].phrase, key) == 0) return i;
+        slot = (slot + 1) & mask;
     }
+    return -1;
+}
 
-    // Also check Stage 4 system as backup
-    for (int i = 0; i < g_toxic_count; i++) {
-        if (string_case_insensitive_compare(tmp, g_toxic[i]) == 0) {
-            return 1;
-        }
-    }
+// ----- In-place dictionary edits (hash index + ordered index kept current) -----
 
-    return 0;
+static const char* toxic_word_key(int i) { return g_dict->words[i].word; }
+static const char* toxic_phrase_key(int i) { return g_dict->phrases[i].phrase; }
+
+// Insert value under key into a linear-probing slot array.
+static void index_insert(int* slots, int size, const char* key, int value) {
+    unsigned int mask = (unsigned int)size - 1;
+    unsigned int slot = hash_string(key) & mask;
+    while (slots[slot] != -1) slot = (slot + 1) & mask;
+    slots[slot] = value;
 }
 
-// Retrieve the defined severity level (1–5) of a toxic word.
-// Returns 0 if the word is not classified as toxic.
-int get_toxic_severity(const char* word) {
-    for (int i = 0; i < analysis_data.toxic_words_count; i++) {
-        if (string_case_insensitive_compare(word, analysis_data.toxic_words_list[i].word) == 0) {
-            return analysis_data.toxic_words_list[i].severity;
+// Remove value from a linear-probing slot array, shifting later entries of
+// the probe run back so lookups never need tombstones.
+static void index_remove(int* slots, int size, int value, const char* (*key_of)(int)) {
+    unsigned int mask = (unsigned int)size - 1;
+    unsigned int hole = hash_string(key_of(value)) & mask;
+    while (slots[hole] != value) {
+        if (slots[hole] == -1) return;
+        hole = (hole + 1) & mask;
+    }
+    slots[hole] = -1;
+
+    for (unsigned int j = (hole + 1) & mask; slots[j] != -1; j = (j + 1) & mask) {
+        unsigned int home = hash_string(key_of(slots[j])) & mask;
+        // Entries whose home lies cyclically in (hole, j] must stay put
+        bool stays = (hole <= j) ? (home > hole && home <= j) : (home > hole || home <= j);
+        if (!stays) {
+            slots[hole] = slots[j];
+            slots[j] = -1;
+            hole = j;
         }
     }
-    return 0;
 }
 
-// Return the index of a toxic word in the internal dictionary.
-// Returns -1 if not found.
-int find_toxic_index(const char* word) {
-    for (int i = 0; i < analysis_data.toxic_words_count; i++) {
-        if (string_case_insensitive_compare(word, analysis_data.toxic_words_list[i].word) == 0)
-            return i;
+// Point the slot holding old_value at new_value (entry moved within the array).
+static void index_relabel(int* slots, int size, const char* key, int old_value, int new_value) {
+    unsigned int mask = (unsigned int)size - 1;
+    unsigned int slot = hash_string(key) & mask;
+    while (slots[slot] != -1) {
+        if (slots[slot] == old_value) { slots[slot] = new_value; return; }
+        slot = (slot + 1) & mask;
     }
-    return -1;
 }
 
-// Update frequency and severity statistics for a toxic word occurrence.
-void detect_toxic_content(const char* word) {
-    if (is_toxic_word(word)) {
-        analysis_data.total_toxic_occurrences++;
-        int severity = get_toxic_severity(word);
+static int cmp_toxic_order(const void* a, const void* b) {
+    return strcmp(g_dict->words[*(const int*)a].word,
+        g_dict->words[*(const int*)b].word);
+}
 
-        for (int i = 0; i < analysis_data.toxic_words_count; i++) {
-            if (string_case_insensitive_compare(word, analysis_data.toxic_words_list[i].word) == 0) {
-                analysis_data.toxic_words_list[i].frequency++;
-                break;
-            }
-        }
+// Return the alphabetical order index, building it on first use.
+static const int* toxic_word_order(void) {
+    if (!g_dict->word_order) {
+        int cap = g_dict->word_capacity > 0 ? g_dict->word_capacity : 1;
+        g_dict->word_order = (int*)stage_malloc(sizeof(int) * cap);
+        if (!g_dict->word_order) return NULL;
+        for (int i = 0; i < g_dict->word_count; i++) g_dict->word_order[i] = i;
+        qsort(g_dict->word_order, g_dict->word_count, sizeof(int), cmp_toxic_order);
+    }
+    return g_dict->word_order;
+}
 
-        if (severity >= 1 && severity <= 5) {
-            analysis_data.severity_count[severity]++;
-        }
+// Binary-search the ordered index: position of word, or where it would go.
+static int toxic_order_position(const char* word) {
+    int lo = 0, hi = g_dict->word_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (strcmp(g_dict->words[g_dict->word_order[mid]].word, word) < 0) lo = mid + 1;
+        else hi = mid;
     }
+    return lo;
 }
 
-// Detect toxic phrases (2-gram or 3-gram) formed by consecutive words.
-// Matches phrases defined in the dictionary and updates frequency counts.
-void detect_toxic_phrases() {
-    if (analysis_data.original_word_count < 2) return;
+// Position in the ordered index that holds entry idx (steps over duplicates).
+static int toxic_order_slot_of(int idx) {
+    int pos = toxic_order_position(g_dict->words[idx].word);
+    while (pos < g_dict->word_count - 1 && g_dict->word_order[pos] != idx) pos++;
+    return pos;
+}
 
-    for (int i = 0; i <= analysis_data.original_word_count - 2; i++) {
+// Append a word (lowercase) to the dictionary. Returns its index or -1.
+static int dict_add_word(const char* word, int severity) {
+    if (toxic_word_lookup(word) != -1 || !toxic_dict_detach() ||
+        !reserve_toxic_words(g_dict->word_count + 1)) return -1;
 
-        // ==== 2-gram ====
-        char phrase2[MAX_WORD_LENGTH * 3] = "";
-        strncat(phrase2, analysis_data.original_word_list[i], MAX_WORD_LENGTH);
-        strcat(phrase2, " ");
-        strncat(phrase2, analysis_data.original_word_list[i + 1], MAX_WORD_LENGTH);
+    int idx = g_dict->word_count;
+    struct ToxicWord* w = &g_dict->words[idx];
+    strncpy(w->word, word, MAX_WORD_LENGTH - 1);
+    w->word[MAX_WORD_LENGTH - 1] = '\0';
+    w->severity = severity;
+    w->frequency = 0;
+    w->fuzzy_frequency = 0;
+
+    if (g_dict->word_order) {
+        int pos = toxic_order_position(w->word);
+        memmove(g_dict->word_order + pos + 1, g_dict->word_order + pos,
+            sizeof(int) * (g_dict->word_count - pos));
+        g_dict->word_order[pos] = idx;
+    }
+    g_dict->word_count++;
 
-        for (int j = 0; j < analysis_data.toxic_phrases_count; j++) {
-            if (analysis_data.toxic_phrases_list[j].ngram_len != 2) continue;
+    if (g_dict->word_index &&
+        g_dict->word_count * 2 <= g_dict->word_index_size) {
+        index_insert(g_dict->word_index, g_dict->word_index_size, w->word, idx);
+    }
+    else {
+        build_toxic_index();
+    }
+    return idx;
+}
 
-            if (string_case_insensitive_compare(phrase2,
-                analysis_data.toxic_phrases_list[j].phrase) == 0) {
+// Remove the word at idx by moving the last entry into its place.
+static void dict_remove_word(int idx) {
+    if (!toxic_dict_detach()) return;
+    int last = g_dict->word_count - 1;
 
-                analysis_data.toxic_phrases_list[j].frequency++;
-                analysis_data.bigram_toxic_occurrences++;
+    index_remove(g_dict->word_index, g_dict->word_index_size, idx, toxic_word_key);
+    if (g_dict->word_order) {
+        int pos = toxic_order_slot_of(idx);
+        memmove(g_dict->word_order + pos, g_dict->word_order + pos + 1,
+            sizeof(int) * (last - pos));
+    }
+    g_dict->word_count--;
 
-                break;
-            }
+    if (idx != last) {
+        const char* moved = g_dict->words[last].word;
+        index_relabel(g_dict->word_index, g_dict->word_index_size, moved, last, idx);
+        if (g_dict->word_order) {
+            g_dict->word_order[toxic_order_slot_of(last)] = idx;
         }
+        g_dict->words[idx] = g_dict->words[last];
+    }
+}
 
-        // ==== 3-gram ====
-        if (i <= analysis_data.original_word_count - 3) {
-            char phrase3[MAX_WORD_LENGTH * 3] = "";
-            strncat(phrase3, analysis_data.original_word_list[i], MAX_WORD_LENGTH);
-            strcat(phrase3, " ");
-            strncat(phrase3, analysis_data.original_word_list[i + 1], MAX_WORD_LENGTH);
-            strcat(phrase3, " ");
-            strncat(phrase3, analysis_data.original_word_list[i + 2], MAX_WORD_LENGTH);
+// Append a phrase (lowercase) to the dictionary. Returns its index or -1.
+static int dict_add_phrase(const char* phrase, int severity, int word_count) {
+    if (!toxic_dict_detach() || !reserve_toxic_phrases(g_dict->phrase_count + 1)) return -1;
 
-            for (int j = 0; j < analysis_data.toxic_phrases_count; j++) {
-                if (analysis_data.toxic_phrases_list[j].ngram_len != 3) continue;
+    int idx = g_dict->phrase_count;
+    struct ToxicPhrase* ph = &g_dict->phrases[idx];
+    strncpy(ph->phrase, phrase, MAX_WORD_LENGTH * 3 - 1);
+    ph->phrase[MAX_WORD_LENGTH * 3 - 1] = '\0';
+    ph->severity = severity;
+    ph->frequency = 0;
+    ph->ngram_len = (word_count == 2 || word_count == 3) ? word_count : 0;
+    g_dict->phrase_count++;
 
-                if (string_case_insensitive_compare(phrase3,
-                    analysis_data.toxic_phrases_list[j].phrase) == 0) {
+    if (g_dict->phrase_index &&
+        g_dict->phrase_count * 2 <= g_dict->phrase_index_size) {
+        index_insert(g_dict->phrase_index, g_dict->phrase_index_size, ph->phrase, idx);
+    }
+    else {
+        build_toxic_index();
+    }
+    return idx;
+}
 
-                    analysis_data.toxic_phrases_list[j].frequency++;
-                    analysis_data.trigram_toxic_occurrences++;
+// Remove the phrase at idx by moving the last entry into its place.
+static void dict_remove_phrase(int idx) {
+    if (!toxic_dict_detach()) return;
+    int last = g_dict->phrase_count - 1;
+    index_remove(g_dict->phrase_index, g_dict->phrase_index_size, idx, toxic_phrase_key);
+    if (idx != last) {
+        index_relabel(g_dict->phrase_index, g_dict->phrase_index_size,
+            g_dict->phrases[last].phrase, last, idx);
+        g_dict->phrases[idx] = g_dict->phrases[last];
+    }
+    g_dict->phrase_count--;
+}
 
-                    break;
-                }
-            }
-        }
-    }
+// Derive a sibling path of the dictionary file with another extension.
+static void toxic_sibling_path(const char* filename, const char* ext, char* out, size_t cap) {
+    strncpy(out, filename, cap - strlen(ext) - 1);
+    out[cap - strlen(ext) - 1] = '\0';
+    char* dot = strrchr(out, '.');
+    if (dot && !strchr(dot, '/') && !strchr(dot, '\\')) *dot = '\0';
+    strcat(out, ext);
 }
 
-// Analyse a phrase to determine how many toxic words it contains,
-// store them in the provided buffer, and return the maximum severity.
-int phrase_contains_toxic_words(const char* phrase, char found_words[][MAX_WORD_LENGTH], int max_found, int* max_severity) {
-    if (!phrase || !*phrase) return 0;
+// Append one edit to the journal: "+entry,severity" or "-entry".
+// This is the only I/O per edit; the text file is rewritten on compaction.
+static void journal_toxic_edit(char op, const char* entry, int severity) {
+    char path[260];
+    toxic_sibling_path(g_toxic_source_path, ".journal", path, sizeof(path));
 
-    char phrase_copy[MAX_WORD_LENGTH * 3];
-    strcpy(phrase_copy, phrase);
+    FILE* f = fopen(path, "a");
+    if (!f) {
+        // Journal unavailable: fall back to rewriting the dictionary file
+        printf("[!] Cannot append to %s, saving dictionary instead\n", path);
+        save_toxic_dictionary(g_toxic_source_path);
+        return;
+    }
+    if (op == '+') fprintf(f, "+%s,%d\n", entry, severity);
+    else           fprintf(f, "-%s\n", entry);
+    fclose(f);
 
-    int found_count = 0;
-    int local_max_sev = 0;
+    g_toxic_journal_entries++;
+    toxic_dict_changed();
+    if (g_toxic_journal_entries >= TOXIC_JOURNAL_COMPACT_AT) {
+        compact_toxic_journal();
+    }
+}
 
-    char* word = strtok(phrase_copy, " ");
-    while (word != NULL && found_count < max_found) {
-        if (is_toxic_word(word)) {
-            strcpy(found_words[found_count], word);
-            int sev = get_toxic_severity(word);
-            if (sev > local_max_sev) local_max_sev = sev;
-            found_count++;
+// Re-apply journalled edits on top of the freshly loaded dictionary.
+static void replay_toxic_journal(const char* filename) {
+    char path[260];
+    toxic_sibling_path(filename, ".journal", path, sizeof(path));
+    g_toxic_journal_entries = 0;
+
+    FILE* f = fopen(path, "r");
+    if (!f) return;
+
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '+' && line[0] != '-') continue;
+        g_toxic_journal_entries++;
+
+        char* entry = line + 1;
+        int severity = 3;
+        if (line[0] == '+') {
+            char* comma = strrchr(entry, ',');
+            if (!comma) continue;
+            *comma = '\0';
+            severity = atoi(comma + 1);
+            if (severity < 1 || severity > 5) severity = 3;
+        }
+        if (!*entry) continue;
+
+        bool is_phrase = strchr(entry, ' ') != NULL;
+        if (line[0] == '+') {
+            if (!is_phrase) {
+                dict_add_word(entry, severity);
+            }
+            else {
+                int words = 1;
+                for (char* p = entry; *p; p++) if (*p == ' ') words++;
+                dict_add_phrase(entry, severity, words);
+            }
+        }
+        else {
+            int idx = is_phrase ? toxic_phrase_lookup(entry) : toxic_word_lookup(entry);
+            if (idx != -1) {
+                if (is_phrase) dict_remove_phrase(idx);
+                else           dict_remove_word(idx);
+            }
         }
-        word = strtok(NULL, " ");
     }
+    fclose(f);
 
-    if (max_severity) {
-        *max_severity = local_max_sev;
+    if (g_toxic_journal_entries > 0) {
+        printf("Replayed %d journalled dictionary edit(s)\n", g_toxic_journal_entries);
     }
-    return found_count;
 }
 
-// Reset all toxicity-related counters before performing a new analysis run.
-void reset_toxic_counts() {
-    analysis_data.total_toxic_occurrences = 0;
-    analysis_data.toxicity_density = 0.0;
-    memset(analysis_data.severity_count, 0, sizeof(analysis_data.severity_count));
-    analysis_data.bigram_toxic_occurrences = 0;
-    analysis_data.trigram_toxic_occurrences = 0;
+// Fold the journal into the dictionary file (and its compiled copy), then empty it.
+void compact_toxic_journal(void) {
+    if (g_toxic_journal_entries == 0) return;
 
-    for (int i = 0; i < analysis_data.toxic_words_count; i++) {
-        analysis_data.toxic_words_list[i].frequency = 0;
-    }
-    for (int i = 0; i < analysis_data.toxic_phrases_count; i++) {
-        analysis_data.toxic_phrases_list[i].frequency = 0;
-    }
+    save_toxic_dictionary(g_toxic_source_path);
+
+    char path[260];
+    toxic_sibling_path(g_toxic_source_path, ".journal", path, sizeof(path));
+    remove(path);
+    g_toxic_journal_entries = 0;
 }
 
-// Compute toxicity density as a percentage of toxic words among all filtered words.
-void calculate_toxicity_density() {
-    if (analysis_data.total_words_filtered > 0) {
-        analysis_data.toxicity_density = (float)analysis_data.total_toxic_occurrences /
-            analysis_data.total_words_filtered * 100;
-    }
-    else {
-        analysis_data.toxicity_density = 0.0;
-    }
+// Derive the compiled dictionary path: "toxicwords.txt" -> "toxicwords.bin".
+static void toxic_compiled_path(const char* filename, char* out, size_t cap) {
+    toxic_sibling_path(filename, ".bin", out, cap);
 }
 
-// Execute the full toxic detection pipeline.
-// Handles normalisation, word-list selection, toxicity scanning,
-// phrase detection, and final density computation.
-void run_toxic_analysis(void) {
-    if (!analysis_data.text_filtered) {
-        printf("No text filtered. Please load and process a file first.\n");
+// Write the in-memory dictionary (and its hash indexes) as a compiled file.
+static int compile_toxic_dictionary(const char* bin_path) {
+    if (!g_dict->word_index || !g_dict->phrase_index) return 0;
+
+    uint32_t entry_count = (uint32_t)(g_dict->word_count + g_dict->phrase_count);
+    size_t pool_size = 0;
+    for (int i = 0; i < g_dict->word_count; i++) pool_size += strlen(g_dict->words[i].word) + 1;
+    for (int i = 0; i < g_dict->phrase_count; i++) pool_size += strlen(g_dict->phrases[i].phrase) + 1;
+
+    size_t entries_bytes = sizeof(struct ToxicBinEntry) * entry_count;
+    size_t index_bytes = sizeof(uint32_t) * (g_dict->word_index_size + g_dict->phrase_index_size);
+    size_t payload_size = entries_bytes + index_bytes + pool_size;
+    unsigned char* payload = (unsigned char*)stage_calloc(1, payload_size);
+    if (!payload) return 0;
+
+    struct ToxicBinEntry* entries = (struct ToxicBinEntry*)payload;
+    uint32_t* slots = (uint32_t*)(payload + entries_bytes);
+    char* pool = (char*)(payload + entries_bytes + index_bytes);
+
+    uint32_t off = 0;
+    for (uint32_t e = 0; e < entry_count; e++) {
+        const char* text;
+        int sev, ngram = 0;
+        if (e < (uint32_t)g_dict->word_count) {
+            text = g_dict->words[e].word;
+            sev = g_dict->words[e].severity;
+        }
+        else {
+            const struct ToxicPhrase* ph = &g_dict->phrases[e - g_dict->word_count];
+            text = ph->phrase;
+            sev = ph->severity;
+            ngram = ph->ngram_len;
+        }
+        size_t len = strlen(text);
+        entries[e].offset = off;
+        entries[e].severity = (uint8_t)sev;
+        entries[e].ngram_len = (uint8_t)ngram;
+        entries[e].length = (uint16_t)len;
+        memcpy(pool + off, text, len + 1);
+        off += (uint32_t)(len + 1);
+    }
+    for (int i = 0; i < g_dict->word_index_size; i++) {
+        slots[i] = (uint32_t)g_dict->word_index[i];
+    }
+    for (int i = 0; i < g_dict->phrase_index_size; i++) {
+        slots[g_dict->word_index_size + i] = (uint32_t)g_dict->phrase_index[i];
+    }
+
+    struct ToxicBinHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TOXIC_BIN_MAGIC, sizeof(TOXIC_BIN_MAGIC));
+    hdr.version = TOXIC_BIN_VERSION;
+    hdr.word_count = (uint32_t)g_dict->word_count;
+    hdr.phrase_count = (uint32_t)g_dict->phrase_count;
+    hdr.word_index_size = (uint32_t)g_dict->word_index_size;
+    hdr.phrase_index_size = (uint32_t)g_dict->phrase_index_size;
+    hdr.pool_size = (uint32_t)pool_size;
+    hdr.checksum = hash_bytes(payload, payload_size);
+
+    FILE* f = fopen(bin_path, "wb");
+    int ok = 0;
+    if (f) {
+        ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+            fwrite(payload, 1, payload_size, f) == payload_size;
+        ok = (fclose(f) == 0) && ok;
+        if (!ok) remove(bin_path);
+    }
+    free(payload);
+    return ok;
+}
+
+// Load a compiled dictionary. The file is mapped, checked (magic, version,
+// exact size, checksum, bounds) and copied into the dictionary arrays; the
+// prebuilt hash indexes are taken over as-is instead of being rehashed.
+// Returns 0 if the file is missing or invalid so the caller can use the text source.
+static int load_compiled_toxic_dictionary(const char* bin_path) {
+    size_t size = 0;
+    unsigned char* base = (unsigned char*)map_file_readonly(bin_path, &size);
+    if (!base) return 0;
+
+    int ok = 0;
+    const struct ToxicBinHeader* hdr = (const struct ToxicBinHeader*)base;
+    if (size < sizeof(*hdr) ||
+        memcmp(hdr->magic, TOXIC_BIN_MAGIC, sizeof(TOXIC_BIN_MAGIC)) != 0 ||
+        hdr->version != TOXIC_BIN_VERSION ||
+        hdr->word_count > size / sizeof(struct ToxicBinEntry) ||
+        hdr->phrase_count > size / sizeof(struct ToxicBinEntry) ||
+        hdr->word_index_size == 0 || (hdr->word_index_size & (hdr->word_index_size - 1)) != 0 ||
+        hdr->phrase_index_size == 0 || (hdr->phrase_index_size & (hdr->phrase_index_size - 1)) != 0 ||
+        hdr->word_index_size > (1u << 26) || hdr->phrase_index_size > (1u << 26)) {
+        goto done;
+    }
+
+    uint32_t entry_count = hdr->word_count + hdr->phrase_count;
+    size_t entries_bytes = sizeof(struct ToxicBinEntry) * entry_count;
+    size_t index_bytes = sizeof(uint32_t) * ((size_t)hdr->word_index_size + hdr->phrase_index_size);
+    if (size != sizeof(*hdr) + entries_bytes + index_bytes + hdr->pool_size) goto done;
+
+    const unsigned char* payload = base + sizeof(*hdr);
+    if (hash_bytes(payload, size - sizeof(*hdr)) != hdr->checksum) {
+        printf("[!] %s failed checksum validation, rebuilding from text\n", bin_path);
+        goto done;
+    }
+
+    const struct ToxicBinEntry* entries = (const struct ToxicBinEntry*)payload;
+    const uint32_t* slots = (const uint32_t*)(payload + entries_bytes);
+    const char* pool = (const char*)(payload + entries_bytes + index_bytes);
+
+    for (uint32_t e = 0; e < entry_count; e++) {
+        size_t cap = (e < hdr->word_count) ? MAX_WORD_LENGTH : MAX_WORD_LENGTH * 3;
+        if ((size_t)entries[e].offset + entries[e].length >= hdr->pool_size ||
+            entries[e].length >= cap || pool[entries[e].offset + entries[e].length] != '\0') {
+            goto done;
+        }
+    }
+    for (size_t i = 0; i < (size_t)hdr->word_index_size + hdr->phrase_index_size; i++) {
+        uint32_t limit = (i < hdr->word_index_size) ? hdr->word_count : hdr->phrase_count;
+        if (slots[i] != 0xFFFFFFFFu && slots[i] >= limit) goto done;
+    }
+
+    int* word_index = (int*)stage_malloc(sizeof(int) * hdr->word_index_size);
+    int* phrase_index = (int*)stage_malloc(sizeof(int) * hdr->phrase_index_size);
+    if (!word_index || !phrase_index ||
+        !reserve_toxic_words((int)hdr->word_count) || !reserve_toxic_phrases((int)hdr->phrase_count)) {
+        free(word_index);
+        free(phrase_index);
+        goto done;
+    }
+    memcpy(word_index, slots, sizeof(int) * hdr->word_index_size);
+    memcpy(phrase_index, slots + hdr->word_index_size, sizeof(int) * hdr->phrase_index_size);
+
+    for (uint32_t e = 0; e < hdr->word_count; e++) {
+        struct ToxicWord* w = &g_dict->words[e];
+        memcpy(w->word, pool + entries[e].offset, entries[e].length + 1);
+        w->severity = entries[e].severity;
+        w->frequency = 0;
+        w->fuzzy_frequency = 0;
+    }
+    for (uint32_t p = 0; p < hdr->phrase_count; p++) {
+        const struct ToxicBinEntry* en = &entries[hdr->word_count + p];
+        struct ToxicPhrase* ph = &g_dict->phrases[p];
+        memcpy(ph->phrase, pool + en->offset, en->length + 1);
+        ph->severity = en->severity;
+        ph->ngram_len = en->ngram_len;
+        ph->frequency = 0;
+    }
+    g_dict->word_count = (int)hdr->word_count;
+    g_dict->phrase_count = (int)hdr->phrase_count;
+
+    free(g_dict->word_index);
+    free(g_dict->phrase_index);
+    g_dict->word_index = word_index;
+    g_dict->word_index_size = (int)hdr->word_index_size;
+    g_dict->phrase_index = phrase_index;
+    g_dict->phrase_index_size = (int)hdr->phrase_index_size;
+    ok = 1;
+
+done:
+    unmap_file(base, size);
+    return ok;
+}
+
+// Load toxic words and phrases from a dictionary file.
+// A compiled copy (<name>.bin) is used when it is at least as new as the
+// text file; otherwise the text is parsed and the compiled copy regenerated.
+// Edits journalled since the last compaction are replayed on top.
+void load_toxic_data(const char* filename) {
+    char bin_path[260];
+    toxic_compiled_path(filename, bin_path, sizeof(bin_path));
+    strncpy(g_toxic_source_path, filename, sizeof(g_toxic_source_path) - 1);
+    g_toxic_source_path[sizeof(g_toxic_source_path) - 1] = '\0';
+    g_toxic_loaded = 1;
+    // Readers still holding the previous dictionary keep their snapshot
+    if (!toxic_dict_reset()) return;
+
+    time_t text_time = file_mtime(filename);
+    time_t bin_time = file_mtime(bin_path);
+    if (bin_time != 0 && bin_time >= text_time && load_compiled_toxic_dictionary(bin_path)) {
+        printf("Loaded %d toxic words and %d toxic phrases from %s (compiled)\n",
+            g_dict->word_count, g_dict->phrase_count, bin_path);
+        replay_toxic_journal(filename);
+        toxic_dict_changed();
         return;
     }
 
-    char filename_to_use[256] = "";
-    bool need_reprocess = false;
-    bool manual_source_match = false;
-    bool saved_without_normalisation = false;
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        printf("Warning: Cannot open toxic data file: %s\n", filename);
+        return;
+    }
 
-    const char* manual_name =
-        (strlen(current_manual_filtered_filename) > 0)
-        ? current_manual_filtered_filename
-        : "filtered_words.txt";
+    g_dict->word_count = 0;
+    g_dict->phrase_count = 0;
+    char line[256];
 
-    if (user_manually_saved_current_session) {
-        FILE* f = fopen(manual_name, "r");
-        if (f) {
-            char line[512];
-            char source_path[256] = "";
+    printf("Loading toxic data from %s...\n", filename);
 
-            while (fgets(line, sizeof(line), f)) {
-                line[strcspn(line, "\r\n")] = 0;
-                if (line[0] != '#') break;
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\n")] = '\0';
+        line[strcspn(line, "\r")] = '\0';
 
-                if (strstr(line, "TextNormalisation: disabled"))
-                    saved_without_normalisation = true;
-                else if (strstr(line, "TextNormalisation: enabled"))
-                    saved_without_normalisation = false;
-                else if (!strncmp(line, "# SourceFile:", 13)) {
-                    const char* p = line + 13;
-                    while (*p == ' ' || *p == '\t') p++;
-                    strncpy(source_path, p, sizeof(source_path) - 1);
-                    source_path[sizeof(source_path) - 1] = '\0';
-                }
-            }
+        if (strlen(line) == 0 || line[0] == '#') continue;
 
-            if (source_path[0] && current_filename[0] &&
-                strcmp(source_path, current_filename) == 0) {
-                manual_source_match = true;
-            }
-            fclose(f);
+        char* token = strtok(line, ",");
+        if (!token) continue;
+
+        char word[MAX_WORD_LENGTH * 3];
+        strncpy(word, token, sizeof(word) - 1);
+        word[sizeof(word) - 1] = '\0';
+
+        trim_inplace(word);
+        tolower_inplace(word);
+
+        token = strtok(NULL, ",");
+        if (!token) {
+            printf("Warning: Invalid line (no severity): %s\n", line);
+            continue;
         }
-    }
+        trim_inplace(token);
+        int severity = atoi(token);
+        if (severity < 1 || severity > 5) severity = 3;
 
-    bool using_manual_file = user_manually_saved_current_session && manual_source_match;
+        if (strchr(word, ' ') != NULL) {
+            if (reserve_toxic_phrases(g_dict->phrase_count + 1)) {
+                int idx = g_dict->phrase_count;
 
-    if (using_manual_file) {
-        if (saved_without_normalisation) {
-            printf("\nWARNING: Your filtered word list was saved WITHOUT Text Normalisation.\n");
-            printf("This means abbreviations and Leet Speak won't be expanded.\n");
-            printf("Do you want to:\n");
-            printf("1. Use the non-normalised file (faster, less accurate)\n");
-            printf("2. Re-process with Text Normalisation (recommended)\n");
-            printf("Enter your option (1-2): ");
+                int len = 1;
+                for (char* p = word; *p; ++p) {
+                    if (*p == ' ') len++;
+                }
 
-            char option;
-            scanf(" %c", &option);
+                snprintf(g_dict->phrases[idx].phrase, sizeof(g_dict->phrases[idx].phrase), "%s", word);
 
-            if (option == '1') {
-                printf("\nUsing non-normalised file for analysis: %s\n", manual_name);
-                strcpy(filename_to_use, manual_name);
-            }
-            else {
-                printf("\nRe-processing with Text Normalisation...\n");
-                if (!analysis_data.variant_processing_enabled) {
-                    analysis_data.variant_processing_enabled = true;
-                    need_reprocess = true;
+                g_dict->phrases[idx].severity = severity;
+                g_dict->phrases[idx].frequency = 0;
+
+                if (len == 2 || len == 3) {
+                    g_dict->phrases[idx].ngram_len = len;
                 }
-                strcpy(filename_to_use, "filtered_words_normalised.txt");
+                else {
+                    g_dict->phrases[idx].ngram_len = 0;
+                }
+
+                g_dict->phrase_count++;
             }
         }
         else {
-            printf("Using your manually saved file: %s\n", manual_name);
-            strcpy(filename_to_use, manual_name);
+            if (reserve_toxic_words(g_dict->word_count + 1)) {
+                int idx = g_dict->word_count;
+                strncpy(g_dict->words[idx].word,
+                    word, MAX_WORD_LENGTH - 1);
+                g_dict->words[idx].word[MAX_WORD_LENGTH - 1] = '\0';
+                g_dict->words[idx].severity = severity;
+                g_dict->words[idx].frequency = 0;
+                g_dict->words[idx].fuzzy_frequency = 0;
+                g_dict->word_count++;
+            }
         }
     }
-    else {
-        printf("No matching manually saved filtered word list for this file.\n");
-        printf("Auto-saving normalised word list for toxic analysis...\n");
 
-        if (!analysis_data.variant_processing_enabled) {
-            printf("Enabling Text Normalisation for better accuracy...\n");
-            analysis_data.variant_processing_enabled = true;
-            need_reprocess = true;
-        }
-        strcpy(filename_to_use, "filtered_words_auto_saved.txt");
+    fclose(file);
+    printf("Loaded %d toxic words and %d toxic phrases from %s\n",
+        g_dict->word_count, g_dict->phrase_count, filename);
+    build_toxic_index();
+    if (!compile_toxic_dictionary(bin_path)) {
+        printf("[!] Could not write compiled dictionary %s\n", bin_path);
     }
+    replay_toxic_journal(filename);
+    toxic_dict_changed();
+}
 
-    if (need_reprocess) {
-        reprocess_with_variants();
+// Exact dictionary membership for an already lowercased, trimmed word.
+static int is_toxic_exact(const char* word) {
+    ensure_toxic_dictionary();
+    return toxic_word_lookup(word) != -1;
+}
+
+// Check if a word is toxic (the single lookup path for every stage)
+int is_toxic_word(const char* word) {
+    if (!word || !*word) return 0;
+
+    char tmp[MAX_WORD_LENGTH];
+    strncpy(tmp, word, MAX_WORD_LENGTH - 1);
+    tmp[MAX_WORD_LENGTH - 1] = '\0';
+
+    size_t len = strlen(tmp);
+    while (len > 0 && isspace((unsigned char)tmp[len - 1])) {
+        tmp[--len] = '\0';
     }
 
-    if (!using_manual_file ||
-        strcmp(filename_to_use, "filtered_words_normalised.txt") == 0) {
-        save_filtered_word_list_auto(filename_to_use);
-        printf("Auto-saved word list: %s\n", filename_to_use);
+    for (size_t i = 0; i < len; ++i) {
+        tmp[i] = (char)tolower((unsigned char)tmp[i]);
     }
 
-    reset_toxic_counts();
-    printf("Starting toxic analysis using: %s\n", filename_to_use);
+    if (is_toxic_exact(tmp)) return 1;
 
-    FILE* file = fopen(filename_to_use, "r");
-    if (!file) {
-        printf("Error: Cannot open filtered word list file: %s\n", filename_to_use);
-        return;
-    }
+    // Fall back to the leetspeak decode ("sh1t", "$hit", "shiiit")
+    return leet_toxic_form(tmp) != NULL;
+}
 
-    char word[MAX_WORD_LENGTH];
-    int word_count = 0;
+// Retrieve the defined severity level (1–5) of a toxic word.
+// Returns 0 if the word is not classified as toxic.
+int get_toxic_severity(const char* word) {
+    int idx = toxic_word_lookup(word);
 
-    while (fgets(word, sizeof(word), file) && word_count < MAX_WORDS) {
-        word[strcspn(word, "\r\n")] = 0;
-        if (strlen(word) > 0) {
-            detect_toxic_content(word);
-            word_count++;
-        }
+    // A disguised spelling inherits the severity of the word it decodes to
+    if (idx == -1) {
+        const char* canonical = leet_toxic_form(word);
+        if (canonical) idx = toxic_word_lookup(canonical);
     }
-    fclose(file);
+    return (idx == -1) ? 0 : g_dict->words[idx].severity;
+}
 
-    printf("Analysed %d words from file\n", word_count);
+// Return the index of a toxic word in the internal dictionary.
+// Returns -1 if not found.
+int find_toxic_index(const char* word) {
+    return toxic_word_lookup(word);
+}
 
-    detect_toxic_phrases();
-    calculate_toxicity_density();
-    printf("Toxic analysis completed.\n");
+// ----- Per-token lookups by interned ID -----
+
+// Resolve a token against the dictionary once; later calls for the same ID
+// are an array read until the dictionary or the leet setting changes.
+static const struct TokenToxicity* token_toxicity(uint32_t id) {
+    ensure_toxic_dictionary();
+    unsigned int stamp = g_toxic_generation * 2 + (analysis_data.leet_normalisation_enabled ? 1 : 0);
+
+    if (id >= g_token_toxicity_cap) {
+        uint32_t new_cap = g_token_toxicity_cap ? g_token_toxicity_cap : INTERN_INITIAL;
+        while (new_cap <= id) new_cap *= 2;
+        struct TokenToxicity* grown = (struct TokenToxicity*)stage_realloc(g_token_toxicity,
+            sizeof(struct TokenToxicity) * new_cap);
+        if (!grown) {
+            static struct TokenToxicity none = { 0, 0, -1, false };
+            return &none;
+        }
+        memset(grown + g_token_toxicity_cap, 0, sizeof(struct TokenToxicity) * (new_cap - g_token_toxicity_cap));
+        g_token_toxicity = grown;
+        g_token_toxicity_cap = new_cap;
+    }
+
+    struct TokenToxicity* t = &g_token_toxicity[id];
+    if (t->stamp != stamp) {
+        const char* word = token_text(id);
+        t->toxic = is_toxic_word(word) != 0;
+        t->severity = t->toxic ? get_toxic_severity(word) : 0;
+        t->dict_index = -1;
+        if (t->toxic) {
+            // Credit leetspeak spellings to the dictionary word they decode to
+            const char* canonical = leet_toxic_form(word);
+            t->dict_index = toxic_word_lookup(canonical ? canonical : word);
+        }
+        t->stamp = stamp;
+    }
+    return t;
 }
 
-// Entry point for Stage 3 toxic content inspection.
-// Loads dictionary if missing and prints detailed toxicity report.
-void toxic_analysis() {
-    if (analysis_data.toxic_words_count == 0 && analysis_data.toxic_phrases_count == 0) {
-        printf("Loading toxic dictionary...\n");
-        load_toxic_data("toxicwords.txt");
-    }
+static int token_is_toxic(uint32_t id) {
+    return token_toxicity(id)->toxic;
+}
 
-    printf("\n=== TOXIC CONTENT ANALYSIS ===\n");
-    printf("Detecting for toxic content...\n");
-    run_toxic_analysis();
+static int token_toxic_severity(uint32_t id) {
+    return token_toxicity(id)->severity;
+}
 
-    if (analysis_data.total_toxic_occurrences == 0) {
-        printf("Your file contains no toxic content.\n");
-        return;
+static unsigned int ngram_hash(uint32_t a, uint32_t b, uint32_t c) {
+    unsigned int h = a * 2654435761u;
+    h ^= b + 0x9e3779b9u + (h << 6) + (h >> 2);
+    h ^= c + 0x9e3779b9u + (h << 6) + (h >> 2);
+    return h;
+}
+
+// Rebuild the n-gram table from the 2- and 3-word phrases. A phrase whose
+// words are not separated by single spaces can never match and is skipped;
+// the first of any duplicate phrases wins, as with toxic_phrase_lookup.
+static int build_ngram_table(void) {
+    if (g_ngram_slots && g_ngram_generation == g_toxic_generation) return 1;
+
+    free(g_ngram_slots);
+    g_ngram_size = 64;
+    while (g_ngram_size < g_dict->phrase_count * 2) g_ngram_size *= 2;
+    g_ngram_slots = (struct NgramSlot*)stage_malloc(sizeof(struct NgramSlot) * g_ngram_size);
+    if (!g_ngram_slots) {
+        g_ngram_size = 0;
+        return 0;
     }
+    for (int i = 0; i < g_ngram_size; i++) g_ngram_slots[i].phrase = -1;
+
+    unsigned int mask = (unsigned int)g_ngram_size - 1;
+    for (int p = 0; p < g_dict->phrase_count; p++) {
+        int n = g_dict->phrases[p].ngram_len;
+        if (n != 2 && n != 3) continue;
+
+        char copy[MAX_WORD_LENGTH * 3];
+        strcpy(copy, g_dict->phrases[p].phrase);
+        uint32_t ids[3] = { TOKEN_NONE, TOKEN_NONE, TOKEN_NONE };
+        int parts = 0;
+        char* w = copy;
+        while (w && parts < 3) {
+            char* sp = strchr(w, ' ');
+            if (sp) *sp = '\0';
+            if (!*w) break;
+            ids[parts++] = intern_word(w);
+            w = sp ? sp + 1 : NULL;
+        }
+        if (w || parts != n) continue; // Empty word or more words than ngram_len
+        if (ids[0] == TOKEN_NONE || ids[1] == TOKEN_NONE || (n == 3 && ids[2] == TOKEN_NONE)) continue;
+
+        unsigned int slot = ngram_hash(ids[0], ids[1], ids[2]) & mask;
+        int dup = 0;
+        while (g_ngram_slots[slot].phrase != -1) {
+            const struct NgramSlot* e = &g_ngram_slots[slot];
+            if (e->a == ids[0] && e->b == ids[1] && e->c == ids[2]) { dup = 1; break; }
+            slot = (slot + 1) & mask;
+        }
+        if (dup) continue;
+        g_ngram_slots[slot].a = ids[0];
+        g_ngram_slots[slot].b = ids[1];
+        g_ngram_slots[slot].c = ids[2];
+        g_ngram_slots[slot].phrase = p;
+    }
+    g_ngram_generation = g_toxic_generation;
+    return 1;
+}
 
-    printf("\n--- TOXIC CONTENT SUMMARY ---\n");
-    printf("Total toxic words detected: %d\n", analysis_data.total_toxic_occurrences);
-    printf("Toxicity score: %.2f%% (%d toxic words out of %d total words detected)\n",
-        analysis_data.toxicity_density,
-        analysis_data.total_toxic_occurrences,
-        analysis_data.total_words_filtered);
+// Phrase index for the token sequence (a, b[, c]), or -1.
+static int ngram_lookup(uint32_t a, uint32_t b, uint32_t c) {
+    unsigned int mask = (unsigned int)g_ngram_size - 1;
+    for (unsigned int slot = ngram_hash(a, b, c) & mask; g_ngram_slots[slot].phrase != -1; slot = (slot + 1) & mask) {
+        const struct NgramSlot* e = &g_ngram_slots[slot];
+        if (e->a == a && e->b == b && e->c == c) return e->phrase;
+    }
+    return -1;
+}
 
-    // All scores are computed at word level (single-word detections).
-    printf(" - Word-level (single words) : %d detections\n",
-        analysis_data.total_toxic_occurrences);
+// ----- Fuzzy matching (bounded edit distance over a BK-tree) -----
 
-    // Phrase detections (bigrams/trigrams) are reported separately and explicitly not included in the main toxicity score.
-    printf(" - Toxic bigram matches      : %d detections (not counted in total)\n",
-        analysis_data.bigram_toxic_occurrences);
-    printf(" - Toxic trigram matches     : %d detections (not counted in total)\n",
-        analysis_data.trigram_toxic_occurrences);
-
-    // Show severity distribution using a simple text-based bar chart.
-    printf("\n--- SEVERITY DISTRIBUTION ---\n");
-    int max_count = 0;
-    for (int i = 1; i <= 5; i++) {
-        if (analysis_data.severity_count[i] > max_count) {
-            max_count = analysis_data.severity_count[i];
-        }
-    }
+// Levenshtein distance between a and b, giving up once it must exceed limit.
+// Returns limit + 1 in that case.
+static int edit_distance_bounded(const char* a, const char* b, int limit) {
+    int la = (int)strlen(a), lb = (int)strlen(b);
+    if (abs(la - lb) > limit) return limit + 1;
 
-    for (int i = 1; i <= 5; i++) {
-        if (analysis_data.severity_count[i] > 0) {
-            float percentage = (float)analysis_data.severity_count[i] / analysis_data.total_toxic_occurrences * 100;
-            int bar_length = max_count > 0 ? (analysis_data.severity_count[i] * 20 / max_count) : 0;
+    int row[MAX_WORD_LENGTH + 1];
+    for (int j = 0; j <= lb; j++) row[j] = j;
 
-            printf("Level %d: ", i);
-            for (int j = 0; j < bar_length; j++) printf("#");
-            printf(" %d words (%.1f%%)\n", analysis_data.severity_count[i], percentage);
+    for (int i = 1; i <= la; i++) {
+        int diag = row[0];
+        int row_min = row[0] = i;
+        for (int j = 1; j <= lb; j++) {
+            int up = row[j];
+            int best = diag + (a[i - 1] != b[j - 1]);
+            if (up + 1 < best) best = up + 1;
+            if (row[j - 1] + 1 < best) best = row[j - 1] + 1;
+            row[j] = best;
+            diag = up;
+            if (best < row_min) row_min = best;
         }
+        if (row_min > limit) return limit + 1;
     }
+    return row[lb];
+}
 
-    // List toxic words detected in this analysis, sorted by frequency.
-    printf("\n--- TOXIC WORDS DETECTED ---\n");
+// (Re)build the BK-tree from the dictionary words if the dictionary changed.
+static int build_bk_tree(void) {
+    if (g_bk_nodes && g_bk_generation == g_toxic_generation) return 1;
 
-    struct ToxicWord sorted_words[MAX_TOXIC_WORDS];
-    int valid_count = 0;
+    free(g_bk_nodes);
+    g_bk_nodes = NULL;
+    g_bk_count = 0;
+    if (g_dict->word_count == 0) return 0;
+
+    g_bk_nodes = (struct BKNode*)stage_malloc(sizeof(struct BKNode) * g_dict->word_count);
+    if (!g_bk_nodes) {
+        printf("Error: Memory allocation failed (fuzzy index)\n");
+        return 0;
+    }
 
-    for (int i = 0; i < analysis_data.toxic_words_count; i++) {
-        if (analysis_data.toxic_words_list[i].frequency > 0) {
-            sorted_words[valid_count] = analysis_data.toxic_words_list[i];
-            valid_count++;
+    for (int w = 0; w < g_dict->word_count; w++) {
+        struct BKNode* node = &g_bk_nodes[g_bk_count];
+        node->word = w;
+        node->dist = 0;
+        node->first_child = -1;
+        node->next_sibling = -1;
+
+        if (g_bk_count > 0) {
+            // Walk down from the root following the edge with the same distance
+            int cur = 0;
+            for (;;) {
+                int d = edit_distance_bounded(g_dict->words[w].word,
+                    g_dict->words[g_bk_nodes[cur].word].word, MAX_WORD_LENGTH);
+                if (d == 0) { node = NULL; break; } // Duplicate entry
+                int child = g_bk_nodes[cur].first_child;
+                while (child != -1 && g_bk_nodes[child].dist != d) child = g_bk_nodes[child].next_sibling;
+                if (child == -1) {
+                    node->dist = d;
+                    node->next_sibling = g_bk_nodes[cur].first_child;
+                    g_bk_nodes[cur].first_child = g_bk_count;
+                    break;
+                }
+                cur = child;
+            }
         }
+        if (node) g_bk_count++;
     }
+    g_bk_generation = g_toxic_generation;
+    return 1;
+}
 
-    // Sort the temporary array in descending order of frequency (simple bubble sort).
-    for (int i = 0; i < valid_count - 1; i++) {
-        for (int j = 0; j < valid_count - i - 1; j++) {
-            if (sorted_words[j].frequency < sorted_words[j + 1].frequency) {
-                struct ToxicWord temp = sorted_words[j];
-                sorted_words[j] = sorted_words[j + 1];
-                sorted_words[j + 1] = temp;
+// Find the closest dictionary word within k edits (ties keep the lower index).
+static int bk_tree_search(const char* word, int k, int* out_distance) {
+    int best = -1, best_d = k + 1;
+    int* stack = (int*)stage_malloc(sizeof(int) * g_bk_count); // Each node is pushed at most once
+    int top = 0;
+    if (!stack) return -1;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        int cur = stack[--top];
+        const char* cand = g_dict->words[g_bk_nodes[cur].word].word;
+        int d = edit_distance_bounded(word, cand, MAX_WORD_LENGTH);
+        if (d <= k && (d < best_d || (d == best_d && g_bk_nodes[cur].word < best))) {
+            best = g_bk_nodes[cur].word;
+            best_d = d;
+        }
+        // Triangle inequality: only edges within [d - k, d + k] can hold matches
+        for (int c = g_bk_nodes[cur].first_child; c != -1; c = g_bk_nodes[c].next_sibling) {
+            if (g_bk_nodes[c].dist >= d - k && g_bk_nodes[c].dist <= d + k) {
+                stack[top++] = c;
             }
         }
     }
+    free(stack);
+    if (out_distance) *out_distance = best_d;
+    return best;
+}
 
-    if (valid_count > 0) {
-        printf("+-----------------+-----------+--------------+\n");
-        printf("| Word            | Frequency | Level (1-5)  |\n");
-        printf("+-----------------+-----------+--------------+\n");
+// Return the memo slot for a token, inserting an empty one if needed.
+static struct FuzzyMemo* fuzzy_memo_slot(const char* token) {
+    if (g_fuzzy_memo_generation != g_toxic_generation) {
+        // Dictionary changed: every memoised answer may be stale
+        free(g_fuzzy_memo);
+        g_fuzzy_memo = NULL;
+        g_fuzzy_memo_size = g_fuzzy_memo_count = 0;
+        g_fuzzy_memo_generation = g_toxic_generation;
+    }
+
+    if ((g_fuzzy_memo_count + 1) * 2 > g_fuzzy_memo_size) {
+        int new_size = g_fuzzy_memo_size ? g_fuzzy_memo_size * 2 : 1024;
+        struct FuzzyMemo* grown = (struct FuzzyMemo*)stage_calloc(new_size, sizeof(struct FuzzyMemo));
+        if (!grown) return NULL;
+        for (int i = 0; i < g_fuzzy_memo_size; i++) {
+            if (!g_fuzzy_memo[i].token[0]) continue;
+            unsigned int slot = hash_string(g_fuzzy_memo[i].token) & (new_size - 1);
+            while (grown[slot].token[0]) slot = (slot + 1) & (new_size - 1);
+            grown[slot] = g_fuzzy_memo[i];
+        }
+        free(g_fuzzy_memo);
+        g_fuzzy_memo = grown;
+        g_fuzzy_memo_size = new_size;
+    }
+
+    unsigned int mask = (unsigned int)g_fuzzy_memo_size - 1;
+    unsigned int slot = hash_string(token) & mask;
+    while (g_fuzzy_memo[slot].token[0]) {
+        if (strcmp(g_fuzzy_memo[slot].token, token) == 0) return &g_fuzzy_memo[slot];
+        slot = (slot + 1) & mask;
+    }
+    strncpy(g_fuzzy_memo[slot].token, token, MAX_WORD_LENGTH - 1);
+    g_fuzzy_memo[slot].match = -2; // Not searched yet
+    g_fuzzy_memo_count++;
+    return &g_fuzzy_memo[slot];
+}
 
-        for (int i = 0; i < valid_count; i++) {
-            // Compute how many digits the frequency has, so we can centre it in the column.
-            int freq = sorted_words[i].frequency;
-            int freq_digits = 0;
-            if (freq == 0) freq_digits = 1;
-            else {
-                int temp = freq;
-                while (temp > 0) {
-                    freq_digits++;
-                    temp /= 10;
-                }
-            }
+// Fuzzy-match a token against the dictionary, searching each distinct token
+// once. Returns NULL when fuzzy mode is off or nothing lies within range.
+// Tokens under 4 letters are skipped: one edit away from most short words.
+static struct FuzzyMemo* fuzzy_toxic_lookup(const char* word) {
+    if (!analysis_data.fuzzy_matching_enabled || strlen(word) < 4) return NULL;
+    if (!build_bk_tree()) return NULL;
+
+    struct FuzzyMemo* m = fuzzy_memo_slot(word);
+    if (!m) return NULL;
+    if (m->match == -2) {
+        // Allow the second edit only on longer words
+        int k = analysis_data.fuzzy_max_distance;
+        if (k > 1 && strlen(word) < 8) k = 1;
+        m->match = bk_tree_search(word, k, &m->distance);
+    }
+    return (m->match >= 0) ? m : NULL;
+}
 
-            // Compute padding before and after the number to centre it (column width 11).
-            int total_spaces = 11 - freq_digits;
-            int spaces_before = total_spaces / 2;
-            int spaces_after = total_spaces - spaces_before;
+// Menu action: switch fuzzy mode on/off and choose the edit-distance bound.
+void toggle_fuzzy_matching(void) {
+    if (analysis_data.fuzzy_matching_enabled) {
+        analysis_data.fuzzy_matching_enabled = false;
+        printf("Fuzzy matching is now DISABLED.\n");
+        return;
+    }
 
-            printf("| %-15s |", sorted_words[i].word);
+    int k;
+    printf("Maximum edit distance (1-2, 2 applies to words of 8+ letters): ");
+    if (scanf("%d", &k) != 1 || k < 1 || k > 2) {
+        printf("Invalid distance. Using 1.\n");
+        k = 1;
+    }
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF);
 
-            for (int s = 0; s < spaces_before; s++) printf(" ");
-            printf("%d", freq);
-            for (int s = 0; s < spaces_after; s++) printf(" ");
+    analysis_data.fuzzy_max_distance = k;
+    analysis_data.fuzzy_matching_enabled = true;
+    g_fuzzy_memo_generation = 0; // Distance changed: drop memoised answers
+    printf("Fuzzy matching is now ENABLED (distance <= %d).\n", k);
+}
 
-            printf("|      %d       |\n", sorted_words[i].severity);
+// Credit the dictionary for all occurrences of one word. Totals and the
+// severity histogram come from score_toxic_tokens().
+void detect_toxic_content(uint32_t id, int occurrences) {
+    const struct TokenToxicity* t = token_toxicity(id);
+    if (t->toxic) {
+        if (t->dict_index != -1) {
+            g_dict->words[t->dict_index].frequency += occurrences;
         }
-        printf("+-----------------+-----------+--------------+\n");
     }
     else {
-        printf("No toxic words found.\n");
+        // Near-miss spelling: counted separately from exact hits
+        struct FuzzyMemo* fm = fuzzy_toxic_lookup(token_text(id));
+        if (fm) {
+            analysis_data.fuzzy_toxic_occurrences += occurrences;
+            g_dict->words[fm->match].fuzzy_frequency += occurrences;
+            fm->hits += occurrences;
+        }
     }
+}
 
-    // Report toxic phrase patterns that were matched in the text.
-    printf("\n--- TOXIC PHRASES (patterns only) ---\n");
-    int phrase_found = 0;
-    int total_phrase_occurrences = 0;
-
-    //  First compute the total number of toxic phrase occurrences (for summary).
-    for (int i = 0; i < analysis_data.toxic_phrases_count; i++) {
-        if (analysis_data.toxic_phrases_list[i].frequency > 0) {
-            total_phrase_occurrences += analysis_data.toxic_phrases_list[i].frequency;
-        }
+// Fill the toxic and severity columns of v from the per-token cache.
+static void vocab_mark_toxicity(struct VocabTable* v) {
+    for (int r = 0; r < v->size; r++) {
+        const struct TokenToxicity* t = token_toxicity(v->ids[r]);
+        v->toxic[r] = t->toxic ? 1 : 0;
+        v->severity[r] = (unsigned char)t->severity;
     }
+}
 
-    if (total_phrase_occurrences > 0) {
-        for (int i = 0; i < analysis_data.toxic_phrases_count; i++) {
-            if (analysis_data.toxic_phrases_list[i].frequency > 0) {
+// ----- Severity histogram over token IDs -----
 
-                const char* phrase = analysis_data.toxic_phrases_list[i].phrase;
-                int freq = analysis_data.toxic_phrases_list[i].frequency;
-                int sev = analysis_data.toxic_phrases_list[i].severity;
+// Scoring class of one verdict (see SEVERITY_CLASSES)
+static unsigned char toxicity_class(int toxic, int severity) {
+    if (!toxic) return 0;
+    return (severity >= 1 && severity <= 5) ? (unsigned char)severity : 6;
+}
 
-                printf("Detected phrase: %s\n", phrase);
-                printf("  Frequency: %d time(s)\n", freq);
+// Scoring class of every word in v, indexed by token ID. IDs outside v keep
+// whatever class they last had; the kernel only reads IDs that are in v.
+static const unsigned char* build_severity_lut(const struct VocabTable* v) {
+    uint32_t need = g_intern_count + SEVERITY_LUT_PAD;
+    if (need > g_severity_lut_cap) {
+        unsigned char* grown = (unsigned char*)stage_realloc(g_severity_lut, need);
+        if (!grown) return NULL;
+        memset(grown + g_severity_lut_cap, 0, need - g_severity_lut_cap);
+        g_severity_lut = grown;
+        g_severity_lut_cap = need;
+    }
 
-                // Use helper to inspect how many toxic words appear inside the phrase.
-                char found_words[10][MAX_WORD_LENGTH];
-                int max_sev_in_phrase = 0;
-                int toxic_word_count = phrase_contains_toxic_words(
-                    phrase,
-                    found_words,
-                    10,
-                    &max_sev_in_phrase
-                );
+    for (int r = 0; r < v->size; r++) {
+        const struct TokenToxicity* t = token_toxicity(v->ids[r]);
+        g_severity_lut[v->ids[r]] = toxicity_class(t->toxic, t->severity);
+    }
+    return g_severity_lut;
+}
 
-                if (toxic_word_count > 0) {
-                    printf("  Contains toxic word(s): ");
-                    for (int k = 0; k < toxic_word_count; k++) {
-                        if (k > 0) printf(", ");
-                        printf("%s", found_words[k]);
-                    }
-                    printf("\n");
+// Count scoring classes of n token IDs in one pass.
+static void severity_histogram(const uint32_t* ids, int n, const unsigned char* lut,
+    int hist[SEVERITY_CLASSES]) {
+    memset(hist, 0, sizeof(int) * SEVERITY_CLASSES);
+    int i = 0;
 
-                    if (toxic_word_count >= 2) {
-                        // Fixed combinations containing multiple toxic words (multi-toxic phrase).
-                        printf("  Note: Multi-toxic phrase (contains %d toxic words, max severity %d)\n",
-                            toxic_word_count,
-                            max_sev_in_phrase > 0 ? max_sev_in_phrase : sev);
-                    }
-                }
-                else {
-                    printf("  Context-based toxicity (combination of non-toxic words)\n");
-                }
+#ifdef __AVX2__
+    // Gather 8 classes at a time; each class keeps per-lane counters
+    // (cmpeq gives -1 on a match, so subtracting it counts up).
+    __m256i acc[SEVERITY_CLASSES];
+    for (int c = 1; c < SEVERITY_CLASSES; c++) acc[c] = _mm256_setzero_si256();
+    const __m256i low_byte = _mm256_set1_epi32(0xff);
+    for (; i + 8 <= n; i += 8) {
+        __m256i idx = _mm256_loadu_si256((const __m256i*)(ids + i));
+        __m256i cls = _mm256_and_si256(_mm256_i32gather_epi32((const int*)lut, idx, 1), low_byte);
+        for (int c = 1; c < SEVERITY_CLASSES; c++) {
+            acc[c] = _mm256_sub_epi32(acc[c], _mm256_cmpeq_epi32(cls, _mm256_set1_epi32(c)));
+        }
+    }
+    int vector_hits = 0;
+    for (int c = 1; c < SEVERITY_CLASSES; c++) {
+        int lanes[8];
+        _mm256_storeu_si256((__m256i*)lanes, acc[c]);
+        for (int l = 0; l < 8; l++) hist[c] += lanes[l];
+        vector_hits += hist[c];
+    }
+    hist[0] = i - vector_hits;
+#endif
 
-                printf("  Overall severity: Level %d\n\n", sev);
-                phrase_found = 1;
-            }
-        }
+    // Four interleaved sub-histograms so back-to-back hits on the same
+    // class don't wait on each other
+    int sub[4][SEVERITY_CLASSES] = { { 0 } };
+    for (; i + 4 <= n; i += 4) {
+        sub[0][lut[ids[i]]]++;
+        sub[1][lut[ids[i + 1]]]++;
+        sub[2][lut[ids[i + 2]]]++;
+        sub[3][lut[ids[i + 3]]]++;
     }
-    else {
-        printf("No toxic phrases detected.\n");
+    for (; i < n; i++) sub[0][lut[ids[i]]]++;
+    for (int c = 0; c < SEVERITY_CLASSES; c++) {
+        hist[c] += sub[0][c] + sub[1][c] + sub[2][c] + sub[3][c];
     }
 }
 
-// Display all toxic words and phrases currently stored in the dictionary.
-void view_all_toxic_words() {
-    printf("\n=== TOXIC DICTIONARY OVERVIEW ===\n");
-    printf("Total words: %d, Total phrases: %d\n\n",
-        analysis_data.toxic_words_count, analysis_data.toxic_phrases_count);
+// ----- Most toxic sentences (bounded min-heap) -----
+// The heap root is the least toxic sentence kept, so memory stays at
+// TOXIC_SENTENCES_TOP entries however many sentences the file has.
 
-    // Show words grouped by severity level.
-    printf("TOXIC WORDS BY SEVERITY LEVEL:\n");
-    printf("-------------------------------\n");
+// More toxic words first, then higher severity, then the earlier sentence.
+static int toxic_sentence_before(const struct ToxicSentence* a, const struct ToxicSentence* b) {
+    if (a->toxic != b->toxic) return a->toxic > b->toxic;
+    if (a->max_severity != b->max_severity) return a->max_severity > b->max_severity;
+    return a->sentence < b->sentence;
+}
 
-    for (int severity = 1; severity <= 5; severity++) {
-        printf("\nLevel %d:\n", severity);
-        int count = 0;
-        for (int i = 0; i < analysis_data.toxic_words_count; i++) {
-            if (analysis_data.toxic_words_list[i].severity == severity) {
-                printf("%-15s", analysis_data.toxic_words_list[i].word);
-                count++;
-                if (count % 5 == 0) printf("\n"); // Print 5 words per line.
-            }
-        }
-        if (count % 5 != 0) printf("\n"); // Ensure ending newline for partial lines.
-        printf("Total: %d words\n", count);
+static void toxic_sentence_offer(const struct ToxicSentence* s) {
+    struct ToxicSentence* heap = analysis_data.top_sentences;
+    int n = analysis_data.top_sentence_count;
+    int i;
+    if (n < TOXIC_SENTENCES_TOP) {
+        // Sift up from the new leaf
+        i = analysis_data.top_sentence_count++;
+        while (i > 0 && toxic_sentence_before(&heap[(i - 1) / 2], s)) {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i] = *s;
+        return;
     }
+    if (!toxic_sentence_before(s, &heap[0])) return;
 
-    // Show all toxic phrases and their related toxic words.
-    printf("\nTOXIC PHRASES:\n");
-    printf("--------------\n");
-    int phrases_displayed = 0;
-    for (int i = 0; i < analysis_data.toxic_phrases_count; i++) {
-        // Check if the phrase contains any known toxic words.
-        char found_toxic_words[10][MAX_WORD_LENGTH];
-        int toxic_word_count = phrase_contains_toxic_words(
-            analysis_data.toxic_phrases_list[i].phrase,
-            found_toxic_words,
-            10,
-            NULL   // No need to track max severity here.
-        );
+    // Replace the root and sift down
+    i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && toxic_sentence_before(&heap[c], &heap[c + 1])) c++;
+        if (!toxic_sentence_before(s, &heap[c])) break;
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = *s;
+}
 
-        printf("%2d. %s (Level %d)",
-            i + 1,
-            analysis_data.toxic_phrases_list[i].phrase,
-            analysis_data.toxic_phrases_list[i].severity);
+static int cmp_toxic_sentence(const void* a, const void* b) {
+    const struct ToxicSentence* x = (const struct ToxicSentence*)a;
+    const struct ToxicSentence* y = (const struct ToxicSentence*)b;
+    return toxic_sentence_before(y, x) - toxic_sentence_before(x, y);
+}
 
-        if (toxic_word_count > 0) {
-            printf(" - Contains: ");
-            for (int j = 0; j < toxic_word_count; j++) {
-                if (j > 0) printf(", ");
-                printf("%s", found_toxic_words[j]);
+// Fill the toxic total and severity counts for a word list whose distinct
+// words are in v. With sentence_starts (first position of each of the
+// sentences), the histogram is taken sentence by sentence in the same pass
+// and the most toxic ones are ranked.
+static void score_toxic_tokens(const uint32_t* ids, int n, const struct VocabTable* v,
+    const int* sentence_starts, int sentences) {
+    const unsigned char* lut = build_severity_lut(v);
+    analysis_data.top_sentence_count = 0;
+    if (!lut) {
+        printf("Error: Memory allocation failed (severity table)\n");
+        return;
+    }
+
+    int hist[SEVERITY_CLASSES];
+    if (!sentence_starts) {
+        severity_histogram(ids, n, lut, hist);
+    }
+    else {
+        memset(hist, 0, sizeof(hist));
+        for (int k = 0; k < sentences; k++) {
+            int from = sentence_starts[k];
+            int to = (k + 1 < sentences) ? sentence_starts[k + 1] : n;
+            if (to > n) to = n;
+            if (to <= from) continue;
+
+            int part[SEVERITY_CLASSES];
+            severity_histogram(ids + from, to - from, lut, part);
+            struct ToxicSentence ts = { k, 0, 0, to - from };
+            for (int c = 1; c < SEVERITY_CLASSES; c++) {
+                hist[c] += part[c];
+                ts.toxic += part[c];
+                if (c <= 5 && part[c] > 0) ts.max_severity = c;
             }
+            if (ts.toxic > 0) toxic_sentence_offer(&ts);
         }
-        else {
-            printf(" - Combination toxicity");
-        }
-        printf("\n");
-        phrases_displayed++;
+        qsort(analysis_data.top_sentences, analysis_data.top_sentence_count,
+            sizeof(struct ToxicSentence), cmp_toxic_sentence);
     }
-    if (phrases_displayed == 0) {
-        printf("No toxic phrases in dictionary.\n");
+    analysis_data.total_toxic_occurrences = 0;
+    for (int c = 1; c < SEVERITY_CLASSES; c++) {
+        analysis_data.total_toxic_occurrences += hist[c];
+        if (c <= 5) analysis_data.severity_count[c] = hist[c];
     }
 }
 
-// Menu handler for dictionary operations (add/remove/view toxic entries).
-void dictionary_management() {
-    char option;
-    do {
-        printf("\n=== TOXIC DICTIONARY MANAGEMENT ===\n");
-        printf("Current dictionary: %d words and %d phrases\n",
-            analysis_data.toxic_words_count, analysis_data.toxic_phrases_count);
-        printf("File: toxicwords.txt\n");
-
-        printf("\n1. Add new toxic word or phrase\n");
-        printf("2. Remove toxic word or phrase\n");
-        printf("3. View dictionary\n");
-        printf("0. Back to menu\n");
-        option = get_menu_option("1230", "Enter your option (0-3): ");
-
-        switch (option) {
-        case '1':
-            add_custom_toxic_word();
-            break;
-        case '2':
-            remove_toxic_word();
-            break;
-        case '3':
-            view_all_toxic_words();
-            break;
-        case '0':
-            printf("Returning to menu...\n");
-            break;
-        default:
-            printf("Invalid option. Please enter 0-3.\n");
+// Sentence k of the loaded text on one line: whitespace runs collapsed,
+// cut at TOXIC_SENTENCE_PREVIEW characters.
+static void sentence_preview(int k, char* out, size_t cap) {
+    const struct PositionIndex* pi = &analysis_data.positions;
+    size_t n = 0;
+    out[0] = '\0';
+    if (!analysis_data.text || k < 0 || k >= pi->sentences) return;
+
+    const char* p = analysis_data.text + pi->sentence_offset[k];
+    const char* end = (k + 1 < pi->sentences)
+        ? analysis_data.text + pi->sentence_offset[k + 1]
+        : p + strlen(p);
+    while (p < end && (*p == '.' || *p == '!' || *p == '?')) p++;  // Rest of "?!" / "..."
+    size_t limit = cap - 4 < TOXIC_SENTENCE_PREVIEW ? cap - 4 : TOXIC_SENTENCE_PREVIEW;
+    int space = 0;
+    for (; p < end && *p; p++) {
+        if (isspace((unsigned char)*p)) {
+            space = (n > 0);
+            continue;
         }
-    } while (option != '0');
+        if (n + space >= limit) {
+            strcpy(out + n, "...");
+            return;
+        }
+        if (space) out[n++] = ' ';
+        out[n++] = *p;
+        space = 0;
+    }
+    out[n] = '\0';
 }
 
-// Add a custom toxic word or phrase to the in-memory dictionary and save to file.
-void add_custom_toxic_word() {
-    if (analysis_data.toxic_words_count >= MAX_TOXIC_WORDS - 1) {
-        printf("Toxic words list is full!\n");
-        return;
+// Sentence starts for a scored word list: only when it is the filtered list
+// the position index was built with, otherwise NULL.
+static const int* scored_list_sentences(const uint32_t* ids, int n) {
+    const struct PositionIndex* pi = &analysis_data.positions;
+    if (pi->sentence_filtered && analysis_data.filtered_word_ids &&
+        n == analysis_data.filtered_word_count &&
+        memcmp(ids, analysis_data.filtered_word_ids, sizeof(uint32_t) * n) == 0) {
+        return pi->sentence_filtered;
     }
+    return NULL;
+}
 
-    char new_input[MAX_WORD_LENGTH * 3];
-    printf("Enter new toxic word or phrase: ");
-    if (!read_line(new_input, sizeof(new_input))) {
-        printf("Failed to read input.\n");
-        return;
-    }
+// ----- Toxicity hotspots (sliding window over the scored list) -----
 
-    // Normalise input to lowercase for matching and storage.
-    char lower_input[MAX_WORD_LENGTH * 3];
-    strcpy(lower_input, new_input);
-    for (int i = 0; lower_input[i]; i++) {
-        lower_input[i] = (char)tolower((unsigned char)lower_input[i]);
-    }
+// Score of one token per scoring class: its level, 1 when it has none
+static const int g_class_weight[SEVERITY_CLASSES] = { 0, 1, 2, 3, 4, 5, 1 };
 
-    int i = 0;
-    while (lower_input[i] && isspace((unsigned char)lower_input[i])) i++;
-    if (lower_input[i] == '\0') return;
+// Higher score first, then more toxic words, then the earlier window
+static int hotspot_before(const struct ToxicHotspot* a, const struct ToxicHotspot* b) {
+    if (a->score != b->score) return a->score > b->score;
+    if (a->toxic != b->toxic) return a->toxic > b->toxic;
+    return a->start < b->start;
+}
 
-    // Decide whether this is a single word or a phrase (contains spaces).
-    if (strchr(lower_input, ' ') == NULL) {
-        // ===== Single-word branch =====
-        // Check if word already exists in the dictionary.
-        for (int i = 0; i < analysis_data.toxic_words_count; i++) {
-            if (string_case_insensitive_compare(lower_input,
-                analysis_data.toxic_words_list[i].word) == 0) {
-                printf("Word '%s' already exists in the dictionary.\n", new_input);
-                return;
+// Best k non-overlapping windows of `window` tokens, in rank order; returns
+// how many were found (windows without a toxic word are not reported).
+// Prefix sums of the toxic flag and the weight make every window O(1), so
+// each selection pass over all n - window + 1 windows is O(n).
+static int toxic_hotspots(const uint32_t* ids, int n, const unsigned char* lut,
+    int window, int k, struct ToxicHotspot out[]) {
+    if (n <= 0 || k <= 0) return 0;
+    if (window > n) window = n;
+    if (window < 1) window = 1;
+
+    int* toxic_sum = (int*)stage_malloc(sizeof(int) * (n + 1));
+    int* score_sum = (int*)stage_malloc(sizeof(int) * (n + 1));
+    if (!toxic_sum || !score_sum) {
+        printf("Error: Memory allocation failed (hotspot prefix sums)\n");
+        free(toxic_sum);
+        free(score_sum);
+        return 0;
+    }
+    toxic_sum[0] = score_sum[0] = 0;
+    for (int i = 0; i < n; i++) {
+        unsigned char c = lut[ids[i]];
+        toxic_sum[i + 1] = toxic_sum[i] + (c != 0);
+        score_sum[i + 1] = score_sum[i] + g_class_weight[c];
+    }
+
+    // Greedy: the best window not overlapping one already taken, k times
+    int found = 0;
+    while (found < k) {
+        struct ToxicHotspot best = { -1, 0, 0 };
+        for (int s = 0; s + window <= n; s++) {
+            int overlaps = 0;
+            for (int j = 0; j < found && !overlaps; j++) {
+                overlaps = (s < out[j].start + window && out[j].start < s + window);
             }
+            if (overlaps) continue;
+            struct ToxicHotspot h = { s, toxic_sum[s + window] - toxic_sum[s],
+                score_sum[s + window] - score_sum[s] };
+            if (h.toxic > 0 && (best.start < 0 || hotspot_before(&h, &best))) best = h;
         }
+        if (best.start < 0) break;
+        out[found++] = best;
+    }
+    free(toxic_sum);
+    free(score_sum);
+    return found;
+}
 
-        int severity;
-        printf("Enter severity (Level 1-5): ");
-        scanf("%d", &severity);
-        getchar();
-        if (severity < 1 || severity > 5) {
-            printf("Invalid severity. Using Level 3 as default.\n");
-            severity = 3;
-        }
-
-        // Insert the new word into the list, keeping alphabetical order.
-        int insert_pos = analysis_data.toxic_words_count;
-        for (int i = 0; i < analysis_data.toxic_words_count; i++) {
-            if (string_case_insensitive_compare(lower_input,
-                analysis_data.toxic_words_list[i].word) < 0) {
-                insert_pos = i;
-                break;
-            }
-        }
-        for (int i = analysis_data.toxic_words_count; i > insert_pos; i--) {
-            analysis_data.toxic_words_list[i] = analysis_data.toxic_words_list[i - 1];
+// The words of one window on a line, toxic ones in brackets, cut at
+// TOXIC_SENTENCE_PREVIEW characters.
+static void hotspot_preview(const uint32_t* ids, int from, int to, const unsigned char* lut,
+    char* out, size_t cap) {
+    size_t n = 0;
+    size_t limit = cap - 4 < TOXIC_SENTENCE_PREVIEW ? cap - 4 : TOXIC_SENTENCE_PREVIEW;
+    out[0] = '\0';
+    for (int i = from; i < to; i++) {
+        const char* w = token_text(ids[i]);
+        int mark = lut[ids[i]] != 0;
+        size_t need = strlen(w) + (n > 0) + (mark ? 2 : 0);
+        if (n + need > limit) {
+            strcpy(out + n, "...");
+            return;
         }
+        n += snprintf(out + n, cap - n, "%s%s%s%s", n > 0 ? " " : "", mark ? "[" : "", w, mark ? "]" : "");
+    }
+}
 
-        strcpy(analysis_data.toxic_words_list[insert_pos].word, lower_input);
-        analysis_data.toxic_words_list[insert_pos].severity = severity;
-        analysis_data.toxic_words_list[insert_pos].frequency = 0;
-        analysis_data.toxic_words_count++;
+// Menu: densest stretches of the last toxic analysis, window size from the user
+void toxicity_hotspots() {
+    if (g_toxic_id_count == 0) {
+        printf("No scored word list. Please run Toxic Analysis first.\n");
+        return;
+    }
 
-        save_toxic_dictionary("toxicwords.txt");
-        printf("Added word '%s' with Level %d and saved to dictionary\n",
-            new_input, severity);
+    char buf[16];
+    int window = HOTSPOT_WINDOW_DEFAULT, k = HOTSPOT_TOP_DEFAULT;
+    printf("Window size in words (Enter for %d): ", HOTSPOT_WINDOW_DEFAULT);
+    if (read_line(buf, sizeof(buf)) && buf[0] != '\0') {
+        window = atoi(buf);
+        if (window < 1) window = 1;
     }
-    else {
-        // ===== phrase branch =====
-        add_custom_toxic_phrase(lower_input);
+    printf("Windows to show (Enter for %d, max %d): ", HOTSPOT_TOP_DEFAULT, HOTSPOT_TOP_MAX);
+    if (read_line(buf, sizeof(buf)) && buf[0] != '\0') {
+        k = atoi(buf);
+        if (k < 1) k = 1;
+        if (k > HOTSPOT_TOP_MAX) k = HOTSPOT_TOP_MAX;
     }
-}
 
-// Add a new toxic phrase and optionally mark words inside it as toxic words.
-void add_custom_toxic_phrase(const char* phrase) {
-    if (analysis_data.toxic_phrases_count >= MAX_PHRASES) {
-        printf("Toxic phrase list is full!\n");
+    const uint32_t* ids = g_toxic_ids;
+    int n = g_toxic_id_count;
+    if (window > n) window = n;
+    const unsigned char* lut = build_severity_lut(&g_toxic_vocab);
+    if (!lut) {
+        printf("Error: Memory allocation failed (severity table)\n");
         return;
     }
 
-    // Split the phrase into individual words (up to 10).
-    char phrase_copy[MAX_WORD_LENGTH * 3];
-    strncpy(phrase_copy, phrase, sizeof(phrase_copy) - 1);
-    phrase_copy[sizeof(phrase_copy) - 1] = '\0';
-
-    char words[10][MAX_WORD_LENGTH];
-    int  word_count = 0;
-
-    char* tok = strtok(phrase_copy, " ");
-    while (tok && word_count < 10) {
-        strncpy(words[word_count], tok, MAX_WORD_LENGTH - 1);
-        words[word_count][MAX_WORD_LENGTH - 1] = '\0';
-        word_count++;
-        tok = strtok(NULL, " ");
-    }
+    struct ToxicHotspot top[HOTSPOT_TOP_MAX];
+    double t0 = wall_ms();
+    int found = toxic_hotspots(ids, n, lut, window, k, top);
+    double took = wall_ms() - t0;
 
-    if (word_count < 2) {
-        printf("Phrase should contain at least two words.\n");
+    int total = 0;
+    for (int i = 0; i < n; i++) total += (lut[ids[i]] != 0);
+    printf("\n--- TOXICITY HOTSPOTS (%d-word windows) ---\n", window);
+    printf("Whole list: %d toxic of %d words (%.2f%%)\n", total, n, 100.0 * total / n);
+    if (found == 0) {
+        printf("No window contains a toxic word.\n");
         return;
     }
 
-    // Check which words are already in the toxic word dictionary.
-    int is_toxic[10] = { 0 };
-    int word_sev[10] = { 0 };
-    for (int i = 0; i < word_count; i++) {
-        int sev = get_toxic_severity(words[i]);
-        if (sev > 0) {
-            is_toxic[i] = 1;
-            word_sev[i] = sev;
+    const int* sentence_starts = scored_list_sentences(ids, n);
+    const struct PositionIndex* pi = &analysis_data.positions;
+    char preview[TOXIC_SENTENCE_PREVIEW + 4];
+    for (int i = 0; i < found; i++) {
+        const struct ToxicHotspot* h = &top[i];
+        printf("%2d. Words %d-%d", i + 1, h->start + 1, h->start + window);
+        if (sentence_starts) {
+            // Sentence holding the first word, and the line that sentence starts on
+            int sentence = position_mark_number(sentence_starts, pi->sentences, h->start);
+            printf(" (sentence %d, line %d)", sentence,
+                position_mark_number(pi->line_start, pi->lines, pi->sentence_start[sentence - 1]));
         }
+        printf(": %d toxic (%.1f%%), score %d\n", h->toxic, 100.0 * h->toxic / window, h->score);
+        hotspot_preview(ids, h->start, h->start + window, lut, preview, sizeof(preview));
+        printf("    %s\n", preview);
     }
+    printf("(%.3f ms)\n", took);
+}
 
-    // Show each word in the phrase and current toxicity information (if any).
-    printf("\nWords in phrase:\n");
-    for (int i = 0; i < word_count; i++) {
-        if (is_toxic[i]) {
-            printf("  %d) %s  (already toxic, Level %d)\n",
-                i + 1, words[i], word_sev[i]);
-        }
-        else {
-            printf("  %d) %s\n", i + 1, words[i]);
-        }
-    }
+// Detect toxic phrases (2-gram or 3-gram) formed by consecutive words.
+// Matches phrases defined in the dictionary and updates frequency counts.
+void detect_toxic_phrases() {
+    if (analysis_data.original_word_count < 2) return;
+    if (!build_ngram_table()) return;
 
-    // Ask once which positions should be marked as toxic words (avoid many y/n prompts).
-    int selected[10] = { 0 };
-    char line[128];
+    const uint32_t* ids = analysis_data.original_word_ids;
+    for (int i = 0; i <= analysis_data.original_word_count - 2; i++) {
 
-    printf("\nWhich positions are TOXIC words? \n");
-    printf("Enter numbers separated by space (e.g. 2 3), or 0 if you don't want to add new toxic words:\n> ");
+        // ==== 2-gram ====
+        int j = ngram_lookup(ids[i], ids[i + 1], TOKEN_NONE);
+        if (j != -1) {
+            g_dict->phrases[j].frequency++;
+            analysis_data.bigram_toxic_occurrences++;
+        }
 
-    if (read_line(line, sizeof(line))) {
-        char* p = strtok(line, " ");
-        while (p) {
-            int idx = atoi(p);
-            if (idx == 0) {
-                // 0 means "no new toxic words to add"
-                break;
-            }
-            if (idx >= 1 && idx <= word_count) {
-                selected[idx - 1] = 1;
+        // ==== 3-gram ====
+        if (i <= analysis_data.original_word_count - 3) {
+            j = ngram_lookup(ids[i], ids[i + 1], ids[i + 2]);
+            if (j != -1) {
+                g_dict->phrases[j].frequency++;
+                analysis_data.trigram_toxic_occurrences++;
             }
-            p = strtok(NULL, " ");
         }
     }
+}
 
-    // For each selected word that is not yet toxic, ask for its severity and add it.
-    for (int i = 0; i < word_count; i++) {
-        if (selected[i] && !is_toxic[i]) {
-            int sev;
-            printf("Set severity for new toxic word '%s' (1-5): ", words[i]);
-            scanf("%d", &sev);
-            getchar();
-            if (sev < 1 || sev > 5) {
-                printf("  Invalid severity. Using Level 3.\n");
-                sev = 3;
-            }
+// Analyse a phrase to determine how many toxic words it contains,
+// store them in the provided buffer, and return the maximum severity.
+int phrase_contains_toxic_words(const char* phrase, char found_words[][MAX_WORD_LENGTH], int max_found, int* max_severity) {
+    if (!phrase || !*phrase) return 0;
 
-            // Insert into toxic word dictionary if there is space.
-            if (analysis_data.toxic_words_count < MAX_TOXIC_WORDS) {
-                int idx = analysis_data.toxic_words_count;
-                strcpy(analysis_data.toxic_words_list[idx].word, words[i]);
-                analysis_data.toxic_words_list[idx].severity = sev;
-                analysis_data.toxic_words_list[idx].frequency = 0;
-                analysis_data.toxic_words_count++;
-            }
+    char phrase_copy[MAX_WORD_LENGTH * 3];
+    strcpy(phrase_copy, phrase);
 
-            is_toxic[i] = 1;
-            word_sev[i] = sev;
+    int found_count = 0;
+    int local_max_sev = 0;
+
+    char* word = strtok(phrase_copy, " ");
+    while (word != NULL && found_count < max_found) {
+        if (is_toxic_word(word)) {
+            strcpy(found_words[found_count], word);
+            int sev = get_toxic_severity(word);
+            if (sev > local_max_sev) local_max_sev = sev;
+            found_count++;
         }
+        word = strtok(NULL, " ");
     }
 
-    // Finally, compute how many toxic words are in the phrase and their maximum severity.
-    int final_toxic_count = 0;
-    int final_max_sev = 0;
-    for (int i = 0; i < word_count; i++) {
-        int sev = get_toxic_severity(words[i]);
-        if (sev > 0) {
-            final_toxic_count++;
-            if (sev > final_max_sev) final_max_sev = sev;
-        }
+    if (max_severity) {
+        *max_severity = local_max_sev;
     }
+    return found_count;
+}
 
-    int phrase_severity = 0;
+// Reset all toxicity-related counters before performing a new analysis run.
+void reset_toxic_counts() {
+    analysis_data.total_toxic_occurrences = 0;
+    analysis_data.toxicity_density = 0.0;
+    memset(analysis_data.severity_count, 0, sizeof(analysis_data.severity_count));
+    analysis_data.bigram_toxic_occurrences = 0;
+    analysis_data.trigram_toxic_occurrences = 0;
 
-    if (final_toxic_count == 0) {
-        // Case A: purely context-based phrase (no toxic words inside).
-        // Ask user for a severity for the whole phrase and store it.
-        printf("\nNo toxic words inside this phrase so far.\n");
-        printf("Set severity for the phrase '%s' (1-5): ", phrase);
-        scanf("%d", &phrase_severity);
-        getchar();
-        if (phrase_severity < 1 || phrase_severity > 5) {
-            printf("Invalid severity. Using Level 3.\n");
-            phrase_severity = 3;
-        }
+    analysis_data.fuzzy_toxic_occurrences = 0;
+    analysis_data.top_sentence_count = 0;
+
+    for (int i = 0; i < g_dict->word_count; i++) {
+        g_dict->words[i].frequency = 0;
+        g_dict->words[i].fuzzy_frequency = 0;
     }
-    else if (final_toxic_count == 1) {
-        // Case B: exactly one toxic word in the phrase.
-        // By design this is NOT stored as a separate toxic phrase,
-        // detection will rely on that single toxic word.
-        printf("\nThis phrase contains exactly ONE toxic word.\n");
-        printf("It will not be stored as a toxic phrase.\n");
-        printf("Toxic detection will rely on the toxic word itself only.\n");
-        save_toxic_dictionary("toxicwords.txt");
-        return;  // Do not add to phrase list.
+    for (int i = 0; i < g_dict->phrase_count; i++) {
+        g_dict->phrases[i].frequency = 0;
     }
-
-    else {
-        // Case C: phrase contains two or more toxic words → treat as a multi-toxic phrase.
-        phrase_severity = (final_max_sev > 0) ? final_max_sev : 3;
-        printf("\nPhrase contains %d toxic word(s). Phrase severity set to Level %d (max of words).\n",
-            final_toxic_count, phrase_severity);
+    for (int i = 0; i < g_fuzzy_memo_size; i++) {
+        g_fuzzy_memo[i].hits = 0;
     }
+}
 
-    // Only Case A and Case C reach this point: store phrase in dictionary.
-    if (analysis_data.toxic_phrases_count < MAX_PHRASES) {
-        int idx = analysis_data.toxic_phrases_count;
-
-        strncpy(analysis_data.toxic_phrases_list[idx].phrase,
-            phrase, MAX_WORD_LENGTH * 3 - 1);
-        analysis_data.toxic_phrases_list[idx].phrase[MAX_WORD_LENGTH * 3 - 1] = '\0';
-
-        analysis_data.toxic_phrases_list[idx].severity = phrase_severity;
-        analysis_data.toxic_phrases_list[idx].frequency = 0;
-
-        if (word_count == 2 || word_count == 3) {
-            analysis_data.toxic_phrases_list[idx].ngram_len = word_count;
-        }
-        else {
-            analysis_data.toxic_phrases_list[idx].ngram_len = 0;
-        }
-
-        analysis_data.toxic_phrases_count++;
-
-        save_toxic_dictionary("toxicwords.txt");
-        printf("Added phrase '%s' (severity: %d, words: %d, toxic_words: %d)\n",
-            phrase, phrase_severity, word_count, final_toxic_count);
+// Compute toxicity density as a percentage of toxic words among all filtered words.
+void calculate_toxicity_density() {
+    if (analysis_data.total_words_filtered > 0) {
+        analysis_data.toxicity_density = (float)analysis_data.total_toxic_occurrences /
+            analysis_data.total_words_filtered * 100;
+    }
+    else {
+        analysis_data.toxicity_density = 0.0;
     }
 }
 
-// Remove a toxic word or phrase from the dictionary by text match.
-void remove_toxic_word() {
-    // Use a larger buffer so both words and phrases can be entered.
-    char word_to_remove[MAX_WORD_LENGTH * 3];
-    printf("Enter toxic word or phrase to remove: ");
-    if (!read_line(word_to_remove, sizeof(word_to_remove))) {
-        printf("Failed to read input.\n");
+// Execute the full toxic detection pipeline.
+// Handles normalisation, word-list selection, toxicity scanning,
+// phrase detection, and final density computation.
+void run_toxic_analysis(void) {
+    if (!analysis_data.text_filtered) {
+        printf("No text filtered. Please load and process a file first.\n");
         return;
     }
 
-    if (strlen(word_to_remove) == 0) {
-        printf("No input provided.\n");
-        return;
-    }
+    char filename_to_use[256] = "";
+    bool need_reprocess = false;
+    bool manual_source_match = false;
+    bool saved_without_normalisation = false;
 
-    // Normalise to lowercase so we can do case-insensitive comparison.
-    for (int i = 0; word_to_remove[i]; i++) {
-        word_to_remove[i] = (char)tolower((unsigned char)word_to_remove[i]);
-    }
+    const char* manual_name =
+        (strlen(current_manual_filtered_filename) > 0)
+        ? current_manual_filtered_filename
+        : "filtered_words.txt";
 
-    bool removed = false;
+    if (user_manually_saved_current_session) {
+        FILE* f = fopen(manual_name, "r");
+        if (f) {
+            char line[512];
+            char source_path[256] = "";
 
-    // 1. Try to remove from the toxic word list first.
-    for (int i = 0; i < analysis_data.toxic_words_count; i++) {
-        if (string_case_insensitive_compare(word_to_remove,
-            analysis_data.toxic_words_list[i].word) == 0) {
+            while (fgets(line, sizeof(line), f)) {
+                line[strcspn(line, "\r\n")] = 0;
+                if (line[0] != '#') break;
 
-            // Shift remaining entries left to fill the gap.
-            for (int j = i; j < analysis_data.toxic_words_count - 1; j++) {
-                analysis_data.toxic_words_list[j] = analysis_data.toxic_words_list[j + 1];
+                if (strstr(line, "TextNormalisation: disabled"))
+                    saved_without_normalisation = true;
+                else if (strstr(line, "TextNormalisation: enabled"))
+                    saved_without_normalisation = false;
+                else if (!strncmp(line, "# SourceFile:", 13)) {
+                    const char* p = line + 13;
+                    while (*p == ' ' || *p == '\t') p++;
+                    strncpy(source_path, p, sizeof(source_path) - 1);
+                    source_path[sizeof(source_path) - 1] = '\0';
+                }
             }
-            analysis_data.toxic_words_count--;
-            removed = true;
 
-            printf("Removed '%s' from toxic word list.\n", word_to_remove);
-            break;
+            if (source_path[0] && current_filename[0] &&
+                strcmp(source_path, current_filename) == 0) {
+                manual_source_match = true;
+            }
+            fclose(f);
         }
     }
 
-    // 2. If not found in words, try to remove from the phrase list.
-    if (!removed) {
-        for (int i = 0; i < analysis_data.toxic_phrases_count; i++) {
-            if (string_case_insensitive_compare(word_to_remove,
-                analysis_data.toxic_phrases_list[i].phrase) == 0) {
+    bool using_manual_file = user_manually_saved_current_session && manual_source_match;
 
-                // Shift remaining entries left to fill the gap.
-                for (int j = i; j < analysis_data.toxic_phrases_count - 1; j++) {
-                    analysis_data.toxic_phrases_list[j] = analysis_data.toxic_phrases_list[j + 1];
-                }
-                analysis_data.toxic_phrases_count--;
-                removed = true;
+    if (using_manual_file) {
+        if (saved_without_normalisation) {
+            printf("\nWARNING: Your filtered word list was saved WITHOUT Text Normalisation.\n");
+            printf("This means abbreviations and Leet Speak won't be expanded.\n");
+            printf("Do you want to:\n");
+            printf("1. Use the non-normalised file (faster, less accurate)\n");
+            printf("2. Re-process with Text Normalisation (recommended)\n");
+            printf("Enter your option (1-2): ");
 
-                printf("Removed '%s' from toxic phrase list.\n", word_to_remove);
-                break;
+            char option;
+            scanf(" %c", &option);
+
+            if (option == '1') {
+                printf("\nUsing non-normalised file for analysis: %s\n", manual_name);
+                strcpy(filename_to_use, manual_name);
+            }
+            else {
+                printf("\nRe-processing with Text Normalisation...\n");
+                if (!analysis_data.variant_processing_enabled) {
+                    analysis_data.variant_processing_enabled = true;
+                    need_reprocess = true;
+                }
+                strcpy(filename_to_use, "filtered_words_normalised.txt");
             }
         }
+        else {
+            printf("Using your manually saved file: %s\n", manual_name);
+            strcpy(filename_to_use, manual_name);
+        }
     }
+    else {
+        printf("No matching manually saved filtered word list for this file.\n");
+        printf("Auto-saving normalised word list for toxic analysis...\n");
 
-    // 3. If not found in either list, report to the user.
-    if (!removed) {
-        printf("'%s' not found in toxic word or phrase dictionary.\n", word_to_remove);
-        return;
-    }
-
-    // If something was removed, persist changes to the backing file.
-    save_toxic_dictionary("toxicwords.txt");
-    printf("Dictionary file updated.\n");
-}
+        if (!analysis_data.variant_processing_enabled) {
+            printf("Enabling Text Normalisation for better accuracy...\n");
+            analysis_data.variant_processing_enabled = true;
+            need_reprocess = true;
+        }
+        strcpy(filename_to_use, "filtered_words_auto_saved.txt");
+    }
 
-// Save the current toxic word and phrase dictionary to a file.
-void save_toxic_dictionary(const char* filename) {
-    FILE* file = fopen(filename, "w");
+    if (need_reprocess) {
+        reprocess_with_variants();
+    }
+
+    if (!using_manual_file ||
+        strcmp(filename_to_use, "filtered_words_normalised.txt") == 0) {
+        save_filtered_word_list_auto(filename_to_use);
+        printf("Auto-saved word list: %s\n", filename_to_use);
+    }
+
+    reset_toxic_counts();
+    printf("Starting toxic analysis using: %s\n", filename_to_use);
+
+    FILE* file = fopen(filename_to_use, "r");
     if (!file) {
-        printf("Error: Cannot save toxic dictionary to %s\n", filename);
+        printf("Error: Cannot open filtered word list file: %s\n", filename_to_use);
         return;
     }
 
-    // Write file header.
-    fprintf(file, "# Toxic Words Dictionary\n");
-    fprintf(file, "# Format: word,severity\n");
-    fprintf(file, "# Severity: 1-5 (1=mild, 5=severe)\n\n");
+    double scan_t0 = stage_begin(STAGE_TOXIC_SCAN);
+    if (!alloc_id_table(&g_toxic_ids)) {
+        stage_end(STAGE_TOXIC_SCAN, scan_t0, 0, 0);
+        fclose(file);
+        return;
+    }
 
-    // Write all toxic words (including custom user-added entries).
-    for (int i = 0; i < analysis_data.toxic_words_count; i++) {
-        fprintf(file, "%s,%d\n",
-            analysis_data.toxic_words_list[i].word,
-            analysis_data.toxic_words_list[i].severity);
+    char word[MAX_WORD_LENGTH];
+    int word_count = 0;
+
+    // Read the list as token IDs, then score it in one pass and credit the
+    // dictionary once per distinct word
+    g_toxic_vocab.size = 0;
+    while (fgets(word, sizeof(word), file) && word_count < MAX_WORDS) {
+        word[strcspn(word, "\r\n")] = 0;
+        uint32_t id = (strlen(word) > 0) ? intern_word(word) : TOKEN_NONE;
+        if (id != TOKEN_NONE && vocab_add(&g_toxic_vocab, id, 1, MAX_WORDS) >= 0) {
+            g_toxic_ids[word_count++] = id;
+        }
     }
+    long scanned_bytes = ftell(file);
+    fclose(file);
+    g_toxic_id_count = word_count;
 
-    // Write all toxic phrases.
-    for (int i = 0; i < analysis_data.toxic_phrases_count; i++) {
-        fprintf(file, "%s,%d\n",
-            analysis_data.toxic_phrases_list[i].phrase,
-            analysis_data.toxic_phrases_list[i].severity);
+    score_toxic_tokens(g_toxic_ids, word_count, &g_toxic_vocab,
+        scored_list_sentences(g_toxic_ids, word_count), analysis_data.positions.sentences);
+    for (int r = 0; r < g_toxic_vocab.size; r++) {
+        detect_toxic_content(g_toxic_vocab.ids[r], g_toxic_vocab.counts[r]);
     }
+    stage_end(STAGE_TOXIC_SCAN, scan_t0, scanned_bytes, word_count);
 
-    fclose(file);
-    printf("Toxic dictionary saved to: %s (%d words, %d phrases)\n",
-        filename, analysis_data.toxic_words_count, analysis_data.toxic_phrases_count);
-    sync_toxic_systems();
+    printf("Analysed %d words from file\n", word_count);
+
+    double phrase_t0 = stage_begin(STAGE_PHRASES);
+    detect_toxic_phrases();
+    stage_end(STAGE_PHRASES, phrase_t0, 0, analysis_data.original_word_count);
+    calculate_toxicity_density();
+    printf("Toxic analysis completed.\n");
 }
 
-// ========== STAGE 3 MENU DISPLAY FUNCTION ==========
-void display_toxic_menu() {
-    int sub = -1;
-    do {
-        if (!auto_select_source_file()) {
-            // No file has been loaded → show message and return to main menu.
-            printf("\n[X] No files available for toxic analysis. "
-                "Please load files in Stage 1 first.\n");
-            return;
-        }
+// Frequency descending; ties keep dictionary order.
+static int cmp_toxic_frequency(const void* a, const void* b) {
+    int ia = *(const int*)a, ib = *(const int*)b;
+    int fa = g_dict->words[ia].frequency;
+    int fb = g_dict->words[ib].frequency;
+    if (fa != fb) return (fb > fa) ? 1 : -1;
+    return (ia > ib) - (ia < ib);
+}
 
-        const char* activePath = (g_use_file == 1)
-            ? inputFilePath1
-            : inputFilePath2;
-        printf("\n=== TOXIC CONTENT DETECTION ===\n");
-        printf("Current source file  : %s (%s)\n",
-            (g_use_file == 1) ? "File 1" : "File 2",
-            activePath);
-        printf("--------------------------------\n");
-        printf("1. Toxic Analysis\n");
-        printf("2. Dictionary Management\n");
-        printf("0. Back\n");
-        printf("Select: ");
+// Entry point for Stage 3 toxic content inspection.
+// Loads dictionary if missing and prints detailed toxicity report.
+void toxic_analysis() {
+    // Pinned for the whole report so the tables match what was detected
+    struct ToxicDictionary* dict = toxic_dict_acquire();
 
-        if (scanf("%d", &sub) != 1) {
-            int c;
-            while ((c = getchar()) != '\n' && c != EOF);
-            sub = -1;
-            continue;
-        }
+    printf("\n=== TOXIC CONTENT ANALYSIS ===\n");
+    printf("Detecting for toxic content...\n");
+    run_toxic_analysis();
 
-        int c;
-        while ((c = getchar()) != '\n' && c != EOF);
+    if (analysis_data.total_toxic_occurrences == 0 && analysis_data.fuzzy_toxic_occurrences == 0) {
+        printf("Your file contains no toxic content.\n");
+        toxic_dict_release(dict);
+        return;
+    }
 
-        switch (sub) {
-        case 1: {
-            // (1) Require that at least one file has been loaded.
-            if (!auto_select_source_file()) {
-                printf("[X] No files available. Please load files in Stage 1 first.\n");
-                break;
-            }
+    printf("\n--- TOXIC CONTENT SUMMARY ---\n");
+    printf("Total toxic words detected: %d\n", analysis_data.total_toxic_occurrences);
+    printf("Toxicity score: %.2f%% (%d toxic words out of %d total words detected)\n",
+        analysis_data.toxicity_density,
+        analysis_data.total_toxic_occurrences,
+        analysis_data.total_words_filtered);
 
-            const char* activePath = (g_use_file == 1) ? inputFilePath1 : inputFilePath2;
+    // All scores are computed at word level (single-word detections).
+    printf(" - Word-level (single words) : %d detections\n",
+        analysis_data.total_toxic_occurrences);
 
-            // (2) Require that Word Analysis has been run for this file.
-            if (!analysis_data.text_filtered ||
-                strcmp(current_filename, activePath) != 0) {
+    // Phrase detections (bigrams/trigrams) are reported separately and explicitly not included in the main toxicity score.
+    printf(" - Toxic bigram matches      : %d detections (not counted in total)\n",
+        analysis_data.bigram_toxic_occurrences);
+    printf(" - Toxic trigram matches     : %d detections (not counted in total)\n",
+        analysis_data.trigram_toxic_occurrences);
+    if (analysis_data.fuzzy_matching_enabled) {
+        printf(" - Fuzzy near-miss matches   : %d detections (not counted in total)\n",
+            analysis_data.fuzzy_toxic_occurrences);
+    }
 
-                printf("\n[X] Word Analysis not found for this file.\n");
-                printf("Go to Menu 2: Word Analysis first.\n\n");
-                break;
-            }
+    // Show severity distribution using a simple text-based bar chart.
+    printf("\n--- SEVERITY DISTRIBUTION ---\n");
+    int max_count = 0;
+    for (int i = 1; i <= 5; i++) {
+        if (analysis_data.severity_count[i] > max_count) {
+            max_count = analysis_data.severity_count[i];
+        }
+    }
 
-            printf("Running toxic analysis on %s: %s\n",
-                (g_use_file == 1) ? "File 1" : "File 2",
-                activePath);
+    for (int i = 1; i <= 5; i++) {
+        if (analysis_data.severity_count[i] > 0) {
+            float percentage = (float)analysis_data.severity_count[i] / analysis_data.total_toxic_occurrences * 100;
+            int bar_length = max_count > 0 ? (analysis_data.severity_count[i] * 20 / max_count) : 0;
 
-            toxic_analysis();
-            break;
-        }
-        case 2:
-            dictionary_management();
-            break;
-        case 0:
-            printf("Returning to main menu...\n");
-            break;
-        default:
-            printf("Invalid option. Please enter 0-2.\n");
+            printf("Level %d: ", i);
+            for (int j = 0; j < bar_length; j++) printf("#");
+            printf(" %d words (%.1f%%)\n", analysis_data.severity_count[i], percentage);
         }
-    } while (sub != 0);
-}
+    }
 
+    // List toxic words detected in this analysis, sorted by frequency.
+    printf("\n--- TOXIC WORDS DETECTED ---\n");
 
-// ===== 4. Stage 4 - Core Pair Building and Sorting Algorithms ======
+    // Sort indices of the detected words (not copies of the entries) by frequency.
+    int* detected = (int*)stage_malloc(sizeof(int) * (dict->word_count + 1));
+    int valid_count = 0;
 
-// Compare two Pair items by the primary key only (frequency or alphabet).
-static int cmp_primary(const Pair* a, const Pair* b, SortKey key) {
-    if (key == KEY_FREQ_DESC) {
-        if (a->count != b->count) return (b->count - a->count); // Sort by frequency in descending order.
-        return 0; // If frequencies are equal, primary key does not decide the order.
-    }
-    else { // KEY_ALPHA
-        int s = strcmp(a->word, b->word);
-        if (s != 0) return s;
-        return 0; // If words are identical, primary key does not decide the order.
+    for (int i = 0; detected && i < dict->word_count; i++) {
+        if (dict->words[i].frequency > 0) {
+            detected[valid_count++] = i;
+        }
     }
-}
+    if (valid_count > 1) qsort(detected, valid_count, sizeof(int), cmp_toxic_frequency);
 
-// Compare two Pair items using primary key and optional secondary tiebreak.
-static int cmp_pairs(const Pair* a, const Pair* b, SortKey key) {
-    int c = cmp_primary(a, b, key);
-    if (c != 0 || !g_use_secondary_tiebreak) return c;
+    if (valid_count > 0) {
+        printf("+-----------------+-----------+--------------+\n");
+        printf("| Word            | Frequency | Level (1-5)  |\n");
+        printf("+-----------------+-----------+--------------+\n");
 
-    // Apply the secondary key when primary key is tied.
-    if (key == KEY_FREQ_DESC) {
-        // When frequencies are equal, fall back to alphabetical order.
-        return strcmp(a->word, b->word);
+        for (int i = 0; i < valid_count; i++) {
+            // Compute how many digits the frequency has, so we can centre it in the column.
+            const struct ToxicWord* tw = &dict->words[detected[i]];
+            int freq = tw->frequency;
+            int freq_digits = 0;
+            if (freq == 0) freq_digits = 1;
+            else {
+                int temp = freq;
+                while (temp > 0) {
+                    freq_digits++;
+                    temp /= 10;
+                }
+            }
+
+            // Compute padding before and after the number to centre it (column width 11).
+            int total_spaces = 11 - freq_digits;
+            int spaces_before = total_spaces / 2;
+            int spaces_after = total_spaces - spaces_before;
+
+            printf("| %-15s |", tw->word);
+
+            for (int s = 0; s < spaces_before; s++) printf(" ");
+            printf("%d", freq);
+            for (int s = 0; s < spaces_after; s++) printf(" ");
+
+            printf("|      %d       |\n", tw->severity);
+        }
+        printf("+-----------------+-----------+--------------+\n");
     }
-    else { // KEY_ALPHA
-        // When words are equal, fall back to frequency (higher frequency first).
-        return (b->count - a->count);
+    else {
+        printf("No toxic words found.\n");
     }
-}
-
-// Sort a Pair array using Bubble Sort, tracking statistics.
-static void bubble_sort_pairs(Pair a[], int n, SortKey key) {
-    for (int i = 0; i < n - 1; ++i) {
-        int swapped = 0;
-        for (int j = 0; j < n - 1 - i; ++j) {
-            if (cmp_with_stats(&a[j], &a[j + 1], key) > 0) {
-                swap_pair(&a[j], &a[j + 1]);
-                swapped = 1;
+    free(detected);
+
+    // Sentences with the most toxic words (bounded heap, see score_toxic_tokens)
+    if (analysis_data.top_sentence_count > 0) {
+        const struct PositionIndex* pi = &analysis_data.positions;
+        char preview[TOXIC_SENTENCE_PREVIEW + 4];
+        printf("\n--- MOST TOXIC SENTENCES (top %d) ---\n", analysis_data.top_sentence_count);
+        for (int i = 0; i < analysis_data.top_sentence_count; i++) {
+            const struct ToxicSentence* ts = &analysis_data.top_sentences[i];
+            sentence_preview(ts->sentence, preview, sizeof(preview));
+            printf("%2d. Sentence %d (line %d): %d toxic of %d words, max level %d\n    %s\n",
+                i + 1, ts->sentence + 1,
+                position_mark_number(pi->line_start, pi->lines, pi->sentence_start[ts->sentence]),
+                ts->toxic, ts->words, ts->max_severity, preview);
+        }
+    }
+
+    // Fuzzy hits: misspellings within the edit-distance bound, shown per token.
+    if (analysis_data.fuzzy_matching_enabled) {
+        printf("\n--- FUZZY MATCHES (edit distance <= %d, not counted in total) ---\n",
+            analysis_data.fuzzy_max_distance);
+        if (analysis_data.fuzzy_toxic_occurrences > 0) {
+            printf("+-----------------+-----------------+----------+-----------+\n");
+            printf("| Token           | Closest entry   | Distance | Frequency |\n");
+            printf("+-----------------+-----------------+----------+-----------+\n");
+            for (int i = 0; i < g_fuzzy_memo_size; i++) {
+                const struct FuzzyMemo* m = &g_fuzzy_memo[i];
+                if (m->hits == 0) continue;
+                printf("| %-15s | %-15s | %8d | %9d |\n",
+                    m->token, dict->words[m->match].word, m->distance, m->hits);
             }
+            printf("+-----------------+-----------------+----------+-----------+\n");
+        }
+        else {
+            printf("No fuzzy matches found.\n");
         }
-        if (!swapped) break;
     }
-}
 
-// Partition function for Quick Sort on Pair arrays, tracking moves and comparisons.
-static int partition_pairs(Pair a[], int l, int r, SortKey key) {
-    Pair pivot = a[r];               g_stats.moves++; // Reading pivot into a local variable counts as one move.
-    int i = l - 1;
-    for (int j = l; j < r; ++j) {
-        if (cmp_with_stats(&a[j], &pivot, key) <= 0) {
-            ++i; swap_pair(&a[i], &a[j]);
+    // Report toxic phrase patterns that were matched in the text.
+    printf("\n--- TOXIC PHRASES (patterns only) ---\n");
+    int phrase_found = 0;
+    int total_phrase_occurrences = 0;
+
+    //  First compute the total number of toxic phrase occurrences (for summary).
+    for (int i = 0; i < dict->phrase_count; i++) {
+        if (dict->phrases[i].frequency > 0) {
+            total_phrase_occurrences += dict->phrases[i].frequency;
         }
     }
-    swap_pair(&a[i + 1], &a[r]);
-    return i + 1;
-}
 
-// Recursive Quick Sort for Pair arrays using the common comparator.
-static void quick_sort_pairs(Pair a[], int l, int r, SortKey key) {
-    if (l >= r) return;
-    int p = partition_pairs(a, l, r, key);
-    quick_sort_pairs(a, l, p - 1, key);
-    quick_sort_pairs(a, p + 1, r, key);
-}
+    if (total_phrase_occurrences > 0) {
+        for (int i = 0; i < dict->phrase_count; i++) {
+            if (dict->phrases[i].frequency > 0) {
 
-// Merge step for Merge Sort on Pair arrays, tracking data moves.
-static void merge_pairs(Pair a[], int l, int m, int r, SortKey key) {
-    int n1 = m - l + 1, n2 = r - m;
-    Pair* L = (Pair*)malloc(sizeof(Pair) * n1);
-    Pair* R = (Pair*)malloc(sizeof(Pair) * n2);
-    for (int i = 0; i < n1; ++i) { L[i] = a[l + i]; g_stats.moves++; }
-    for (int j = 0; j < n2; ++j) { R[j] = a[m + 1 + j]; g_stats.moves++; }
+                const char* phrase = dict->phrases[i].phrase;
+                int freq = dict->phrases[i].frequency;
+                int sev = dict->phrases[i].severity;
 
-    int i = 0, j = 0, k = l;
-    while (i < n1 && j < n2) {
-        if (cmp_with_stats(&L[i], &R[j], key) <= 0) { a[k++] = L[i++]; g_stats.moves++; }
-        else { a[k++] = R[j++]; g_stats.moves++; }
-    }
+                printf("Detected phrase: %s\n", phrase);
+                printf("  Frequency: %d time(s)\n", freq);
+
+                // Use helper to inspect how many toxic words appear inside the phrase.
+                char found_words[10][MAX_WORD_LENGTH];
+                int max_sev_in_phrase = 0;
+                int toxic_word_count = phrase_contains_toxic_words(
+                    phrase,
+                    found_words,
+                    10,
+                    &max_sev_in_phrase
+                );
+
+                if (toxic_word_count > 0) {
+                    printf("  Contains toxic word(s): ");
+                    for (int k = 0; k < toxic_word_count; k++) {
+                        if (k > 0) printf(", ");
+                        printf("%s", found_words[k]);
+                    }
+                    printf("\n");
+
+                    if (toxic_word_count >= 2) {
+                        // Fixed combinations containing multiple toxic words (multi-toxic phrase).
+                        printf("  Note: Multi-toxic phrase (contains %d toxic words, max severity %d)\n",
+                            toxic_word_count,
+                            max_sev_in_phrase > 0 ? max_sev_in_phrase : sev);
+                    }
+                }
+                else {
+                    printf("  Context-based toxicity (combination of non-toxic words)\n");
+                }
+
+                printf("  Overall severity: Level %d\n\n", sev);
+                phrase_found = 1;
+            }
+        }
+    }
+    else {
+        printf("No toxic phrases detected.\n");
+    }
+    toxic_dict_release(dict);
+}
+
+// Display all toxic words and phrases currently stored in the dictionary.
+void view_all_toxic_words() {
+    printf("\n=== TOXIC DICTIONARY OVERVIEW ===\n");
+    printf("Total words: %d, Total phrases: %d\n\n",
+        g_dict->word_count, g_dict->phrase_count);
+
+    // Show words grouped by severity level.
+    printf("TOXIC WORDS BY SEVERITY LEVEL:\n");
+    printf("-------------------------------\n");
+
+    const int* order = toxic_word_order();
+    for (int severity = 1; severity <= 5; severity++) {
+        printf("\nLevel %d:\n", severity);
+        int count = 0;
+        for (int k = 0; k < g_dict->word_count; k++) {
+            int i = order ? order[k] : k;
+            if (g_dict->words[i].severity == severity) {
+                printf("%-15s", g_dict->words[i].word);
+                count++;
+                if (count % 5 == 0) printf("\n"); // Print 5 words per line.
+            }
+        }
+        if (count % 5 != 0) printf("\n"); // Ensure ending newline for partial lines.
+        printf("Total: %d words\n", count);
+    }
+
+    // Show all toxic phrases and their related toxic words.
+    printf("\nTOXIC PHRASES:\n");
+    printf("--------------\n");
+    int phrases_displayed = 0;
+    for (int i = 0; i < g_dict->phrase_count; i++) {
+        // Check if the phrase contains any known toxic words.
+        char found_toxic_words[10][MAX_WORD_LENGTH];
+        int toxic_word_count = phrase_contains_toxic_words(
+            g_dict->phrases[i].phrase,
+            found_toxic_words,
+            10,
+            NULL   // No need to track max severity here.
+        );
+
+        printf("%2d. %s (Level %d)",
+            i + 1,
+            g_dict->phrases[i].phrase,
+            g_dict->phrases[i].severity);
+
+        if (toxic_word_count > 0) {
+            printf(" - Contains: ");
+            for (int j = 0; j < toxic_word_count; j++) {
+                if (j > 0) printf(", ");
+                printf("%s", found_toxic_words[j]);
+            }
+        }
+        else {
+            printf(" - Combination toxicity");
+        }
+        printf("\n");
+        phrases_displayed++;
+    }
+    if (phrases_displayed == 0) {
+        printf("No toxic phrases in dictionary.\n");
+    }
+}
+
+// Menu handler for dictionary operations (add/remove/view toxic entries).
+void dictionary_management() {
+    char option;
+    // Edits must apply on top of the stored dictionary, not an empty one
+    ensure_toxic_dictionary();
+    do {
+        printf("\n=== TOXIC DICTIONARY MANAGEMENT ===\n");
+        printf("Current dictionary: %d words and %d phrases\n",
+            g_dict->word_count, g_dict->phrase_count);
+        printf("File: toxicwords.txt\n");
+
+        printf("\n1. Add new toxic word or phrase\n");
+        printf("2. Remove toxic word or phrase\n");
+        printf("3. View dictionary\n");
+        printf("0. Back to menu\n");
+        option = get_menu_option("1230", "Enter your option (0-3): ");
+
+        switch (option) {
+        case '1':
+            add_custom_toxic_word();
+            break;
+        case '2':
+            remove_toxic_word();
+            break;
+        case '3':
+            view_all_toxic_words();
+            break;
+        case '0':
+            // End of the curation session: fold journalled edits into the file
+            compact_toxic_journal();
+            printf("Returning to menu...\n");
+            break;
+        default:
+            printf("Invalid option. Please enter 0-3.\n");
+        }
+    } while (option != '0');
+}
+
+// Add a custom toxic word or phrase to the in-memory dictionary and save to file.
+void add_custom_toxic_word() {
+    char new_input[MAX_WORD_LENGTH * 3];
+    printf("Enter new toxic word or phrase: ");
+    if (!read_line(new_input, sizeof(new_input))) {
+        printf("Failed to read input.\n");
+        return;
+    }
+
+    // Normalise input to lowercase for matching and storage.
+    char lower_input[MAX_WORD_LENGTH * 3];
+    strcpy(lower_input, new_input);
+    for (int i = 0; lower_input[i]; i++) {
+        lower_input[i] = (char)tolower((unsigned char)lower_input[i]);
+    }
+
+    int i = 0;
+    while (lower_input[i] && isspace((unsigned char)lower_input[i])) i++;
+    if (lower_input[i] == '\0') return;
+
+    // Decide whether this is a single word or a phrase (contains spaces).
+    if (strchr(lower_input, ' ') == NULL) {
+        // ===== Single-word branch =====
+        // Check if word already exists in the dictionary.
+        if (toxic_word_lookup(lower_input) != -1) {
+            printf("Word '%s' already exists in the dictionary.\n", new_input);
+            return;
+        }
+
+        int severity;
+        printf("Enter severity (Level 1-5): ");
+        scanf("%d", &severity);
+        getchar();
+        if (severity < 1 || severity > 5) {
+            printf("Invalid severity. Using Level 3 as default.\n");
+            severity = 3;
+        }
+
+        // Add the word (alphabetical order is kept by the ordered index) and journal it.
+        dict_add_word(lower_input, severity);
+        journal_toxic_edit('+', lower_input, severity);
+        printf("Added word '%s' with Level %d and saved to dictionary\n",
+            new_input, severity);
+    }
+    else {
+        // ===== phrase branch =====
+        add_custom_toxic_phrase(lower_input);
+    }
+}
+
+// Add a new toxic phrase and optionally mark words inside it as toxic words.
+void add_custom_toxic_phrase(const char* phrase) {
+    // Split the phrase into individual words (up to 10).
+    char phrase_copy[MAX_WORD_LENGTH * 3];
+    strncpy(phrase_copy, phrase, sizeof(phrase_copy) - 1);
+    phrase_copy[sizeof(phrase_copy) - 1] = '\0';
+
+    char words[10][MAX_WORD_LENGTH];
+    int  word_count = 0;
+
+    char* tok = strtok(phrase_copy, " ");
+    while (tok && word_count < 10) {
+        strncpy(words[word_count], tok, MAX_WORD_LENGTH - 1);
+        words[word_count][MAX_WORD_LENGTH - 1] = '\0';
+        word_count++;
+        tok = strtok(NULL, " ");
+    }
+
+    if (word_count < 2) {
+        printf("Phrase should contain at least two words.\n");
+        return;
+    }
+
+    // Check which words are already in the toxic word dictionary.
+    int is_toxic[10] = { 0 };
+    int word_sev[10] = { 0 };
+    for (int i = 0; i < word_count; i++) {
+        int sev = get_toxic_severity(words[i]);
+        if (sev > 0) {
+            is_toxic[i] = 1;
+            word_sev[i] = sev;
+        }
+    }
+
+    // Show each word in the phrase and current toxicity information (if any).
+    printf("\nWords in phrase:\n");
+    for (int i = 0; i < word_count; i++) {
+        if (is_toxic[i]) {
+            printf("  %d) %s  (already toxic, Level %d)\n",
+                i + 1, words[i], word_sev[i]);
+        }
+        else {
+            printf("  %d) %s\n", i + 1, words[i]);
+        }
+    }
+
+    // Ask once which positions should be marked as toxic words (avoid many y/n prompts).
+    int selected[10] = { 0 };
+    char line[128];
+
+    printf("\nWhich positions are TOXIC words? \n");
+    printf("Enter numbers separated by space (e.g. 2 3), or 0 if you don't want to add new toxic words:\n> ");
+
+    if (read_line(line, sizeof(line))) {
+        char* p = strtok(line, " ");
+        while (p) {
+            int idx = atoi(p);
+            if (idx == 0) {
+                // 0 means "no new toxic words to add"
+                break;
+            }
+            if (idx >= 1 && idx <= word_count) {
+                selected[idx - 1] = 1;
+            }
+            p = strtok(NULL, " ");
+        }
+    }
+
+    // For each selected word that is not yet toxic, ask for its severity and add it.
+    for (int i = 0; i < word_count; i++) {
+        if (selected[i] && !is_toxic[i]) {
+            int sev;
+            printf("Set severity for new toxic word '%s' (1-5): ", words[i]);
+            scanf("%d", &sev);
+            getchar();
+            if (sev < 1 || sev > 5) {
+                printf("  Invalid severity. Using Level 3.\n");
+                sev = 3;
+            }
+
+            // Insert into toxic word dictionary if there is space.
+            if (dict_add_word(words[i], sev) != -1) {
+                journal_toxic_edit('+', words[i], sev);
+            }
+
+            is_toxic[i] = 1;
+            word_sev[i] = sev;
+        }
+    }
+
+    // Finally, compute how many toxic words are in the phrase and their maximum severity.
+    int final_toxic_count = 0;
+    int final_max_sev = 0;
+    for (int i = 0; i < word_count; i++) {
+        int sev = get_toxic_severity(words[i]);
+        if (sev > 0) {
+            final_toxic_count++;
+            if (sev > final_max_sev) final_max_sev = sev;
+        }
+    }
+
+    int phrase_severity = 0;
+
+    if (final_toxic_count == 0) {
+        // Case A: purely context-based phrase (no toxic words inside).
+        // Ask user for a severity for the whole phrase and store it.
+        printf("\nNo toxic words inside this phrase so far.\n");
+        printf("Set severity for the phrase '%s' (1-5): ", phrase);
+        scanf("%d", &phrase_severity);
+        getchar();
+        if (phrase_severity < 1 || phrase_severity > 5) {
+            printf("Invalid severity. Using Level 3.\n");
+            phrase_severity = 3;
+        }
+    }
+    else if (final_toxic_count == 1) {
+        // Case B: exactly one toxic word in the phrase.
+        // By design this is NOT stored as a separate toxic phrase,
+        // detection will rely on that single toxic word.
+        printf("\nThis phrase contains exactly ONE toxic word.\n");
+        printf("It will not be stored as a toxic phrase.\n");
+        printf("Toxic detection will rely on the toxic word itself only.\n");
+        return;  // Do not add to phrase list (new words are already journalled).
+    }
+
+    else {
+        // Case C: phrase contains two or more toxic words → treat as a multi-toxic phrase.
+        phrase_severity = (final_max_sev > 0) ? final_max_sev : 3;
+        printf("\nPhrase contains %d toxic word(s). Phrase severity set to Level %d (max of words).\n",
+            final_toxic_count, phrase_severity);
+    }
+
+    // Only Case A and Case C reach this point: store phrase in dictionary.
+    if (dict_add_phrase(phrase, phrase_severity, word_count) != -1) {
+        journal_toxic_edit('+', phrase, phrase_severity);
+        printf("Added phrase '%s' (severity: %d, words: %d, toxic_words: %d)\n",
+            phrase, phrase_severity, word_count, final_toxic_count);
+    }
+}
+
+// Remove a toxic word or phrase from the dictionary by text match.
+void remove_toxic_word() {
+    // Use a larger buffer so both words and phrases can be entered.
+    char word_to_remove[MAX_WORD_LENGTH * 3];
+    printf("Enter toxic word or phrase to remove: ");
+    if (!read_line(word_to_remove, sizeof(word_to_remove))) {
+        printf("Failed to read input.\n");
+        return;
+    }
+
+    if (strlen(word_to_remove) == 0) {
+        printf("No input provided.\n");
+        return;
+    }
+
+    // Normalise to lowercase so we can do case-insensitive comparison.
+    for (int i = 0; word_to_remove[i]; i++) {
+        word_to_remove[i] = (char)tolower((unsigned char)word_to_remove[i]);
+    }
+
+    bool removed = false;
+
+    // 1. Try to remove from the toxic word list first.
+    int idx = toxic_word_lookup(word_to_remove);
+    if (idx != -1) {
+        dict_remove_word(idx);
+        removed = true;
+        printf("Removed '%s' from toxic word list.\n", word_to_remove);
+    }
+
+    // 2. If not found in words, try to remove from the phrase list.
+    if (!removed) {
+        idx = toxic_phrase_lookup(word_to_remove);
+        if (idx != -1) {
+            dict_remove_phrase(idx);
+            removed = true;
+            printf("Removed '%s' from toxic phrase list.\n", word_to_remove);
+        }
+    }
+
+    // 3. If not found in either list, report to the user.
+    if (!removed) {
+        printf("'%s' not found in toxic word or phrase dictionary.\n", word_to_remove);
+        return;
+    }
+
+    // If something was removed, record it in the dictionary journal.
+    journal_toxic_edit('-', word_to_remove, 0);
+    printf("Dictionary file updated.\n");
+}
+
+// Save the current toxic word and phrase dictionary to a file.
+void save_toxic_dictionary(const char* filename) {
+    FILE* file = fopen(filename, "w");
+    if (!file) {
+        printf("Error: Cannot save toxic dictionary to %s\n", filename);
+        return;
+    }
+
+    // Write file header.
+    fprintf(file, "# Toxic Words Dictionary\n");
+    fprintf(file, "# Format: word,severity\n");
+    fprintf(file, "# Severity: 1-5 (1=mild, 5=severe)\n\n");
+
+    // Write all toxic words (including custom user-added entries) in A-Z order.
+    const int* order = toxic_word_order();
+    for (int i = 0; i < g_dict->word_count; i++) {
+        int w = order ? order[i] : i;
+        fprintf(file, "%s,%d\n",
+            g_dict->words[w].word,
+            g_dict->words[w].severity);
+    }
+
+    // Write all toxic phrases.
+    for (int i = 0; i < g_dict->phrase_count; i++) {
+        fprintf(file, "%s,%d\n",
+            g_dict->phrases[i].phrase,
+            g_dict->phrases[i].severity);
+    }
+
+    fclose(file);
+    printf("Toxic dictionary saved to: %s (%d words, %d phrases)\n",
+        filename, g_dict->word_count, g_dict->phrase_count);
+
+    // Keep the lookup index and the compiled copy in step with the text source
+    char bin_path[260];
+    toxic_compiled_path(filename, bin_path, sizeof(bin_path));
+    build_toxic_index();
+    compile_toxic_dictionary(bin_path);
+    toxic_dict_changed();
+}
+
+// ========== STAGE 3 MENU DISPLAY FUNCTION ==========
+void display_toxic_menu() {
+    int sub = -1;
+    do {
+        if (!auto_select_source_file()) {
+            // No file has been loaded → show message and return to main menu.
+            printf("\n[X] No files available for toxic analysis. "
+                "Please load files in Stage 1 first.\n");
+            return;
+        }
+
+        const char* activePath = (g_use_file == 1)
+            ? inputFilePath1
+            : inputFilePath2;
+        printf("\n=== TOXIC CONTENT DETECTION ===\n");
+        printf("Current source file  : %s (%s)\n",
+            (g_use_file == 1) ? "File 1" : "File 2",
+            activePath);
+        printf("--------------------------------\n");
+        printf("1. Toxic Analysis\n");
+        printf("2. Dictionary Management\n");
+        printf("3. Fuzzy matching (current: %s)\n",
+            analysis_data.fuzzy_matching_enabled ? "ON" : "OFF");
+        printf("4. Keyword in Context (word or phrase)\n");
+        printf("5. Toxicity Hotspots (sliding window)\n");
+        printf("0. Back\n");
+        printf("Select: ");
+
+        if (scanf("%d", &sub) != 1) {
+            int c;
+            while ((c = getchar()) != '\n' && c != EOF);
+            sub = -1;
+            continue;
+        }
+
+        int c;
+        while ((c = getchar()) != '\n' && c != EOF);
+
+        switch (sub) {
+        case 1: {
+            // (1) Require that at least one file has been loaded.
+            if (!auto_select_source_file()) {
+                printf("[X] No files available. Please load files in Stage 1 first.\n");
+                break;
+            }
+
+            const char* activePath = (g_use_file == 1) ? inputFilePath1 : inputFilePath2;
+
+            // (2) Require that Word Analysis has been run for this file.
+            if (!analysis_data.text_filtered ||
+                strcmp(current_filename, activePath) != 0) {
+
+                printf("\n[X] Word Analysis not found for this file.\n");
+                printf("Go to Menu 2: Word Analysis first.\n\n");
+                break;
+            }
+
+            printf("Running toxic analysis on %s: %s\n",
+                (g_use_file == 1) ? "File 1" : "File 2",
+                activePath);
+
+            toxic_analysis();
+            break;
+        }
+        case 2:
+            dictionary_management();
+            break;
+        case 3:
+            toggle_fuzzy_matching();
+            break;
+        case 4:
+            if (!analysis_data.text_filtered) {
+                printf("\n[X] Word Analysis not found for this file.\n");
+                printf("Go to Menu 2: Word Analysis first.\n\n");
+            }
+            else {
+                keyword_in_context();
+            }
+            break;
+        case 5:
+            toxicity_hotspots();
+            break;
+        case 0:
+            printf("Returning to main menu...\n");
+            break;
+        default:
+            printf("Invalid option. Please enter 0-5.\n");
+        }
+    } while (sub != 0);
+}
+
+
+// ===== 4. Stage 4 - Core Pair Building and Sorting Algorithms ======
+
+// Compare two Pair items by the primary key only (frequency or alphabet).
+static int cmp_primary(const Pair* a, const Pair* b, SortKey key) {
+    if (key == KEY_FREQ_DESC) {
+        if (a->count != b->count) return (b->count - a->count); // Sort by frequency in descending order.
+        return 0; // If frequencies are equal, primary key does not decide the order.
+    }
+    else { // KEY_ALPHA
+        int s = (a->id == b->id) ? 0 : strcmp(token_text(a->id), token_text(b->id));
+        if (s != 0) return s;
+        return 0; // If words are identical, primary key does not decide the order.
+    }
+}
+
+// Compare two Pair items using primary key and optional secondary tiebreak.
+static int cmp_pairs(const Pair* a, const Pair* b, SortKey key) {
+    int c = cmp_primary(a, b, key);
+    if (c != 0 || !g_use_secondary_tiebreak) return c;
+
+    // Apply the secondary key when primary key is tied.
+    if (key == KEY_FREQ_DESC) {
+        // When frequencies are equal, fall back to alphabetical order.
+        return (a->id == b->id) ? 0 : strcmp(token_text(a->id), token_text(b->id));
+    }
+    else { // KEY_ALPHA
+        // When words are equal, fall back to frequency (higher frequency first).
+        return (b->count - a->count);
+    }
+}
+
+// Sort a Pair array using Bubble Sort, tracking statistics.
+static void bubble_sort_pairs(Pair a[], int n, SortKey key) {
+    for (int i = 0; i < n - 1; ++i) {
+        int swapped = 0;
+        for (int j = 0; j < n - 1 - i; ++j) {
+            if (cmp_with_stats(&a[j], &a[j + 1], key) > 0) {
+                swap_pair(&a[j], &a[j + 1]);
+                swapped = 1;
+            }
+        }
+        if (!swapped) break;
+    }
+}
+
+// Partition function for Quick Sort on Pair arrays, tracking moves and comparisons.
+static int partition_pairs(Pair a[], int l, int r, SortKey key) {
+    Pair pivot = a[r];               g_stats.moves++; // Reading pivot into a local variable counts as one move.
+    int i = l - 1;
+    for (int j = l; j < r; ++j) {
+        if (cmp_with_stats(&a[j], &pivot, key) <= 0) {
+            ++i; swap_pair(&a[i], &a[j]);
+        }
+    }
+    swap_pair(&a[i + 1], &a[r]);
+    return i + 1;
+}
+
+// Recursive Quick Sort for Pair arrays using the common comparator.
+static void quick_sort_pairs(Pair a[], int l, int r, SortKey key) {
+    if (l >= r) return;
+    int p = partition_pairs(a, l, r, key);
+    quick_sort_pairs(a, l, p - 1, key);
+    quick_sort_pairs(a, p + 1, r, key);
+}
+
+// Merge step for Merge Sort on Pair arrays, tracking data moves.
+static void merge_pairs(Pair a[], int l, int m, int r, SortKey key) {
+    int n1 = m - l + 1, n2 = r - m;
+    Pair* L = (Pair*)stage_malloc(sizeof(Pair) * n1);
+    Pair* R = (Pair*)stage_malloc(sizeof(Pair) * n2);
+    for (int i = 0; i < n1; ++i) { L[i] = a[l + i]; g_stats.moves++; }
+    for (int j = 0; j < n2; ++j) { R[j] = a[m + 1 + j]; g_stats.moves++; }
+
+    int i = 0, j = 0, k = l;
+    while (i < n1 && j < n2) {
+        if (cmp_with_stats(&L[i], &R[j], key) <= 0) { a[k++] = L[i++]; g_stats.moves++; }
+        else { a[k++] = R[j++]; g_stats.moves++; }
+    }
     while (i < n1) { a[k++] = L[i++]; g_stats.moves++; }
     while (j < n2) { a[k++] = R[j++]; g_stats.moves++; }
     free(L); free(R);
 }
 
-// Recursive Merge Sort for Pair arrays using the common comparator.
-static void merge_sort_pairs(Pair a[], int l, int r, SortKey key) {
-    if (l >= r) return;
-    int m = (l + r) / 2;
-    merge_sort_pairs(a, l, m, key);
-    merge_sort_pairs(a, m + 1, r, key);
-    merge_pairs(a, l, m, r, key);
+// Recursive Merge Sort for Pair arrays using the common comparator.
+static void merge_sort_pairs(Pair a[], int l, int r, SortKey key) {
+    if (l >= r) return;
+    int m = (l + r) / 2;
+    merge_sort_pairs(a, l, m, key);
+    merge_sort_pairs(a, m + 1, r, key);
+    merge_pairs(a, l, m, r, key);
+}
+
+// ----- Adaptive sort (ALG_AUTO) -----
+// ALG_AUTO looks at n, the key and how many runs the input already has,
+// then picks one of the strategies below; g_stats.strategy records which.
+
+// Insertion sort on a[l..r] (tiny inputs and short introsort partitions).
+static void insertion_sort_pairs(Pair a[], int l, int r, SortKey key) {
+    for (int i = l + 1; i <= r; ++i) {
+        Pair x = a[i];                 g_stats.moves++;
+        int j = i - 1;
+        while (j >= l && cmp_with_stats(&a[j], &x, key) > 0) {
+            a[j + 1] = a[j];           g_stats.moves++;
+            j--;
+        }
+        a[j + 1] = x;                  g_stats.moves++;
+    }
+}
+
+// Max-heap sift over the n items starting at a[l].
+static void sift_down_pairs(Pair a[], int l, int root, int n, SortKey key) {
+    for (;;) {
+        int child = 2 * root + 1;
+        if (child >= n) return;
+        if (child + 1 < n && cmp_with_stats(&a[l + child], &a[l + child + 1], key) < 0) child++;
+        if (cmp_with_stats(&a[l + root], &a[l + child], key) >= 0) return;
+        swap_pair(&a[l + root], &a[l + child]);
+        root = child;
+    }
+}
+
+// Heap sort on a[l..r]; introsort's fallback when partitions go bad.
+static void heap_sort_pairs(Pair a[], int l, int r, SortKey key) {
+    int n = r - l + 1;
+    for (int i = n / 2 - 1; i >= 0; --i) sift_down_pairs(a, l, i, n, key);
+    for (int end = n - 1; end > 0; --end) {
+        swap_pair(&a[l], &a[l + end]);
+        sift_down_pairs(a, l, 0, end, key);
+    }
+}
+
+// Median-of-three quick sort that switches to heap sort past `depth`
+// levels and finishes short ranges with insertion sort. O(n log n) always.
+static void introsort_pairs(Pair a[], int l, int r, int depth, SortKey key) {
+    while (r - l + 1 > AUTO_INSERTION_MAX) {
+        if (depth-- == 0) {
+            heap_sort_pairs(a, l, r, key);
+            return;
+        }
+        int m = l + (r - l) / 2;
+        if (cmp_with_stats(&a[m], &a[l], key) < 0) swap_pair(&a[m], &a[l]);
+        if (cmp_with_stats(&a[r], &a[l], key) < 0) swap_pair(&a[r], &a[l]);
+        if (cmp_with_stats(&a[r], &a[m], key) < 0) swap_pair(&a[r], &a[m]);
+        Pair pivot = a[m];             g_stats.moves++;
+
+        int i = l, j = r;
+        while (i <= j) {
+            while (cmp_with_stats(&a[i], &pivot, key) < 0) i++;
+            while (cmp_with_stats(&a[j], &pivot, key) > 0) j--;
+            if (i <= j) {
+                swap_pair(&a[i], &a[j]);
+                i++; j--;
+            }
+        }
+        // Recurse into the smaller side so the stack stays O(log n)
+        if (j - l < r - i) { introsort_pairs(a, l, j, depth, key); l = i; }
+        else { introsort_pairs(a, i, r, depth, key); r = j; }
+    }
+    insertion_sort_pairs(a, l, r, key);
+}
+
+static void introsort_all_pairs(Pair a[], int l, int r, SortKey key) {
+    int depth = 0;
+    for (int n = r - l + 1; n > 1; n >>= 1) depth += 2;
+    introsort_pairs(a, l, r, depth, key);
+}
+
+// End (exclusive) of the run starting at lo: non-descending, or strictly
+// descending (reversed in place when `fix` is set, which keeps it stable).
+static int pair_run_end(Pair a[], int lo, int n, SortKey key, int fix) {
+    int hi = lo + 1;
+    if (hi >= n) return n;
+    if (cmp_with_stats(&a[lo], &a[hi], key) > 0) {
+        while (hi + 1 < n && cmp_with_stats(&a[hi], &a[hi + 1], key) > 0) hi++;
+        if (fix) {
+            for (int i = lo, j = hi; i < j; i++, j--) swap_pair(&a[i], &a[j]);
+        }
+    }
+    else {
+        while (hi + 1 < n && cmp_with_stats(&a[hi], &a[hi + 1], key) <= 0) hi++;
+    }
+    return hi + 1;
+}
+
+static int count_pair_runs(Pair a[], int n, SortKey key) {
+    int runs = 0;
+    for (int lo = 0; lo < n; lo = pair_run_end(a, lo, n, key, 0)) runs++;
+    return runs;
+}
+
+// ALG_TIM, a timsort-style stable sort: detect the runs already in the input (reversing strictly
+// descending ones), extend short runs to `minrun` with binary insertion,
+// and merge them in powersort order. Merges skip the parts of each run that
+// are already in place and gallop when one side keeps winning, so nearly
+// sorted input costs close to O(n).
+
+// Minimum run length: n itself for small n, else a value in [32, 64] that
+// makes n / minrun close to (and not above) a power of two.
+static int tim_minrun(int n) {
+    int r = 0;
+    while (n >= 64) {
+        r |= n & 1;
+        n >>= 1;
+    }
+    return n + r;
+}
+
+// a[lo..start) is sorted; insert a[start..end) one by one, after equals.
+static void binary_insertion_sort_pairs(Pair a[], int lo, int start, int end, SortKey key) {
+    for (int i = start; i < end; ++i) {
+        Pair x = a[i];                 g_stats.moves++;
+        int l = lo, r = i;
+        while (l < r) {
+            int m = l + (r - l) / 2;
+            if (cmp_with_stats(&x, &a[m], key) < 0) r = m;
+            else l = m + 1;
+        }
+        memmove(a + l + 1, a + l, sizeof(Pair) * (i - l));
+        a[l] = x;
+        g_stats.moves += i - l + 1;
+    }
+}
+
+// Number of leading items of a[0..n) that are <= x (exponential, then
+// binary search).
+static int gallop_right_pairs(const Pair* x, const Pair a[], int n, SortKey key) {
+    if (n == 0 || cmp_with_stats(x, &a[0], key) < 0) return 0;
+    int last = 0, ofs = 1;             // a[last] <= x
+    while (ofs < n && cmp_with_stats(x, &a[ofs], key) >= 0) {
+        last = ofs;
+        ofs = ofs * 2 + 1;
+    }
+    if (ofs > n) ofs = n;
+    int lo = last + 1, hi = ofs;
+    while (lo < hi) {
+        int m = lo + (hi - lo) / 2;
+        if (cmp_with_stats(x, &a[m], key) < 0) hi = m;
+        else lo = m + 1;
+    }
+    return lo;
+}
+
+// Number of leading items of a[0..n) that are < x.
+static int gallop_left_pairs(const Pair* x, const Pair a[], int n, SortKey key) {
+    if (n == 0 || cmp_with_stats(&a[0], x, key) >= 0) return 0;
+    int last = 0, ofs = 1;             // a[last] < x
+    while (ofs < n && cmp_with_stats(&a[ofs], x, key) < 0) {
+        last = ofs;
+        ofs = ofs * 2 + 1;
+    }
+    if (ofs > n) ofs = n;
+    int lo = last + 1, hi = ofs;
+    while (lo < hi) {
+        int m = lo + (hi - lo) / 2;
+        if (cmp_with_stats(&a[m], x, key) < 0) lo = m + 1;
+        else hi = m;
+    }
+    return lo;
+}
+
+// Stable merge of the sorted runs a[lo..mid) and a[mid..hi). tmp holds at
+// least mid - lo items; *min_gallop adapts across merges.
+static void tim_merge_pairs(Pair a[], int lo, int mid, int hi, Pair* tmp, int* min_gallop, SortKey key) {
+    // Items already in their final place: the head of the left run that is
+    // <= the right run's first item, and the tail of the right run that is
+    // >= the left run's last item
+    lo += gallop_right_pairs(&a[mid], a + lo, mid - lo, key);
+    if (lo == mid) return;
+    hi = mid + gallop_left_pairs(&a[mid - 1], a + mid, hi - mid, key);
+    if (hi == mid) return;
+
+    int na = mid - lo;
+    memcpy(tmp, a + lo, sizeof(Pair) * na);
+    g_stats.moves += na;
+    int i = 0, j = mid, d = lo;        // Left run in tmp[i..na), right in a[j..hi)
+    int mg = *min_gallop;
+
+    while (i < na && j < hi) {
+        // One item at a time until one side wins mg times in a row
+        int wins_a = 0, wins_b = 0;
+        while (i < na && j < hi && wins_a < mg && wins_b < mg) {
+            if (cmp_with_stats(&a[j], &tmp[i], key) < 0) {
+                a[d++] = a[j++];
+                wins_b++;
+                wins_a = 0;
+            }
+            else {
+                a[d++] = tmp[i++];
+                wins_a++;
+                wins_b = 0;
+            }
+            g_stats.moves++;
+        }
+
+        // Galloping: move whole blocks while that keeps paying off
+        while (i < na && j < hi) {
+            int ka = gallop_right_pairs(&a[j], tmp + i, na - i, key);
+            memcpy(a + d, tmp + i, sizeof(Pair) * ka);
+            d += ka; i += ka;
+            if (i == na) break;
+            a[d++] = a[j++];           // Now a[j] < tmp[i]
+            g_stats.moves += ka + 1;
+            if (j == hi) break;
+
+            int kb = gallop_left_pairs(&tmp[i], a + j, hi - j, key);
+            memmove(a + d, a + j, sizeof(Pair) * kb);
+            d += kb; j += kb;
+            if (j == hi) break;
+            a[d++] = tmp[i++];         // Now tmp[i] <= a[j]
+            g_stats.moves += kb + 1;
+
+            if (ka < TIM_MIN_GALLOP && kb < TIM_MIN_GALLOP) {
+                mg++;                  // Not paying off: back to one at a time
+                break;
+            }
+            if (mg > 1) mg--;
+        }
+    }
+
+    // Whatever is left of the right run is already in place
+    if (i < na) {
+        memcpy(a + d, tmp + i, sizeof(Pair) * (na - i));
+        g_stats.moves += na - i;
+    }
+    *min_gallop = mg;
+}
+
+// Merge-tree depth of the boundary between the runs [s1, s1 + n1) and
+// [s1 + n1, s1 + n1 + n2) in an array of n items (powersort).
+static int powersort_power(int s1, int n1, int n2, int n) {
+    long long a = 2LL * s1 + n1;       // Twice the run midpoints
+    long long b = a + n1 + n2;
+    int power = 0;
+    for (;;) {
+        ++power;
+        if (a >= n) {
+            a -= n;
+            b -= n;
+        }
+        else if (b >= n) {
+            break;
+        }
+        a <<= 1;
+        b <<= 1;
+    }
+    return power;
+}
+
+// Returns 0 if out of memory (a[] is then a permutation of the input).
+static int tim_sort_pairs(Pair a[], int n, SortKey key) {
+    struct { int start, len, power; } runs[TIM_MAX_RUNS];
+    int top = 0;
+    if (n < 2) return 1;
+
+    Pair* tmp = (Pair*)stage_malloc(sizeof(Pair) * n);
+    if (!tmp) return 0;
+
+    int minrun = tim_minrun(n);
+    int min_gallop = TIM_MIN_GALLOP;
+    for (int lo = 0; lo < n; ) {
+        int end = pair_run_end(a, lo, n, key, 1);
+        if (end - lo < minrun) {
+            int force = (n - lo < minrun) ? n : lo + minrun;
+            binary_insertion_sort_pairs(a, lo, end, force, key);
+            end = force;
+        }
+
+        // Merge while the boundary below the top run is deeper than the new one
+        if (top > 0) {
+            int power = powersort_power(runs[top - 1].start, runs[top - 1].len, end - lo, n);
+            while (top > 1 && runs[top - 2].power > power) {
+                tim_merge_pairs(a, runs[top - 2].start, runs[top - 1].start,
+                    runs[top - 1].start + runs[top - 1].len, tmp, &min_gallop, key);
+                runs[top - 2].len += runs[top - 1].len;
+                top--;
+            }
+            runs[top - 1].power = power;
+        }
+        runs[top].start = lo;
+        runs[top].len = end - lo;
+        runs[top].power = 0;
+        top++;
+        lo = end;
+    }
+    while (top > 1) {
+        tim_merge_pairs(a, runs[top - 2].start, runs[top - 1].start,
+            runs[top - 1].start + runs[top - 1].len, tmp, &min_gallop, key);
+        runs[top - 2].len += runs[top - 1].len;
+        top--;
+    }
+    free(tmp);
+    return 1;
+}
+
+// Stable counting sort on the frequency key, then (with the tiebreak on)
+// each block of equal counts is ordered alphabetically. Returns 0 if out
+// of memory, leaving a[] as it was.
+static int counting_sort_pairs(Pair a[], int n, int lo_count, int hi_count, SortKey key) {
+    int range = hi_count - lo_count + 1;
+    int* start = (int*)stage_calloc((size_t)range + 1, sizeof(int));
+    Pair* tmp = (Pair*)stage_malloc(sizeof(Pair) * n);
+    if (!start || !tmp) {
+        free(start); free(tmp);
+        return 0;
+    }
+
+    // Bucket b holds count hi_count - b, so buckets run in descending order
+    for (int i = 0; i < n; ++i) start[hi_count - a[i].count + 1]++;
+    for (int b = 1; b <= range; ++b) start[b] += start[b - 1];
+    for (int i = 0; i < n; ++i) tmp[start[hi_count - a[i].count]++] = a[i];
+    memcpy(a, tmp, sizeof(Pair) * n);
+    g_stats.moves += 2LL * n;
+    free(start); free(tmp);
+
+    if (g_use_secondary_tiebreak) {
+        for (int i = 0; i < n; ) {
+            int j = i + 1;
+            while (j < n && a[j].count == a[i].count) j++;
+            if (j - i > 1) introsort_all_pairs(a, i, j - 1, key);
+            i = j;
+        }
+    }
+    return 1;
+}
+
+// Pick and run a strategy for ALG_AUTO.
+static SortStrategy auto_sort_pairs(Pair a[], int n, SortKey key) {
+    if (n <= AUTO_INSERTION_MAX) {
+        insertion_sort_pairs(a, 0, n - 1, key);
+        return STRATEGY_INSERTION;
+    }
+
+    // Few runs: already (nearly) sorted one way or the other
+    int runs = count_pair_runs(a, n, key);
+    if (runs <= 1 + n / AUTO_RUN_RATIO && tim_sort_pairs(a, n, key)) {
+        return STRATEGY_TIM;
+    }
+
+    // Frequencies are small integers: bucket them when the range is modest
+    if (key == KEY_FREQ_DESC) {
+        int lo = a[0].count, hi = a[0].count;
+        for (int i = 1; i < n; ++i) {
+            if (a[i].count < lo) lo = a[i].count;
+            if (a[i].count > hi) hi = a[i].count;
+        }
+        if ((long long)hi - lo <= (long long)n * AUTO_COUNTING_RANGE_RATIO &&
+            counting_sort_pairs(a, n, lo, hi, key)) {
+            return STRATEGY_COUNTING;
+        }
+    }
+
+    introsort_all_pairs(a, 0, n - 1, key);
+    return STRATEGY_INTROSORT;
+}
+
+// Display name of a sort; ALG_AUTO includes the strategy of the last sort.
+static const char* sort_alg_label(SortAlg alg) {
+    static char label[32];
+    if (alg != ALG_AUTO) return g_sort_alg_names[alg];
+    snprintf(label, sizeof(label), "Auto: %s", g_sort_strategy_names[g_stats.strategy]);
+    return label;
+}
+
+// Dispatch to the selected sorting algorithm and measure elapsed time.
+static void sort_pairs(Pair a[], int n, SortKey key, SortAlg alg) {
+    g_stats.strategy = (alg == ALG_AUTO) ? STRATEGY_INSERTION : (SortStrategy)alg;
+    if (n <= 1) return;
+    double stage_t0 = stage_begin(STAGE_SORT);
+    double t0 = now_ms();
+    switch (alg) {
+    case ALG_BUBBLE: bubble_sort_pairs(a, n, key); break;
+    case ALG_QUICK:  quick_sort_pairs(a, 0, n - 1, key); break;
+    case ALG_MERGE:  merge_sort_pairs(a, 0, n - 1, key); break;
+    case ALG_TIM:
+        if (!tim_sort_pairs(a, n, key)) {
+            g_stats.strategy = STRATEGY_MERGE;
+            merge_sort_pairs(a, 0, n - 1, key);
+        }
+        break;
+    case ALG_AUTO:   g_stats.strategy = auto_sort_pairs(a, n, key); break;
+    default:         quick_sort_pairs(a, 0, n - 1, key); break;
+    }
+    g_stats.ms += (now_ms() - t0);
+    stage_end(STAGE_SORT, stage_t0, 0, n);
+}
+
+// Stage 4 unique words; rebuilt by every report from the selected tokens
+static struct VocabTable g_stage4_vocab;
+
+// Count the selected tokens into g_stage4_vocab (timed as pair building).
+static int stage4_count_tokens(const uint32_t* words, int wordCount, int maxRows) {
+    double t0 = stage_begin(STAGE_PAIRS);
+    int rows = vocab_count_tokens(&g_stage4_vocab, words, wordCount, maxRows);
+    stage_end(STAGE_PAIRS, t0, 0, wordCount);
+    return rows;
+}
+
+// Pair buffer for a Stage 4 action. Menu actions allocate it before pair
+// building starts, so it is counted against that stage explicitly.
+static Pair* alloc_pairs(int n) {
+    Pair* p = (Pair*)malloc(sizeof(Pair) * n);
+    if (p) stage_count_alloc_in(STAGE_PAIRS, sizeof(Pair) * n);
+    return p;
+}
+
+// Build an array of unique word–count pairs from a flat token-ID list.
+static int build_pairs_from_tokens(const uint32_t* words, int wordCount, Pair out[], int maxOut) {
+    const struct VocabTable* v = &g_stage4_vocab;
+    int ucnt = stage4_count_tokens(words, wordCount, maxOut);
+    for (int r = 0; r < ucnt; ++r) {
+        out[r].id = v->ids[r];
+        out[r].count = v->counts[r];
+    }
+    return ucnt;
+}
+
+// ----- Re-sort hint (order of the last sort) -----
+// Menu actions rebuild the pairs in first-occurrence order and sort them
+// again. Starting from the previous result instead leaves the adaptive
+// sorts (Tim, Auto) with one long run plus whatever changed since.
+struct SortHint {
+    uint32_t* ids;            // Token IDs in the order of the last sort
+    int n;
+    int cap;
+};
+static struct SortHint g_sort_hint[2];  // All words, indexed by SortKey
+static struct SortHint g_toxic_hint;    // Toxic words by frequency
+static struct IdSlotMap g_hint_slots;   // Token ID -> index in the pairs being sorted
+
+// Reordering only pays off for adaptive sorts, and is only safe when the
+// order is total: stable sorts must keep tied words in first-occurrence order.
+static int sort_hint_usable(SortKey key, SortAlg alg) {
+    if (alg != ALG_TIM && alg != ALG_AUTO) return 0;
+    return key == KEY_ALPHA || g_use_secondary_tiebreak;
+}
+
+// Move the pairs into the last sorted order; pairs not in it follow in
+// their current order.
+static void apply_sort_hint(Pair a[], int n, const struct SortHint* h) {
+    if (h->n == 0 || n < 2) return;
+    Pair* tmp = (Pair*)stage_malloc(sizeof(Pair) * n);
+    unsigned char* placed = (unsigned char*)stage_calloc(n, 1);
+    if (!tmp || !placed) {
+        free(tmp); free(placed);
+        return;
+    }
+    for (int i = 0; i < n; ++i) {
+        int* slot = id_slot_ref(&g_hint_slots, a[i].id);
+        if (!slot) {
+            free(tmp); free(placed);
+            return;
+        }
+        *slot = i;
+    }
+
+    int k = 0;
+    for (int j = 0; j < h->n; ++j) {
+        uint32_t id = h->ids[j];
+        if (id >= g_hint_slots.cap) continue;
+        int i = g_hint_slots.slot[id];
+        if (i >= 0 && i < n && a[i].id == id && !placed[i]) {
+            tmp[k++] = a[i];
+            placed[i] = 1;
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        if (!placed[i]) tmp[k++] = a[i];
+    }
+    memcpy(a, tmp, sizeof(Pair) * n);
+    free(tmp); free(placed);
+}
+
+static void save_sort_hint(const Pair a[], int n, struct SortHint* h) {
+    if (n > h->cap) {
+        uint32_t* grown = (uint32_t*)stage_realloc(h->ids, sizeof(uint32_t) * n);
+        if (!grown) {
+            h->n = 0;
+            return;
+        }
+        h->ids = grown;
+        h->cap = n;
+    }
+    for (int i = 0; i < n; ++i) h->ids[i] = a[i].id;
+    h->n = n;
+}
+
+static void sort_hints_free(void) {
+    for (int k = 0; k < 2; ++k) free(g_sort_hint[k].ids);
+    free(g_toxic_hint.ids);
+    free(g_hint_slots.slot);
+    memset(g_sort_hint, 0, sizeof(g_sort_hint));
+    memset(&g_toxic_hint, 0, sizeof(g_toxic_hint));
+    memset(&g_hint_slots, 0, sizeof(g_hint_slots));
+}
+
+// sort_pairs() for menu actions that re-sort the same vocabulary.
+static void sort_pairs_hinted(Pair a[], int n, SortKey key, SortAlg alg, struct SortHint* h) {
+    int usable = sort_hint_usable(key, alg);
+    if (usable) apply_sort_hint(a, n, h);
+    sort_pairs(a, n, key, alg);
+    if (usable) save_sort_hint(a, n, h);
+}
+
+// ----- Approximate frequency mode (Count-Min sketch + Space-Saving) -----
+
+static int cms_init(struct CountMinSketch* c) {
+    c->cells = (uint32_t*)stage_calloc((size_t)CMS_DEPTH * CMS_WIDTH, sizeof(uint32_t));
+    c->total = 0;
+    return c->cells != NULL;
+}
+
+// Column step for the row hashes (h + row * step); odd so rows differ
+static inline unsigned int cms_step(unsigned int hash) {
+    return ((hash * 0x9E3779B1u) ^ (hash >> 15)) | 1u;
+}
+
+static void cms_add(struct CountMinSketch* c, unsigned int hash) {
+    unsigned int step = cms_step(hash);
+    for (int d = 0; d < CMS_DEPTH; d++) {
+        uint32_t* cell = &c->cells[d * CMS_WIDTH + ((hash + d * step) & (CMS_WIDTH - 1))];
+        if (*cell != UINT32_MAX) (*cell)++;
+    }
+    c->total++;
+}
+
+static long long cms_estimate(const struct CountMinSketch* c, unsigned int hash) {
+    unsigned int step = cms_step(hash);
+    uint32_t best = UINT32_MAX;
+    for (int d = 0; d < CMS_DEPTH; d++) {
+        uint32_t v = c->cells[d * CMS_WIDTH + ((hash + d * step) & (CMS_WIDTH - 1))];
+        if (v < best) best = v;
+    }
+    return best;
+}
+
+// Largest overcount of any estimate, holding with probability 1 - e^-depth
+static long long cms_error_bound(const struct CountMinSketch* c) {
+    return (long long)ceil(exp(1.0) * (double)c->total / CMS_WIDTH);
+}
+
+static int ss_init(struct SpaceSaving* s, int capacity) {
+    memset(s, 0, sizeof(*s));
+    s->capacity = capacity;
+    s->index_size = 1;
+    while (s->index_size < capacity * 2) s->index_size *= 2;
+    s->items = (struct HeavyHitter*)stage_calloc(capacity, sizeof(struct HeavyHitter));
+    s->heap = (int*)stage_malloc(sizeof(int) * capacity);
+    s->heap_pos = (int*)stage_malloc(sizeof(int) * capacity);
+    s->index = (int*)stage_malloc(sizeof(int) * s->index_size);
+    if (!s->items || !s->heap || !s->heap_pos || !s->index) return 0;
+    memset(s->index, 0xff, sizeof(int) * s->index_size);
+    return 1;
+}
+
+static void ss_free(struct SpaceSaving* s) {
+    free(s->items);
+    free(s->heap);
+    free(s->heap_pos);
+    free(s->index);
+    memset(s, 0, sizeof(*s));
+}
+
+static int ss_find(const struct SpaceSaving* s, const char* word, unsigned int hash) {
+    unsigned int mask = (unsigned int)s->index_size - 1;
+    for (unsigned int slot = hash & mask; s->index[slot] != -1; slot = (slot + 1) & mask) {
+        const struct HeavyHitter* h = &s->items[s->index[slot]];
+        if (h->hash == hash && strcmp(h->word, word) == 0) return s->index[slot];
+    }
+    return -1;
+}
+
+static void ss_index_insert(struct SpaceSaving* s, int item) {
+    unsigned int mask = (unsigned int)s->index_size - 1;
+    unsigned int slot = s->items[item].hash & mask;
+    while (s->index[slot] != -1) slot = (slot + 1) & mask;
+    s->index[slot] = item;
+}
+
+// Same backward-shift deletion as index_remove(), keyed by the stored hash
+static void ss_index_remove(struct SpaceSaving* s, int item) {
+    unsigned int mask = (unsigned int)s->index_size - 1;
+    unsigned int hole = s->items[item].hash & mask;
+    while (s->index[hole] != item) {
+        if (s->index[hole] == -1) return;
+        hole = (hole + 1) & mask;
+    }
+    s->index[hole] = -1;
+
+    for (unsigned int j = (hole + 1) & mask; s->index[j] != -1; j = (j + 1) & mask) {
+        unsigned int home = s->items[s->index[j]].hash & mask;
+        bool stays = (hole <= j) ? (home > hole && home <= j) : (home > hole || home <= j);
+        if (!stays) {
+            s->index[hole] = s->index[j];
+            s->index[j] = -1;
+            hole = j;
+        }
+    }
+}
+
+static void ss_heap_swap(struct SpaceSaving* s, int a, int b) {
+    int t = s->heap[a];
+    s->heap[a] = s->heap[b];
+    s->heap[b] = t;
+    s->heap_pos[s->heap[a]] = a;
+    s->heap_pos[s->heap[b]] = b;
+}
+
+static void ss_sift_up(struct SpaceSaving* s, int pos) {
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (s->items[s->heap[parent]].count <= s->items[s->heap[pos]].count) break;
+        ss_heap_swap(s, parent, pos);
+        pos = parent;
+    }
+}
+
+static void ss_sift_down(struct SpaceSaving* s, int pos) {
+    for (;;) {
+        int l = 2 * pos + 1, r = l + 1, m = pos;
+        if (l < s->size && s->items[s->heap[l]].count < s->items[s->heap[m]].count) m = l;
+        if (r < s->size && s->items[s->heap[r]].count < s->items[s->heap[m]].count) m = r;
+        if (m == pos) return;
+        ss_heap_swap(s, pos, m);
+        pos = m;
+    }
+}
+
+static void ss_add(struct SpaceSaving* s, const char* word, unsigned int hash) {
+    s->total++;
+    int item = ss_find(s, word, hash);
+    if (item >= 0) {
+        s->items[item].count++;
+        ss_sift_down(s, s->heap_pos[item]);
+        return;
+    }
+
+    long long floor_count = 0;
+    if (s->size < s->capacity) {
+        item = s->size++;
+        s->heap[item] = item;
+        s->heap_pos[item] = item;
+    }
+    else {
+        // Evict the minimum; the newcomer inherits its count as error
+        item = s->heap[0];
+        floor_count = s->items[item].count;
+        ss_index_remove(s, item);
+    }
+
+    struct HeavyHitter* h = &s->items[item];
+    strncpy(h->word, word, MAX_WORD_LENGTH - 1);
+    h->word[MAX_WORD_LENGTH - 1] = '\0';
+    h->hash = hash;
+    h->count = floor_count + 1;
+    h->error = floor_count;
+    ss_index_insert(s, item);
+    ss_sift_up(s, s->heap_pos[item]);
+    ss_sift_down(s, s->heap_pos[item]);
+}
+
+static int approx_init(struct ApproxCounter* a) {
+    int ok = cms_init(&a->sketch);
+    ok = ss_init(&a->all, APPROX_TOP_CAPACITY) && ok;
+    ok = ss_init(&a->toxic, APPROX_TOP_CAPACITY) && ok;
+    return ok;
+}
+
+static void approx_free(struct ApproxCounter* a) {
+    free(a->sketch.cells);
+    a->sketch.cells = NULL;
+    ss_free(&a->all);
+    ss_free(&a->toxic);
+}
+
+static void approx_reset(struct ApproxCounter* a) {
+    memset(a->sketch.cells, 0, sizeof(uint32_t) * CMS_DEPTH * CMS_WIDTH);
+    a->sketch.total = 0;
+    struct SpaceSaving* summaries[2] = { &a->all, &a->toxic };
+    for (int i = 0; i < 2; i++) {
+        summaries[i]->size = 0;
+        summaries[i]->total = 0;
+        memset(summaries[i]->index, 0xff, sizeof(int) * summaries[i]->index_size);
+    }
+}
+
+static void approx_add(struct ApproxCounter* a, const char* word, unsigned int hash, int toxic) {
+    cms_add(&a->sketch, hash);
+    ss_add(&a->all, word, hash);
+    if (toxic) ss_add(&a->toxic, word, hash);
+}
+
+// Count desc, then A-Z
+static int cmp_heavy_hitters(const void* x, const void* y) {
+    const struct HeavyHitter* a = (const struct HeavyHitter*)x;
+    const struct HeavyHitter* b = (const struct HeavyHitter*)y;
+    if (a->count != b->count) return (b->count > a->count) ? 1 : -1;
+    return strcmp(a->word, b->word);
+}
+
+static int cmp_heavy_hitters_alpha(const void* x, const void* y) {
+    return strcmp(((const struct HeavyHitter*)x)->word, ((const struct HeavyHitter*)y)->word);
+}
+
+// Candidates of s ranked by count (largest first), at most k of them.
+// Returns a malloc'd array the caller frees, or NULL.
+static struct HeavyHitter* ss_ranked(const struct SpaceSaving* s, int k, int* out_n) {
+    *out_n = 0;
+    if (s->size == 0) return NULL;
+    struct HeavyHitter* ranked = (struct HeavyHitter*)stage_malloc(sizeof(struct HeavyHitter) * s->size);
+    if (!ranked) return NULL;
+    memcpy(ranked, s->items, sizeof(struct HeavyHitter) * s->size);
+    qsort(ranked, s->size, sizeof(struct HeavyHitter), cmp_heavy_hitters);
+    *out_n = (k < s->size) ? k : s->size;
+    return ranked;
+}
+
+// Approximate counters for the Stage 4 reports
+static struct ApproxCounter g_approx;
+
+static int approx_count_tokens(const uint32_t* words, int wordCount) {
+    if (!g_approx.sketch.cells && !approx_init(&g_approx)) {
+        printf("Error: Memory allocation failed (sketch)\n");
+        approx_free(&g_approx);
+        return 0;
+    }
+    approx_reset(&g_approx);
+
+    struct ToxicDictionary* dict = toxic_dict_acquire();
+    for (int i = 0; i < wordCount; i++) {
+        uint32_t id = words[i];
+        approx_add(&g_approx, token_text(id), g_intern_hash[id], token_is_toxic(id));
+    }
+    toxic_dict_release(dict);
+    return 1;
+}
+
+// Print the top candidates of one summary with their error bounds.
+static void show_topN_approx(const struct SpaceSaving* s, SortKey key, int topN, const char* title) {
+    const char* kind = (s == &g_approx.toxic) ? "toxic word" : "word";
+    int n;
+    struct HeavyHitter* ranked = ss_ranked(s, topN, &n);
+    if (n == 0) { printf("[i] No %ss found.\n", kind); free(ranked); return; }
+    if (key == KEY_ALPHA) qsort(ranked, n, sizeof(struct HeavyHitter), cmp_heavy_hitters_alpha);
+
+    printf("\n-- %sTop %d (approximate, %s) --\n", title, n,
+        key == KEY_FREQ_DESC ? "freq desc" : "A->Z");
+    for (int i = 0; i < n; ++i) {
+        long long est = cms_estimate(&g_approx.sketch, ranked[i].hash);
+        printf("%2d. %-20s ~%lld  [%lld..%lld]  sketch %lld\n", i + 1, ranked[i].word,
+            ranked[i].count, ranked[i].count - ranked[i].error, ranked[i].count, est);
+    }
+    printf("Bounds: true count lies in [low..high]; sketch overcounts by <= %lld (%.1f%% confidence).\n",
+        cms_error_bound(&g_approx.sketch), 100.0 * (1.0 - exp(-(double)CMS_DEPTH)));
+    printf("Every %s seen more than %lld times is listed (%d candidates kept).\n",
+        kind, s->total / s->capacity, s->capacity);
+    free(ranked);
+}
+
+
+
+// ===== 5. Stage4 - Reporting: Top N, Toxic, Comparison, Summary, Alphabetical List ======
+
+// Show Top N words (all tokens) using the chosen key and algorithm.
+void sort_and_show_topN_all(SortKey key, SortAlg alg, int topN) {
+    if (!file1Loaded && !file2Loaded) { printf("[!] No text loaded.\n"); return; }
+
+    const uint32_t* w; int wc; pick_tokens(&w, &wc);
+    if (!w || wc == 0) { printf("[!] No text loaded.\n"); return; }
+
+    if (g_use_approx) {
+        if (approx_count_tokens(w, wc)) show_topN_approx(&g_approx.all, key, topN, "");
+        return;
+    }
+
+    Pair* arr = alloc_pairs(6000);
+    if (!arr) { printf("[!] OOM\n"); return; }
+    int n = build_pairs_from_tokens(w, wc, arr, 6000);
+
+    sort_pairs_hinted(arr, n, key, alg, &g_sort_hint[key]);
+
+    if (topN > n) topN = n;
+    printf("\n-- Top %d (%s, %s) --\n",
+        topN,
+        key == KEY_FREQ_DESC ? "freq desc" : "A->Z",
+        sort_alg_label(alg));
+    for (int i = 0; i < topN; ++i) {
+        printf("%2d. %-20s %d\n", i + 1, token_text(arr[i].id), arr[i].count);
+    }
+    free(arr);
+}
+
+// Show Top N toxic words only, sorted by frequency using the chosen algorithm.
+void sort_and_show_topN_toxic(SortAlg alg, int topN) {
+    if (!file1Loaded && !file2Loaded) { printf("[!] No text loaded.\n"); return; }
+
+    const uint32_t* w; int wc; pick_tokens(&w, &wc);
+    if (!w || wc == 0) { printf("[!] No text loaded.\n"); return; }
+
+    if (g_use_approx) {
+        if (approx_count_tokens(w, wc)) show_topN_approx(&g_approx.toxic, KEY_FREQ_DESC, topN, "Toxic ");
+        return;
+    }
+
+    // First build the full frequency table.
+    Pair* tox = alloc_pairs(6000);
+    if (!tox) { printf("[!] OOM\n"); return; }
+
+    struct VocabTable* v = &g_stage4_vocab;
+    int nAll = stage4_count_tokens(w, wc, 6000);
+
+    // Extract only the toxic words.
+    struct ToxicDictionary* dict = toxic_dict_acquire();
+    vocab_mark_toxicity(v);
+    toxic_dict_release(dict);
+    int nT = 0;
+    for (int r = 0; r < nAll; ++r) {
+        if (v->toxic[r]) {
+            tox[nT].id = v->ids[r];
+            tox[nT].count = v->counts[r];
+            nT++;
+        }
+    }
+
+    if (nT == 0) { printf("[i] No toxic words found.\n"); free(tox); return; }
+
+    // Toxic words are typically sorted by descending frequency.
+    sort_pairs_hinted(tox, nT, KEY_FREQ_DESC, alg, &g_toxic_hint);
+    if (topN > nT) topN = nT;
+
+    printf("\n-- Toxic Top %d (freq desc, %s) --\n",
+        topN, sort_alg_label(alg));
+    for (int i = 0; i < topN; ++i) {
+        printf("%2d. %-20s %d\n", i + 1, token_text(tox[i].id), tox[i].count);
+    }
+
+    free(tox);
+}
+
+// Compare Bubble, Quick, and Merge sort outputs and performance on Top N results.
+void compare_algorithms_topN(int topN) {
+    if (!file1Loaded && !file2Loaded) {
+        printf("[!] No text loaded.\n");
+        return;
+    }
+    const uint32_t* w; int wc;
+    pick_tokens(&w, &wc);
+    if (!w || wc == 0) {
+        printf("[!] No text loaded.\n");
+        return;
+    }
+
+    Pair* base = alloc_pairs(6000);
+    Pair* a = alloc_pairs(6000);  // Bubble
+    Pair* b = alloc_pairs(6000);  // Quick
+    Pair* c = alloc_pairs(6000);  // Merge
+    Pair* d = alloc_pairs(6000);  // Auto
+    Pair* t = alloc_pairs(6000);  // Tim
+    if (!base || !a || !b || !c || !d || !t) {
+        printf("[!] OOM\n");
+        free(base); free(a); free(b); free(c); free(d); free(t);
+        return;
+    }
+
+    int n = build_pairs_from_tokens(w, wc, base, 6000);
+    memcpy(a, base, sizeof(Pair) * n);
+    memcpy(b, base, sizeof(Pair) * n);
+    memcpy(c, base, sizeof(Pair) * n);
+    memcpy(d, base, sizeof(Pair) * n);
+    memcpy(t, base, sizeof(Pair) * n);
+
+    SortKey key = g_key;
+
+    // Measure statistics for each algorithm independently.
+    SortStats sB, sQ, sM, sA, sT;
+
+    stats_reset(); sort_pairs(a, n, key, ALG_BUBBLE); sB = g_stats;
+    stats_reset(); sort_pairs(b, n, key, ALG_QUICK);  sQ = g_stats;
+    stats_reset(); sort_pairs(c, n, key, ALG_MERGE);  sM = g_stats;
+    stats_reset(); sort_pairs(d, n, key, ALG_AUTO);   sA = g_stats;
+    stats_reset(); sort_pairs(t, n, key, ALG_TIM);    sT = g_stats;
+
+    if (topN > n) topN = n;
+
+    printf("\n== Algorithm Comparison (key=%s, tiebreak=%s) ==\n",
+        key == KEY_FREQ_DESC ? "freq desc" : "A→Z",
+        g_use_secondary_tiebreak ? "ON" : "OFF");
+
+    // Print three columns side by side: Bubble / Quick / Merge.
+    printf("\n%-4s | %-20s %6s | %-20s %6s | %-20s %6s\n",
+        "Rank",
+        "Bubble", "count",
+        "Quick", "count",
+        "Merge", "count");
+    printf("------+---------------------------+---------------------------+---------------------------\n");
+
+    for (int i = 0; i < topN; i++) {
+        printf("%-4d | %-20s %6d | %-20s %6d | %-20s %6d\n",
+            i + 1,
+            token_text(a[i].id), a[i].count,
+            token_text(b[i].id), b[i].count,
+            token_text(c[i].id), c[i].count);
+    }
+
+    // Stability check: compare whether the first `cap` entries are identical across algorithms.
+    int agree = 1, cap = topN < 30 ? topN : 30;
+    for (int i = 0; i < cap; i++) {
+        if (a[i].id != b[i].id || a[i].id != c[i].id || a[i].id != d[i].id ||
+            a[i].id != t[i].id) {
+            agree = 0;
+            break;
+        }
+    }
+
+    printf("\n[Stability] Top %d %s across algorithms.\n",
+        cap, agree ? "ARE IDENTICAL" : "DIFFER");
+
+    //  Performance comparison table (keeps the original formatting).
+    printf("\n%-8s | %10s | %12s | %12s\n",
+        "Alg", "Time(ms)", "Comparisons", "Moves");
+    printf("----------+------------+--------------+--------------\n");
+    printf("%-8s | %10.3f | %12lld | %12lld\n",
+        "Bubble", sB.ms, sB.comps, sB.moves);
+    printf("%-8s | %10.3f | %12lld | %12lld\n",
+        "Quick", sQ.ms, sQ.comps, sQ.moves);
+    printf("%-8s | %10.3f | %12lld | %12lld\n",
+        "Merge", sM.ms, sM.comps, sM.moves);
+    printf("%-8s | %10.3f | %12lld | %12lld\n",
+        "Tim", sT.ms, sT.comps, sT.moves);
+    printf("%-8s | %10.3f | %12lld | %12lld   (%s)\n",
+        "Auto", sA.ms, sA.comps, sA.moves, g_sort_strategy_names[sA.strategy]);
+
+    free(base); free(a); free(b); free(c); free(d); free(t);
+}
+
+// Print extra summary statistics such as toxic vs non-toxic ratios.
+void show_extra_summary(void) {
+    if (!file1Loaded && !file2Loaded) { printf("[!] No text loaded.\n"); return; }
+
+    const uint32_t* w; int wc; pick_tokens(&w, &wc);
+    if (!w || wc == 0) { printf("[!] No text loaded.\n"); return; }
+
+    struct VocabTable* v = &g_stage4_vocab;
+    int n = stage4_count_tokens(w, wc, 6000);
+
+    struct ToxicDictionary* dict = toxic_dict_acquire();
+    vocab_mark_toxicity(v);
+    toxic_dict_release(dict);
+
+    // Branch-free sums over the count and flag columns
+    int toxic_tokens = 0, total = 0, toxic_types = 0;
+    for (int r = 0; r < n; r++) {
+        int t = v->toxic[r];
+        toxic_tokens += v->counts[r] & -t;
+        total += v->counts[r];
+        toxic_types += t;
+    }
+    int nontoxic_tokens = total - toxic_tokens;
+    double tox_ratio = total ? (100.0 * toxic_tokens / total) : 0.0;
+
+    // Also compute ratios at the "type" level (unique words).
+    int nontoxic_types = n - toxic_types;
+
+    printf("\n=== Extra Summary ===\n");
+    printf("Tokens  : toxic=%d, non-toxic=%d, total=%d, toxic ratio=%.2f%%\n",
+        toxic_tokens, nontoxic_tokens, total, tox_ratio);
+    printf("Types   : toxic=%d, non-toxic=%d, total=%d\n",
+        toxic_types, nontoxic_types, toxic_types + nontoxic_types);
+}
+
+// ----- Lazy alphabetical view -----
+// Incremental quicksort: a position is "settled" once it holds its final
+// item (a pivot, or part of a small segment that was insertion sorted).
+// Settling a position only partitions the unsettled segment around it, so a
+// page costs O(n) the first time and little more once its neighbours are
+// settled; words nobody looks at are never ordered.
+struct LazyAlphaView {
+    Pair* a;
+    unsigned char* settled;
+    int n;
+};
+
+// Make a[i] hold the i-th word in A-Z order.
+static void lazy_view_settle(struct LazyAlphaView* v, int i) {
+    if (v->settled[i]) return;
+    int l = i, r = i;
+    while (l > 0 && !v->settled[l - 1]) l--;
+    while (r < v->n - 1 && !v->settled[r + 1]) r++;
+
+    while (!v->settled[i]) {
+        if (r - l < AUTO_INSERTION_MAX) {
+            insertion_sort_pairs(v->a, l, r, KEY_ALPHA);
+            memset(v->settled + l, 1, r - l + 1);
+            break;
+        }
+        // Middle pivot: the pairs may arrive already ordered (A-Z re-sorts)
+        swap_pair(&v->a[l + (r - l) / 2], &v->a[r]);
+        int p = partition_pairs(v->a, l, r, KEY_ALPHA);
+        v->settled[p] = 1;
+        if (i < p) r = p - 1;
+        else l = p + 1;
+    }
+}
+
+static void lazy_view_settle_range(struct LazyAlphaView* v, int lo, int hi) {
+    double t0 = stage_begin(STAGE_SORT);
+    double cpu_t0 = now_ms();
+    for (int i = lo; i < hi; ++i) lazy_view_settle(v, i);
+    g_stats.ms += now_ms() - cpu_t0;
+    stage_end(STAGE_SORT, t0, 0, hi - lo);
+}
+
+// Index of the first word >= prefix: binary search that settles only the
+// probed positions. O(log n) comparisons once those are settled.
+static int lazy_view_lower_bound(struct LazyAlphaView* v, const char* prefix) {
+    double t0 = stage_begin(STAGE_SORT);
+    double cpu_t0 = now_ms();
+    int lo = 0, hi = v->n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        lazy_view_settle(v, mid);
+        g_stats.comps++;
+        if (strcmp(token_text(v->a[mid].id), prefix) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    g_stats.ms += now_ms() - cpu_t0;
+    stage_end(STAGE_SORT, t0, 0, 0);
+    return lo;
+}
+
+// List all unique words alphabetically with pagination. Only the pages
+// shown are sorted; "/prefix" jumps to the first word with that prefix.
+void list_alpha_all(void) {
+    if (!file1Loaded && !file2Loaded) {
+        printf("[!] No text loaded.\n");
+        return;
+    }
+
+    const uint32_t* w;
+    int wc;
+    pick_tokens(&w, &wc);
+    if (!w || wc == 0) {
+        printf("[!] No text loaded.\n");
+        return;
+    }
+
+    Pair* arr = alloc_pairs(6000);
+    unsigned char* settled = (unsigned char*)stage_calloc(6000, 1);
+    if (!arr || !settled) {
+        printf("[!] OOM\n");
+        free(arr); free(settled);
+        return;
+    }
+
+    int n = build_pairs_from_tokens(w, wc, arr, 6000);
+    struct LazyAlphaView view = { arr, settled, n };
+
+    // The listing always sorts lazily; its work replaces the last sort stats
+    stats_reset();
+    g_stats.strategy = STRATEGY_LAZY;
+
+    const int perPage = 50;
+    int start = 0;
+    char cmd[64];
+
+    for (;;) {
+        if (start >= n) {
+            printf("[i] No more words.\n");
+            break;
+        }
+        int end = start + perPage;
+        if (end > n) end = n;
+        lazy_view_settle_range(&view, start, end);
+
+        printf("\n-- Alphabetical listing (words %d-%d of %d) --\n",
+            start + 1, end, n);
+        for (int i = start; i < end; ++i) {
+            printf("%-20s %d\n", token_text(arr[i].id), arr[i].count);
+        }
+
+        // Prompt the user for navigation commands.
+        if (start == 0 && end == n) {
+            printf("[/]prefix, [Q]uit : ");
+        }
+        else if (start == 0) {
+            printf("[N]ext, [/]prefix, [Q]uit : ");
+        }
+        else if (end == n) {
+            printf("[P]rev, [/]prefix, [Q]uit : ");
+        }
+        else {
+            printf("[P]rev, [N]ext, [/]prefix, [Q]uit : ");
+        }
+
+        if (!read_line(cmd, sizeof(cmd))) {
+            break;
+        }
+        // Empty input: do nothing and re-prompt.
+        if (cmd[0] == '\0') {
+            continue;
+        }
+
+        // Strictly parse: a single character n / p / q (case-insensitive), or /prefix.
+        if (strcmp(cmd, "n") == 0 || strcmp(cmd, "N") == 0) {
+            if (end >= n) {
+                printf("[i] Already at last page.\n");
+            }
+            else {
+                start = end;
+            }
+        }
+        else if (strcmp(cmd, "p") == 0 || strcmp(cmd, "P") == 0) {
+            if (start == 0) {
+                printf("[i] Already at first page.\n");
+            }
+            else {
+                start = (start > perPage) ? start - perPage : 0;
+            }
+        }
+        else if (strcmp(cmd, "q") == 0 || strcmp(cmd, "Q") == 0 || strcmp(cmd, "0") == 0) {
+            break;
+        }
+        else if (cmd[0] == '/' && cmd[1] != '\0') {
+            // Words are stored lowercase
+            char* prefix = cmd + 1;
+            tolower_inplace(prefix);
+            int at = lazy_view_lower_bound(&view, prefix);
+            if (at < n && strncmp(token_text(arr[at].id), prefix, strlen(prefix)) == 0) {
+                start = at;
+            }
+            else {
+                printf("[i] No word starts with '%s'.\n", prefix);
+            }
+        }
+        else {
+            // Inputs like "npq", "nn", or "x" will fall into this branch.
+            printf("[i] Unknown command. Please use n / p / q or /prefix.\n");
+        }
+    }
+    free(arr);
+    free(settled);
+}
+
+
+
+// ===== 6. Stage 4/5 - Saving Reports (TXT + optional CSV)
+
+// Write a full analysis report for the given token list into the provided FILE*.
+static void write_full_report(FILE* f,
+    const char* sourcePath,
+    const uint32_t* words,
+    int wordCount)
+{
+    double stage_t0 = stage_begin(STAGE_REPORT);
+    long start_offset = ftell(f);
+
+    // Pin the toxic word dictionary (for basic toxicity analysis in this report).
+    struct ToxicDictionary* dict = toxic_dict_acquire();
+
+    // ===== 1. Compute unique words and their frequencies (basic statistics) =====
+    uint32_t uniq[1000];
+    int  freq[5000];
+    int  ucnt = 0;
+
+    struct VocabTable* v = &g_stage4_vocab;
+    v->size = 0;
+    for (int i = 0; i < wordCount && v->size < 1000; i++) {
+        if (vocab_add(v, words[i], 1, 1000) < 0) break;
+    }
+    ucnt = v->size;
+    if (ucnt > 0) {
+        memcpy(uniq, v->ids, sizeof(uint32_t) * ucnt);
+        memcpy(freq, v->counts, sizeof(int) * ucnt);
+    }
+
+    // Sort unique words by frequency (descending) and then alphabetically (A–Z).
+    for (int i = 0; i < ucnt - 1; i++) {
+        for (int j = 0; j < ucnt - i - 1; j++) {
+            if (freq[j] < freq[j + 1] ||
+                (freq[j] == freq[j + 1] && strcmp(token_text(uniq[j]), token_text(uniq[j + 1])) > 0)) {
+
+                int tf = freq[j];
+                freq[j] = freq[j + 1];
+                freq[j + 1] = tf;
+
+                uint32_t tmp = uniq[j];
+                uniq[j] = uniq[j + 1];
+                uniq[j + 1] = tmp;
+            }
+        }
+    }
+
+    // ===== 2. Basic toxicity analysis (based on uniq/freq + is_toxic_word) =====
+    int toxic_words_count_basic = 0;        // Unique toxic words detected by basic check.
+    int total_toxic_occurrences_basic = 0;  // Total occurrences of those toxic words.
+
+    // To keep the report readable, only keep the top 100 toxic words for printing.
+    uint32_t toxic_words_list[100];
+    int  toxic_freq[100] = { 0 };
+    int  toxic_severity[100] = { 0 };
+
+    for (int i = 0; i < ucnt; i++) {
+        if (token_is_toxic(uniq[i])) {
+            if (toxic_words_count_basic < 100) {
+                toxic_words_list[toxic_words_count_basic] = uniq[i];
+                toxic_freq[toxic_words_count_basic] = freq[i];
+                toxic_severity[toxic_words_count_basic] = token_toxic_severity(uniq[i]);
+                toxic_words_count_basic++;
+            }
+            total_toxic_occurrences_basic += freq[i];
+        }
+    }
+
+    // Sort the kept toxic words by frequency (descending).
+    for (int i = 0; i < toxic_words_count_basic - 1; i++) {
+        for (int j = 0; j < toxic_words_count_basic - i - 1; j++) {
+            if (toxic_freq[j] < toxic_freq[j + 1]) {
+                int tf = toxic_freq[j];
+                toxic_freq[j] = toxic_freq[j + 1];
+                toxic_freq[j + 1] = tf;
+
+                uint32_t tmpw = toxic_words_list[j];
+                toxic_words_list[j] = toxic_words_list[j + 1];
+                toxic_words_list[j + 1] = tmpw;
+
+                int ts = toxic_severity[j];
+                toxic_severity[j] = toxic_severity[j + 1];
+                toxic_severity[j + 1] = ts;
+            }
+        }
+    }
+
+    // ===== 3. Detect which advanced features have data in this session =====
+    // Advanced text statistics: only valid if they refer to this same source file.
+    int has_advanced_text_stats =
+        analysis_data.text_filtered &&
+        current_filename[0] != '\0' &&
+        (strcmp(current_filename, sourcePath) == 0);
+
+    // Advanced toxic statistics: check if Stage 3 counters were updated.
+    int has_advanced_toxic_stats =
+        (dict->word_count > 0 ||
+            dict->phrase_count > 0 ||
+            analysis_data.toxicity_density > 0.0f);
+
+    // Sorting performance: comparisons/moves/time > 0 means a sort was executed.
+    int has_sort_performance =
+        (g_stats.comps > 0 || g_stats.moves > 0 || g_stats.ms > 0.0);
+
+    // ===== 4. Report header and overall summary =====
+    fprintf(f, "Text Analysis Report\n");
+    fprintf(f, "====================\n\n");
+
+    // 4.1 Global overview (basic statistics always present).
+    fprintf(f, "Overall Summary\n");
+    fprintf(f, "Metric,Value\n");
+    fprintf(f, "Source file,%s\n", sourcePath);
+    fprintf(f, "File type,%s\n",
+        isCSVFile(sourcePath) ? "CSV" : "Text");
+    fprintf(f, "Analysis date,%s\n", __DATE__);
+    fprintf(f, "Total tokens (raw input),%d\n", wordCount);
+    fprintf(f, "Unique words (recomputed),%d\n", ucnt);
+    fprintf(f, "Unique toxic words (basic check),%d\n", toxic_words_count_basic);
+    fprintf(f, "Total toxic occurrences (basic check),%d\n",
+        total_toxic_occurrences_basic);
+
+    float toxicity_percentage_basic = 0.0f;
+    if (wordCount > 0) {
+        toxicity_percentage_basic =
+            (float)total_toxic_occurrences_basic / wordCount * 100.0f;
+    }
+    fprintf(f, "Toxicity percentage (basic check),%.2f%%\n",
+        toxicity_percentage_basic);
+    fprintf(f, "Toxic dictionary terms loaded,%d\n", dict->word_count);
+    fprintf(f, "\n");
+
+    // 4.2 Feature run summary – explicitly tell which analyses were run or not.
+    fprintf(f, "Feature Run Summary\n");
+    fprintf(f, "Feature,Status,Notes\n");
+    fprintf(f,
+        "Basic token statistics,GENERATED,"
+        "Always computed when saving this report\n");
+    fprintf(f,
+        "Advanced text statistics,%s,%s\n",
+        has_advanced_text_stats ? "AVAILABLE" : "NOT AVAILABLE",
+        has_advanced_text_stats
+        ? "Results taken from previous advanced analysis"
+        : "Advanced analysis menu was not used for this file");
+    fprintf(f,
+        "Advanced toxic detection,%s,%s\n",
+        has_advanced_toxic_stats ? "AVAILABLE" : "NOT AVAILABLE",
+        has_advanced_toxic_stats
+        ? "Uses dictionary-based word/phrase analysis"
+        : "Dictionary-based toxic analysis was not performed or found no data");
+    fprintf(f,
+        "Sorting & performance,%s,%s\n",
+        has_sort_performance ? "AVAILABLE" : "NOT AVAILABLE",
+        has_sort_performance
+        ? "Statistics captured from the last sorting operation"
+        : "No sorting experiment was recorded in this session");
+    fprintf(f, "\n");
+
+    // ===== 5. Basic word-frequency statistics (always available) =====
+    fprintf(f, "Basic Token Statistics\n");
+    fprintf(f, "Metric,Value\n");
+
+    int singleOccurrence = 0;
+    for (int i = 0; i < ucnt; i++) {
+        if (freq[i] == 1) singleOccurrence++;
+    }
+    float avgFrequency =
+        (ucnt > 0) ? (float)wordCount / (float)ucnt : 0.0f;
+
+    fprintf(f, "Unique word count,%d\n", ucnt);
+    fprintf(f, "Words with single occurrence,%d\n", singleOccurrence);
+    fprintf(f, "Average frequency per unique word,%.2f\n", avgFrequency);
+    fprintf(f, "\n");
+
+    // Top 20 most frequent words.
+    fprintf(f, "Top Words by Frequency (up to 20)\n");
+    fprintf(f, "Rank,Word,Frequency,%% of all tokens,Is toxic\n");
+    int totalWords = wordCount;
+    int topn = (ucnt < 20) ? ucnt : 20;
+    for (int i = 0; i < topn; i++) {
+        float percentage = (float)freq[i] / totalWords * 100.0f;
+        const char* is_toxic_flag = token_is_toxic(uniq[i]) ? "Yes" : "No";
+        fprintf(f, "%d,%s,%d,%.2f%%,%s\n",
+            i + 1, token_text(uniq[i]), freq[i], percentage, is_toxic_flag);
+    }
+    fprintf(f, "\n");
+
+    // ===== 6. Advanced text statistics (corresponds to word_analysis results) =====
+    fprintf(f, "Advanced Text Statistics (stopwords & normalisation)\n");
+    if (has_advanced_text_stats) {
+        fprintf(f, "Metric,Value\n");
+        fprintf(f, "Filtered words (after stopwords),%d\n",
+            analysis_data.total_words_filtered);
+        fprintf(f, "Unique words (filtered),%d\n",
+            analysis_data.vocab.size);
+        fprintf(f, "Unique words (HLL estimate),%lld\n",
+            hll_estimate(&analysis_data.unique_estimate));
+        fprintf(f, "Detected sentences,%d\n",
+            analysis_data.sentences);
+
+        double avgSentenceLen =
+            (analysis_data.sentences > 0)
+            ? (double)analysis_data.total_words_filtered /
+            analysis_data.sentences
+            : 0.0;
+        fprintf(f, "Average sentence length (words),%.2f\n",
+            avgSentenceLen);
+
+        fprintf(f, "Stopwords filtered out,%d\n",
+            analysis_data.stopwords_removed);
+
+        double lex_div = 0.0;
+        if (analysis_data.total_words_filtered > 0) {
+            lex_div = (double)unique_word_count() /
+                analysis_data.total_words_filtered;
+        }
+        fprintf(f, "Lexical diversity (filtered),%.3f\n", lex_div);
+        fprintf(f, "Text normalisation,%s\n",
+            analysis_data.variant_processing_enabled
+            ? "ENABLED"
+            : "DISABLED");
+    }
+    else {
+        fprintf(f,
+            "No advanced text statistics are available for this file.\n"
+            "Use the advanced analysis menu before saving the report if you\n"
+            "want these values to be included.\n");
+    }
+    fprintf(f, "\n");
+
+    // ===== 7. Toxic content overview =====
+    fprintf(f, "Toxic Content Overview\n");
+
+    // 7.1 Basic toxic word check (always available in this report).
+    fprintf(f, "Basic dictionary check (current report)\n");
+    fprintf(f, "Metric,Value\n");
+    fprintf(f, "Unique toxic words (basic),%d\n",
+        toxic_words_count_basic);
+    fprintf(f, "Total toxic occurrences (basic),%d\n",
+        total_toxic_occurrences_basic);
+    fprintf(f, "Toxicity percentage (basic),%.2f%%\n",
+        toxicity_percentage_basic);
+
+    // Top 10 toxic words (basic view).
+    if (toxic_words_count_basic > 0) {
+        fprintf(f, "Top toxic words (up to 10)\n");
+        fprintf(f, "Rank,Word,Frequency,Severity,%% of all tokens\n");
+        int topT = (toxic_words_count_basic < 10)
+            ? toxic_words_count_basic
+            : 10;
+        for (int i = 0; i < topT; i++) {
+            float wp = (float)toxic_freq[i] / wordCount * 100.0f;
+            fprintf(f, "%d,%s,%d,%d,%.2f%%\n",
+                i + 1,
+                token_text(toxic_words_list[i]),
+                toxic_freq[i],
+                toxic_severity[i],
+                wp);
+        }
+    }
+    else {
+        fprintf(f,
+            "The basic dictionary check did not find any toxic words "
+            "in this file.\n");
+    }
+    fprintf(f, "\n");
+
+    // 7.2 Extended dictionary/phrase analysis (if Stage 3 data exist).
+    fprintf(f, "Dictionary & phrase-based toxic analysis (if available)\n");
+    if (has_advanced_toxic_stats) {
+        fprintf(f, "Metric,Value\n");
+        fprintf(f, "Toxic words in internal list,%d\n",
+            dict->word_count);
+        fprintf(f, "Toxic phrases (bigrams/trigrams),%d\n",
+            dict->phrase_count);
+        fprintf(f, "Total toxic occurrences (internal counters),%d\n",
+            analysis_data.total_toxic_occurrences);
+        fprintf(f, "Toxicity density (internal),%.4f\n",
+            analysis_data.toxicity_density);
+        fprintf(f, "Bigram toxic occurrences,%d\n",
+            analysis_data.bigram_toxic_occurrences);
+        fprintf(f, "Trigram toxic occurrences,%d\n",
+            analysis_data.trigram_toxic_occurrences);
+        if (analysis_data.fuzzy_matching_enabled) {
+            fprintf(f, "Fuzzy toxic matches (not in total),%d\n",
+                analysis_data.fuzzy_toxic_occurrences);
+        }
+
+        // Sentence ranking from the last toxic analysis of this file
+        if (has_advanced_text_stats && analysis_data.top_sentence_count > 0) {
+            const struct PositionIndex* pi = &analysis_data.positions;
+            char preview[TOXIC_SENTENCE_PREVIEW + 4];
+            fprintf(f, "Most toxic sentences (up to %d)\n", TOXIC_SENTENCES_TOP);
+            fprintf(f, "Rank,Sentence,Line,Toxic words,Words,Max severity,Text\n");
+            for (int i = 0; i < analysis_data.top_sentence_count; i++) {
+                const struct ToxicSentence* ts = &analysis_data.top_sentences[i];
+                sentence_preview(ts->sentence, preview, sizeof(preview));
+                fprintf(f, "%d,%d,%d,%d,%d,%d,\"",
+                    i + 1, ts->sentence + 1,
+                    position_mark_number(pi->line_start, pi->lines, pi->sentence_start[ts->sentence]),
+                    ts->toxic, ts->words, ts->max_severity);
+                for (const char* c = preview; *c; c++) {
+                    if (*c == '"') fputc('"', f);  // CSV doubles embedded quotes
+                    fputc(*c, f);
+                }
+                fprintf(f, "\"\n");
+            }
+        }
+    }
+    else {
+        fprintf(f,
+            "No extended toxic analysis data are available for this file.\n"
+            "Run the toxic content detection features before saving the\n"
+            "report if you want these details.\n");
+    }
+    fprintf(f, "\n");
+
+    // ===== 8. Sorting / performance overview =====
+    fprintf(f, "Sorting & Performance Overview\n");
+    if (has_sort_performance) {
+        fprintf(f, "Metric,Value\n");
+        fprintf(f, "Current sort key,%s\n",
+            (g_key == KEY_FREQ_DESC)
+            ? "Frequency (descending, ties→alpha)"
+            : "Alphabetical (A→Z)");
+        fprintf(f, "Current sort algorithm,%s\n", g_sort_alg_names[g_alg]);
+        fprintf(f, "Secondary tiebreak,%s\n",
+            g_use_secondary_tiebreak
+            ? "ON (alpha as secondary key)"
+            : "OFF (pure primary key)");
+        fprintf(f, "Configured Top N,%d\n", g_topN);
+        fprintf(f, "Last sort strategy,%s\n", g_sort_strategy_names[g_stats.strategy]);
+        fprintf(f, "Last sort comparisons,%lld\n", g_stats.comps);
+        fprintf(f, "Last sort moves,%lld\n", g_stats.moves);
+        fprintf(f, "Last sort time (ms),%.3f\n", g_stats.ms);
+    }
+    else {
+        fprintf(f,
+            "No sorting statistics were recorded in this session.\n"
+            "Use the sorting/reporting menu before saving the report\n"
+            "if you want performance numbers to appear here.\n");
+    }
+    fprintf(f, "\n");
+
+    // ===== 9. Per-stage timings (session totals before this report) =====
+    fprintf(f, "Stage Timings & Counters\n");
+    write_stage_metrics(f, true);
+
+    toxic_dict_release(dict);
+    stage_end(STAGE_REPORT, stage_t0, ftell(f) - start_offset, wordCount);
+}
+
+// ----- JSON-lines metrics sink -----
+// Each saved report (and each --stream run) appends one JSON object per
+// line to g_metrics_path for dashboards; one fopen/fclose per run.
+static char g_metrics_path[260] = METRICS_JSONL_PATH;
+static bool g_metrics_enabled = true;
+
+static void json_write_string(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+// Peak resident set size in KB, or -1 where it isn't available
+static long peak_rss_kb(void) {
+#ifndef _WIN32
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+#ifdef __APPLE__
+        return (long)(ru.ru_maxrss / 1024);  // Bytes on macOS
+#else
+        return (long)ru.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
 }
 
-// Dispatch to the selected sorting algorithm and measure elapsed time.
-static void sort_pairs(Pair a[], int n, SortKey key, SortAlg alg) {
-    if (n <= 1) return;
-    double t0 = now_ms();
-    switch (alg) {
-    case ALG_BUBBLE: bubble_sort_pairs(a, n, key); break;
-    case ALG_QUICK:  quick_sort_pairs(a, 0, n - 1, key); break;
-    case ALG_MERGE:  merge_sort_pairs(a, 0, n - 1, key); break;
-    default:         quick_sort_pairs(a, 0, n - 1, key); break;
+// Open the sink and write the fields every record shares; NULL when off.
+static FILE* metrics_begin(const char* kind) {
+    if (!g_metrics_enabled) return NULL;
+    FILE* f = fopen(g_metrics_path, "a");
+    if (!f) {
+        printf("[!] Cannot append metrics to %s\n", g_metrics_path);
+        return NULL;
     }
-    g_stats.ms += (now_ms() - t0);
+    fprintf(f, "{\"ts\":%lld,\"kind\":", (long long)time(NULL));
+    json_write_string(f, kind);
+    fprintf(f, ",\"peak_rss_kb\":%ld", peak_rss_kb());
+    return f;
 }
 
-// Build an array of unique word–count pairs from a flat token list.
-static int build_pairs_from_tokens(char (*words)[50], int wordCount, Pair out[], int maxOut) {
-    int ucnt = 0;
-    for (int i = 0; i < wordCount; ++i) {
-        int k = -1;
-        for (int j = 0; j < ucnt; ++j) {
-            if (strcmp(words[i], out[j].word) == 0) { k = j; break; }
-        }
-        if (k == -1) {
-            if (ucnt >= maxOut) break;
-            strcpy(out[ucnt].word, words[i]);
-            out[ucnt].count = 1;
-            ++ucnt;
-        }
-        else {
-            out[k].count++;
-        }
-    }
-    return ucnt;
+static void metrics_write_stages(FILE* f) {
+    fprintf(f, ",\"stages\":{");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        const StageMetrics* m = &g_stage_metrics[i];
+        if (i > 0) fputc(',', f);
+        json_write_string(f, g_stage_names[i]);
+        fprintf(f, ":{\"calls\":%lld,\"ms\":%.3f,\"last_ms\":%.3f,\"bytes\":%lld,\"tokens\":%lld,"
+            "\"allocs\":%lld,\"alloc_bytes\":%lld}",
+            m->calls, m->ms, m->last_ms, m->bytes, m->tokens, m->allocs, m->alloc_bytes);
+    }
+    fputc('}', f);
 }
 
+static void metrics_end(FILE* f) {
+    fputs("}\n", f);
+    fclose(f);
+}
 
+// Append one record for a saved report: load throughput of the reported
+// file, vocabulary, toxicity, sort stats and the per-stage table.
+static void append_report_metrics(const char* sourcePath, const uint32_t* words, int wordCount) {
+    FILE* f = metrics_begin("report");
+    if (!f) return;
+
+    const struct FileLoad* load = &g_file_load[(words == words2) ? 1 : 0];
+    double secs = load->ms / 1000.0;
+    fprintf(f, ",\"source\":");
+    json_write_string(f, sourcePath);
+    fprintf(f, ",\"tokens\":%d,\"bytes\":%lld,\"tokens_per_s\":%.0f,\"mb_per_s\":%.3f",
+        wordCount, load->bytes,
+        secs > 0.0 ? wordCount / secs : 0.0,
+        secs > 0.0 ? load->bytes / 1048576.0 / secs : 0.0);
+    fprintf(f, ",\"vocab\":{\"unique\":%d,\"unique_estimate\":%lld,\"interned\":%u}",
+        analysis_data.vocab.size, hll_estimate(&analysis_data.unique_estimate), g_intern_count);
+    fprintf(f, ",\"toxic\":{\"total\":%d,\"severity\":[%d,%d,%d,%d,%d],\"density\":%.4f,"
+        "\"bigrams\":%d,\"trigrams\":%d,\"fuzzy\":%d}",
+        analysis_data.total_toxic_occurrences,
+        analysis_data.severity_count[1], analysis_data.severity_count[2], analysis_data.severity_count[3],
+        analysis_data.severity_count[4], analysis_data.severity_count[5],
+        analysis_data.toxicity_density, analysis_data.bigram_toxic_occurrences,
+        analysis_data.trigram_toxic_occurrences, analysis_data.fuzzy_toxic_occurrences);
+    fprintf(f, ",\"sort\":{\"alg\":\"%s\",\"strategy\":\"%s\",\"key\":\"%s\",\"comps\":%lld,\"moves\":%lld,\"ms\":%.3f}",
+        g_sort_alg_names[g_alg], g_sort_strategy_names[g_stats.strategy],
+        g_key == KEY_FREQ_DESC ? "freq_desc" : "alpha",
+        g_stats.comps, g_stats.moves, g_stats.ms);
+    metrics_write_stages(f);
+    metrics_end(f);
+}
 
-// ===== 5. Stage4 - Reporting: Top N, Toxic, Comparison, Summary, Alphabetical List ======
+// Save the current analysis results to a TXT report and optionally a CSV report.
+void saveResultsToFile(void) {
+    if (!file1Loaded && !file2Loaded) {
+        printf("[!] No text loaded. Use menu 1 first.\n");
+        return;
+    }
 
-// Show Top N words (all tokens) using the chosen key and algorithm.
-void sort_and_show_topN_all(SortKey key, SortAlg alg, int topN) {
-    if (!file1Loaded && !file2Loaded) { printf("[!] No text loaded.\n"); return; }
+    // Automatically select a valid active source (File 1 / File 2) based on current state.
+    if (!auto_select_source_file()) {
+        printf("[X] No files available. Please load files in Stage 1 first.\n");
+        return;
+    }
 
-    char (*w)[50]; int wc; pick_tokens(&w, &wc);
-    if (!w || wc == 0) { printf("[!] No text loaded.\n"); return; }
+    const char* sourcePath;
+    const uint32_t* words;
+    int  wordCount;
 
-    Pair* arr = (Pair*)malloc(sizeof(Pair) * 6000);
-    if (!arr) { printf("[!] OOM\n"); return; }
-    int n = build_pairs_from_tokens(w, wc, arr, 6000);
+    // Select the path using the current g_use_file 
+    sourcePath = (g_use_file == 1) ? inputFilePath1 : inputFilePath2;
 
-    sort_pairs(arr, n, key, alg);
+    // Use pick_tokens，ensure that it have tokens which is same with Stage 4
+    pick_tokens(&words, &wordCount);
 
-    if (topN > n) topN = n;
-    printf("\n-- Top %d (%s, %s) --\n",
-        topN,
-        key == KEY_FREQ_DESC ? "freq desc" : "A->Z",
-        alg == ALG_BUBBLE ? "Bubble" : (alg == ALG_QUICK ? "Quick" : "Merge"));
-    for (int i = 0; i < topN; ++i) {
-        printf("%2d. %-20s %d\n", i + 1, arr[i].word, arr[i].count);
+    if (!words || wordCount <= 0) {
+        printf("[X] No tokens available from current source file.\n");
+        printf("Tip: Make sure you have loaded the file in Stage 1.\n");
+        return;
     }
-    free(arr);
-}
 
-// Show Top N toxic words only, sorted by frequency using the chosen algorithm.
-void sort_and_show_topN_toxic(SortAlg alg, int topN) {
-    if (!file1Loaded && !file2Loaded) { printf("[!] No text loaded.\n"); return; }
-    load_toxicwords();
 
-    char (*w)[50]; int wc; pick_tokens(&w, &wc);
-    if (!w || wc == 0) { printf("[!] No text loaded.\n"); return; }
+    // 2. Clean up the filename entered by the user.
+    char base[512];
+    strncpy(base, outputFilePath, sizeof(base) - 1);
+    base[sizeof(base) - 1] = '\0';
+    strip_quotes(base);
 
-    // First build the full frequency list.
-    Pair* all = (Pair*)malloc(sizeof(Pair) * 6000);
-    Pair* tox = (Pair*)malloc(sizeof(Pair) * 6000);
-    if (!all || !tox) { printf("[!] OOM\n"); free(all); free(tox); return; }
+    // If the user did not provide an extension, default to .txt.
+    char* dot = strrchr(base, '.');
+    if (dot == NULL) {
+        strcat(base, ".txt");
+    }
 
-    int nAll = build_pairs_from_tokens(w, wc, all, 6000);
+    // At this point, `base` is guaranteed to be of the form name.xxx.
+    // First build txt_path.
+    char txt_path[512];
+    strncpy(txt_path, base, sizeof(txt_path) - 1);
+    txt_path[sizeof(txt_path) - 1] = '\0';
 
-    // Extract only the toxic words.
-    int nT = 0;
-    for (int i = 0; i < nAll; ++i) {
-        if (is_toxic_word(all[i].word)) tox[nT++] = all[i];
+    // Then derive csv_path from txt_path by changing the extension to .csv.
+    char csv_path[512];
+    strncpy(csv_path, txt_path, sizeof(csv_path) - 1);
+    csv_path[sizeof(csv_path) - 1] = '\0';
+
+    char* dot2 = strrchr(csv_path, '.');
+    if (dot2 != NULL) {
+        strcpy(dot2, ".csv");
+    }
+    else {
+        strcat(csv_path, ".csv");
     }
 
-    if (nT == 0) { printf("[i] No toxic words found.\n"); free(all); free(tox); return; }
+    // ===== 3. Generate the TXT report first. =====
+#ifdef _WIN32
+    FILE* f_txt = fopen_u8(txt_path, "w");
+#else
+    FILE* f_txt = fopen(txt_path, "w");
+#endif
+    if (!f_txt) {
+        printf("[!] Error: Cannot create output file '%s'\n", txt_path);
+        perror("Detailed error");
+        handleError("Cannot open text output file");
+        return;
+    }
 
-    // Toxic words are typically sorted by descending frequency.
-    sort_pairs(tox, nT, KEY_FREQ_DESC, alg);
-    if (topN > nT) topN = nT;
+    write_full_report(f_txt, sourcePath, words, wordCount);
+    fclose(f_txt);
+    printf("\nSaved TEXT report to %s\n", txt_path);
+    append_report_metrics(sourcePath, words, wordCount);
 
-    printf("\n-- Toxic Top %d (freq desc, %s) --\n",
-        topN, alg == ALG_BUBBLE ? "Bubble" : (alg == ALG_QUICK ? "Quick" : "Merge"));
-    for (int i = 0; i < topN; ++i) {
-        printf("%2d. %-20s %d\n", i + 1, tox[i].word, tox[i].count);
+    // ===== 4. Ask the user whether a CSV version is also needed. =====
+    printf("Do you also want a CSV version for spreadsheets? (y/n): ");
+    char ans[16];
+    if (!read_line(ans, sizeof(ans))) {
+        // If input cannot be read, treat it as "no".
+        return;
     }
 
-    free(all); free(tox);
-}
-
-// Compare Bubble, Quick, and Merge sort outputs and performance on Top N results.
-void compare_algorithms_topN(int topN) {
-    if (!file1Loaded && !file2Loaded) {
-        printf("[!] No text loaded.\n");
+    if (ans[0] != 'y' && ans[0] != 'Y') {
+        printf("CSV report not generated.\n");
         return;
     }
-    char (*w)[50]; int wc;
-    pick_tokens(&w, &wc);
-    if (!w || wc == 0) {
-        printf("[!] No text loaded.\n");
+
+    // ===== 5. Generate the CSV report. =====
+#ifdef _WIN32
+    FILE* f_csv = fopen_u8(csv_path, "w");
+#else
+    FILE* f_csv = fopen(csv_path, "w");
+#endif
+    if (!f_csv) {
+        printf("[!] Error: Cannot create CSV file '%s'\n", csv_path);
+        perror("Detailed error");
+        handleError("Cannot open CSV output file");
         return;
     }
 
-    Pair* base = (Pair*)malloc(sizeof(Pair) * 6000);
-    Pair* a = (Pair*)malloc(sizeof(Pair) * 6000);  // Bubble
-    Pair* b = (Pair*)malloc(sizeof(Pair) * 6000);  // Quick
-    Pair* c = (Pair*)malloc(sizeof(Pair) * 6000);  // Merge
-    if (!base || !a || !b || !c) {
-        printf("[!] OOM\n");
-        free(base); free(a); free(b); free(c);
+    write_full_report(f_csv, sourcePath, words, wordCount);
+    fclose(f_csv);
+    printf("Saved CSV report to %s\n", csv_path);
+
+    // Console output summary
+    printf("Your reports include:\n");
+    printf(" - TEXT report: %s\n", txt_path);
+    printf(" - CSV  report: %s\n", csv_path);
+}
+
+
+// ===== 7. Stage 4/6 - Sorting & Reporting Main Menu (User Interaction)
+
+// Show the sorting & reporting menu and dispatch user commands.
+void menu_sort_and_report(void) {
+    int sub = -1;
+    if (!auto_select_source_file()) {
+        // No files available → show a message and return directly to the main menu.
+        printf("\n[X] No files available for sorting/reporting. "
+            "Please load files in Stage 1 first.\n");
         return;
     }
+    do {
+        // On each loop, confirm the current source (in case Stage 1 changed the active file).
+        if (!auto_select_source_file()) {
+            printf("\n[X] No files available.\n");
+            return;
+        }
 
-    int n = build_pairs_from_tokens(w, wc, base, 6000);
-    memcpy(a, base, sizeof(Pair) * n);
-    memcpy(b, base, sizeof(Pair) * n);
-    memcpy(c, base, sizeof(Pair) * n);
+        const char* activePath = (g_use_file == 1)
+            ? inputFilePath1
+            : inputFilePath2;
+        printf("\n=== Sorting & Reporting ===\n");
+        printf("Current source file      : %s (%s)\n",
+            (g_use_file == 1) ? "File 1" : "File 2",
+            activePath);
+        printf("----------------------------------------\n");
+        printf("1. Set sort KEY (current: %s)\n",
+            g_key == KEY_FREQ_DESC ? "Frequency in descending" : "Alphabetical (A->Z)");
+        printf("2. Set sort ALGORITHM (current: %s)\n",
+            g_sort_alg_names[g_alg]);
+        printf("3. Toggle secondary tiebreak (current: %s)\n",
+            g_use_secondary_tiebreak ? "ON (alpha as tiebreak)" : "OFF (pure primary key)");
+        printf("4. Set Top N (current: %d)\n", g_topN);
+        printf("5. Show Top N (ALL words)\n");
+        printf("6. Show Top N (TOXIC words only)\n");
+        printf("7. Compare algorithms (Top N)\n");
+        printf("8. Extra summary (toxic ratio)\n");
+        printf("9  List ALL words alphabetically (lazy quicksort, ignores the algorithm setting)\n");
+        printf("10. Toggle frequency mode (current: %s)\n",
+            g_use_approx ? "Approximate (Count-Min + Space-Saving)" : "Exact");
+        printf("11. Stage timings & counters\n");
+        printf("0. Back\n");
+        printf("Select: ");
+
+        if (scanf("%d", &sub) != 1) {
+            int c;
+            while ((c = getchar()) != '\n' && c != EOF);
+            printf("Invalid input. Please enter 0-11.\n");
+            sub = -1;
+            continue;
+        }
+
+        int c;
+        while ((c = getchar()) != '\n' && c != EOF);
+
+
+        switch (sub) {
+        case 1: {
+            // Configure sorting key (frequency or alphabetical).
+            int k;
+            printf("Choose key: 1=Frequency desc, 2=Alphabetical : ");
+            if (scanf("%d", &k) == 1) {
+                g_key = (k == 2 ? KEY_ALPHA : KEY_FREQ_DESC);
+            }
+            else {
+                printf("Invalid key choice.\n");
+            }
+            while ((c = getchar()) != '\n' && c != EOF);
+        } break;
+        case 2: {
+            //Configure sorting algorithm (Bubble / Quick / Merge / Auto / Tim).
+            int a;
+            printf("Choose algorithm: 1=Bubble  2=Quick  3=Merge  4=Auto  5=Tim : ");
+            if (scanf("%d", &a) == 1) {
+                if (a == 1) g_alg = ALG_BUBBLE;
+                else if (a == 3) g_alg = ALG_MERGE;
+                else if (a == 4) g_alg = ALG_AUTO;
+                else if (a == 5) g_alg = ALG_TIM;
+                else g_alg = ALG_QUICK;
+            }
+        } break;
+        case 3:
+            g_use_secondary_tiebreak = !g_use_secondary_tiebreak;
+            printf("Secondary tiebreak is now %s\n",
+                g_use_secondary_tiebreak ? "ON" : "OFF");
+            break;
+        case 4: {
+            //Configure Top N value for reporting.
+            int n;
+            printf("Enter Top N (>=1): ");
+            if (scanf("%d", &n) == 1 && n > 0) g_topN = n;
+        } break;
+        case 5:
+            //Show Top N words across all tokens.
+            sort_and_show_topN_all(g_key, g_alg, g_topN);
+            break;
+        case 6:
+            //Show Top N toxic words only; typically sorted by frequency desc.
+            sort_and_show_topN_toxic(g_alg, g_topN);
+            break;
+        case 7:
+            compare_algorithms_topN(g_topN);
+            break;
+        case 8:
+            show_extra_summary();
+            break;
+        case 9:
+            list_alpha_all();
+            break;
+        case 10:
+            g_use_approx = !g_use_approx;
+            printf("Top N now uses %s frequencies\n", g_use_approx ? "approximate" : "exact");
+            break;
+        case 11:
+            printf("\n=== Stage Timings & Counters (this session) ===\n");
+            write_stage_metrics(stdout, false);
+            break;
+        case 0:
+            break;
+        default:
+            printf("Invalid choice. Please enter 0-11.\n");
+        }
+    } while (sub != 0);
+}
 
-    SortKey key = g_key;
+// ===== 8. Streaming Analysis (stdin) =====
+// "--stream" reads text from stdin as it arrives and prints rolling
+// statistics. Memory stays bounded: the vocabulary stops growing at
+// STREAM_MAX_VOCAB words and the window is a fixed-size ring.
+
+struct StreamState {
+    // Whole stream
+    long long tokens;
+    long long toxic;
+    long long severity[SEVERITY_CLASSES];
+    long long untracked;          // Tokens of words past the vocabulary cap
+    long long bytes;              // Input bytes read
+    int exact;                    // 0 = --no-exact: sketches only, nothing interned
+    struct VocabTable vocab;
+    struct ApproxCounter approx;  // Covers every token, tracked or not
+    struct HyperLogLog unique;
+
+    // Sliding window: the last `window` tokens, optionally also no older
+    // than `window_seconds`
+    int window;
+    int window_seconds;           // 0 = token window only
+    int* window_counts;           // Per vocab row
+    int* ring_row;                // Vocab row per token (-1 = untracked)
+    unsigned char* ring_class;
+    uint32_t* ring_time;          // Seconds since the stream started
+    int ring_head;                // Oldest token
+    int ring_len;
+    int window_toxic;
+    int window_severity[SEVERITY_CLASSES];
+
+    // Snapshots every `every` tokens and/or every `interval` seconds
+    int every;
+    int interval;
+    long long next_snapshot;
+    time_t started;
+    time_t last_snapshot;
+    int snapshots;
+};
 
-    // Measure statistics for each algorithm independently.
-    SortStats sB, sQ, sM;
+static int parse_stream_int(const char* arg, int lo, int hi, int* out) {
+    char* end;
+    long v = arg ? strtol(arg, &end, 10) : 0;
+    if (!arg || *end || v < lo || v > hi) return 0;
+    *out = (int)v;
+    return 1;
+}
 
-    stats_reset(); sort_pairs(a, n, key, ALG_BUBBLE); sB = g_stats;
-    stats_reset(); sort_pairs(b, n, key, ALG_QUICK);  sQ = g_stats;
-    stats_reset(); sort_pairs(c, n, key, ALG_MERGE);  sM = g_stats;
+static void stream_window_pop(struct StreamState* st) {
+    int row = st->ring_row[st->ring_head];
+    int cls = st->ring_class[st->ring_head];
+    if (row >= 0) st->window_counts[row]--;
+    st->window_severity[cls]--;
+    if (cls) st->window_toxic--;
+    st->ring_head = (st->ring_head + 1) % st->window;
+    st->ring_len--;
+}
 
-    if (topN > n) topN = n;
+// Drop tokens that have aged out of a time window
+static void stream_window_expire(struct StreamState* st, uint32_t now) {
+    if (st->window_seconds <= 0) return;
+    while (st->ring_len > 0 && now - st->ring_time[st->ring_head] >= (uint32_t)st->window_seconds) {
+        stream_window_pop(st);
+    }
+}
 
-    printf("\n== Algorithm Comparison (key=%s, tiebreak=%s) ==\n",
-        key == KEY_FREQ_DESC ? "freq desc" : "A→Z",
-        g_use_secondary_tiebreak ? "ON" : "OFF");
+static void stream_token(struct StreamState* st, const char* word, uint32_t now) {
+    int has_letters = 0;
+    for (int j = 0; word[j]; j++) {
+        if (ISALPHA(word[j])) { has_letters = 1; break; }
+    }
+    if (!has_letters) return;
+    if (is_stopword((char*)word, analysis_data.stopwords, analysis_data.stop_count)) return;
 
-    // Print three columns side by side: Bubble / Quick / Merge.
-    printf("\n%-4s | %-20s %6s | %-20s %6s | %-20s %6s\n",
-        "Rank",
-        "Bubble", "count",
-        "Quick", "count",
-        "Merge", "count");
-    printf("------+---------------------------+---------------------------+---------------------------\n");
+    // Known words keep their ID; new ones are interned only below the cap
+    unsigned int hash = hash_string(word);
+    uint32_t id = TOKEN_NONE;
+    if (st->exact) {
+        id = intern_find_hashed(word, hash);
+        if (id == TOKEN_NONE && g_intern_count < STREAM_MAX_VOCAB) id = intern_word(word);
+    }
 
-    for (int i = 0; i < topN; i++) {
-        printf("%-4d | %-20s %6d | %-20s %6d | %-20s %6d\n",
-            i + 1,
-            a[i].word, a[i].count,
-            b[i].word, b[i].count,
-            c[i].word, c[i].count);
+    int row = -1;
+    unsigned char cls;
+    if (id != TOKEN_NONE) {
+        row = vocab_add(&st->vocab, id, 1, STREAM_MAX_VOCAB);
+        const struct TokenToxicity* t = token_toxicity(id);
+        cls = toxicity_class(t->toxic, t->severity);
     }
+    else {
+        cls = toxicity_class(is_toxic_word(word), get_toxic_severity(word));
+    }
+
+    approx_add(&st->approx, word, hash, cls != 0);
+    hll_add(&st->unique, hash);
+    st->tokens++;
+    st->severity[cls]++;
+    if (cls) st->toxic++;
+    if (row < 0) st->untracked++;
+
+    stream_window_expire(st, now);
+    if (st->ring_len == st->window) stream_window_pop(st);
+    int slot = (st->ring_head + st->ring_len) % st->window;
+    st->ring_row[slot] = row;
+    st->ring_class[slot] = cls;
+    st->ring_time[slot] = now;
+    st->ring_len++;
+    if (row >= 0) st->window_counts[row]++;
+    st->window_severity[cls]++;
+    if (cls) st->window_toxic++;
+}
 
-    // Stability check: compare whether the first `cap` entries are identical across algorithms.
-    int agree = 1, cap = topN < 30 ? topN : 30;
-    for (int i = 0; i < cap; i++) {
-        if (strcmp(a[i].word, b[i].word) != 0 ||
-            strcmp(a[i].word, c[i].word) != 0) {
-            agree = 0;
-            break;
-        }
+// Tokenise one chunk of stream text the same way process_text_file() and
+// reprocess_with_variants() treat a file.
+static void stream_text(struct StreamState* st, char* text, uint32_t now) {
+    for (char* p = text; *p; p++) {
+        if ((unsigned char)*p > 127) *p = ' ';
     }
+    fold_leet_symbols(text);
 
-    printf("\n[Stability] Top %d %s across algorithms.\n",
-        cap, agree ? "ARE IDENTICAL" : "DIFFER");
+    for (char* tok = strtok(text, DELIMS); tok; tok = strtok(NULL, DELIMS)) {
+        char word[MAX_WORD_LENGTH];
+        strncpy(word, tok, MAX_WORD_LENGTH - 1);
+        word[MAX_WORD_LENGTH - 1] = '\0';
+        for (int i = 0; word[i]; i++) word[i] = (char)TOLOWER(word[i]);
 
-    //  Performance comparison table (keeps the original formatting).
-    printf("\n%-8s | %10s | %12s | %12s\n",
-        "Alg", "Time(ms)", "Comparisons", "Moves");
-    printf("----------+------------+--------------+--------------\n");
-    printf("%-8s | %10.3f | %12lld | %12lld\n",
-        "Bubble", sB.ms, sB.comps, sB.moves);
-    printf("%-8s | %10.3f | %12lld | %12lld\n",
-        "Quick", sQ.ms, sQ.comps, sQ.moves);
-    printf("%-8s | %10.3f | %12lld | %12lld\n",
-        "Merge", sM.ms, sM.comps, sM.moves);
+        const struct VariantMap* vm = lookup_variant(word);
+        if (vm != NULL && vm->part_count > 1) {
+            for (int p = 0; p < vm->part_count; p++) {
+                stream_token(st, vm->parts + vm->part_offset[p], now);
+            }
+            continue;
+        }
+        if (vm != NULL) {
+            strncpy(word, vm->standard, MAX_WORD_LENGTH - 1);
+            word[MAX_WORD_LENGTH - 1] = '\0';
+        }
+        else if (analysis_data.variant_processing_enabled) {
+            const char* canonical = leet_toxic_form(word);
+            if (canonical) strcpy(word, canonical);
+        }
+        stream_token(st, word, now);
+    }
+}
 
-    free(base); free(a); free(b); free(c);
+static void print_stream_severity(const char* label, long long total, long long toxic, const long long sev[]) {
+    double density = total ? 100.0 * toxic / total : 0.0;
+    printf("%-8s: tokens=%lld toxic=%lld density=%.2f%% severity[1-5]=%lld/%lld/%lld/%lld/%lld\n",
+        label, total, toxic, density, sev[1], sev[2], sev[3], sev[4], sev[5]);
 }
 
-// Print extra summary statistics such as toxic vs non-toxic ratios.
-void show_extra_summary(void) {
-    if (!file1Loaded && !file2Loaded) { printf("[!] No text loaded.\n"); return; }
-    load_toxicwords();
+static void print_stream_top(const char* label, const struct VocabTable* v, const int* counts) {
+    int rows[STREAM_TOP_WORDS];
+    int n = top_count_rows(counts, v->size, STREAM_TOP_WORDS, rows);
+    printf("%-8s:", label);
+    if (n == 0) printf(" (none)");
+    for (int i = 0; i < n; i++) {
+        printf(" %s(%d)", vocab_text(v, rows[i]), counts[rows[i]]);
+    }
+    printf("\n");
+}
 
-    char (*w)[50]; int wc; pick_tokens(&w, &wc);
-    if (!w || wc == 0) { printf("[!] No text loaded.\n"); return; }
+static void stream_snapshot(struct StreamState* st, const char* title, time_t now) {
+    stream_window_expire(st, (uint32_t)(now - st->started));
 
-    int toxic_tokens = 0, nontoxic_tokens = 0;
-    Pair* all = (Pair*)malloc(sizeof(Pair) * 6000);
-    if (!all) { printf("[!] OOM\n"); return; }
-    int n = build_pairs_from_tokens(w, wc, all, 6000);
+    long long window_sev[SEVERITY_CLASSES];
+    for (int c = 0; c < SEVERITY_CLASSES; c++) window_sev[c] = st->window_severity[c];
 
-    for (int i = 0; i < n; i++) {
-        if (is_toxic_word(all[i].word)) toxic_tokens += all[i].count;
-        else                             nontoxic_tokens += all[i].count;
+    printf("\n--- %s #%d: %lld tokens, %lld s ---\n",
+        title, ++st->snapshots, st->tokens, (long long)(now - st->started));
+    print_stream_severity("Stream", st->tokens, st->toxic, st->severity);
+    print_stream_severity("Window", st->ring_len, st->window_toxic, window_sev);
+    long long distinct = hll_estimate(&st->unique);
+    printf("Unique  : ~%lld distinct (HLL), diversity %.3f", distinct,
+        st->tokens ? (double)distinct / st->tokens : 0.0);
+    if (st->exact) printf(", %d words tracked", st->vocab.size);
+    if (st->exact && st->untracked > 0) {
+        printf(", %lld tokens of words beyond the %d-word cap", st->untracked, STREAM_MAX_VOCAB);
     }
-    int total = toxic_tokens + nontoxic_tokens;
-    double tox_ratio = total ? (100.0 * toxic_tokens / total) : 0.0;
-
-    // Also compute ratios at the "type" level (unique words).
-    int toxic_types = 0, nontoxic_types = 0;
-    for (int i = 0; i < n; i++) {
-        if (is_toxic_word(all[i].word)) toxic_types++;
-        else                            nontoxic_types++;
+    printf("\n");
+    if (st->exact) {
+        print_stream_top("Top all", &st->vocab, st->vocab.counts);
+        print_stream_top("Top win", &st->vocab, st->window_counts);
+    }
+    if (!st->exact || st->untracked > 0) {
+        // Exact counts miss words past the cap; the summaries don't
+        int n;
+        struct HeavyHitter* ranked = ss_ranked(&st->approx.all, STREAM_TOP_WORDS, &n);
+        printf("Top est :");
+        for (int i = 0; i < n; i++) {
+            printf(" %s(%lld..%lld)", ranked[i].word, ranked[i].count - ranked[i].error, ranked[i].count);
+        }
+        printf("\n");
+        free(ranked);
     }
+    fflush(stdout);
 
-    printf("\n=== Extra Summary ===\n");
-    printf("Tokens  : toxic=%d, non-toxic=%d, total=%d, toxic ratio=%.2f%%\n",
-        toxic_tokens, nontoxic_tokens, total, tox_ratio);
-    printf("Types   : toxic=%d, non-toxic=%d, total=%d\n",
-        toxic_types, nontoxic_types, toxic_types + nontoxic_types);
+    st->last_snapshot = now;
+    if (st->every > 0) st->next_snapshot = st->tokens + st->every;
+}
 
-    free(all);
+static void free_stream_state(struct StreamState* st) {
+    vocab_free(&st->vocab);
+    approx_free(&st->approx);
+    free(st->window_counts);
+    free(st->ring_row);
+    free(st->ring_class);
+    free(st->ring_time);
 }
 
-// List all unique words alphabetically with pagination.
-void list_alpha_all(void) {
-    if (!file1Loaded && !file2Loaded) {
-        printf("[!] No text loaded.\n");
-        return;
-    }
+// One metrics record for a finished stream
+static void append_stream_metrics(const struct StreamState* st, double elapsed_ms) {
+    FILE* f = metrics_begin("stream");
+    if (!f) return;
+
+    double secs = elapsed_ms / 1000.0;
+    fprintf(f, ",\"source\":\"stdin\",\"tokens\":%lld,\"bytes\":%lld,\"elapsed_s\":%.3f,"
+        "\"tokens_per_s\":%.0f,\"mb_per_s\":%.3f",
+        st->tokens, st->bytes, secs,
+        secs > 0.0 ? st->tokens / secs : 0.0,
+        secs > 0.0 ? st->bytes / 1048576.0 / secs : 0.0);
+    fprintf(f, ",\"vocab\":{\"unique_estimate\":%lld,\"tracked\":%d,\"untracked_tokens\":%lld}",
+        hll_estimate(&st->unique), st->vocab.size, st->untracked);
+    fprintf(f, ",\"toxic\":{\"total\":%lld,\"severity\":[%lld,%lld,%lld,%lld,%lld],\"density\":%.4f}",
+        st->toxic, st->severity[1], st->severity[2], st->severity[3], st->severity[4], st->severity[5],
+        st->tokens ? 100.0 * st->toxic / st->tokens : 0.0);
+    fprintf(f, ",\"snapshots\":%d", st->snapshots);
+    metrics_end(f);
+}
 
-    char (*w)[50];
-    int wc;
-    pick_tokens(&w, &wc);
-    if (!w || wc == 0) {
-        printf("[!] No text loaded.\n");
-        return;
+// Entry point for --stream. Options: --window N, --window-seconds S,
+// --every N, --interval S, --raw (no text normalisation), --no-exact
+// (no per-word table; unique words and top words come from the sketches).
+// --metrics PATH / --no-metrics are handled in main() for every mode.
+int run_stream_mode(int argc, char** argv) {
+    struct StreamState st;
+    memset(&st, 0, sizeof(st));
+    st.window = STREAM_WINDOW_DEFAULT;
+    st.every = STREAM_SNAPSHOT_DEFAULT;
+    st.exact = 1;
+    analysis_data.variant_processing_enabled = true;
+
+    for (int i = 0; i < argc; i++) {
+        const char* opt = argv[i];
+        const char* val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        int ok = 1;
+        if (strcmp(opt, "--window") == 0)              ok = parse_stream_int(val, 1, STREAM_WINDOW_MAX, &st.window), i++;
+        else if (strcmp(opt, "--window-seconds") == 0) ok = parse_stream_int(val, 0, 86400 * 365, &st.window_seconds), i++;
+        else if (strcmp(opt, "--every") == 0)          ok = parse_stream_int(val, 0, 1 << 30, &st.every), i++;
+        else if (strcmp(opt, "--interval") == 0)       ok = parse_stream_int(val, 0, 86400 * 365, &st.interval), i++;
+        else if (strcmp(opt, "--raw") == 0)            analysis_data.variant_processing_enabled = false;
+        else if (strcmp(opt, "--no-exact") == 0)       st.exact = 0;
+        else {
+            printf("Error: Unknown stream option: %s\n", opt);
+            return 1;
+        }
+        if (!ok) {
+            printf("Error: Invalid value for %s\n", opt);
+            return 1;
+        }
     }
 
-    Pair* arr = (Pair*)malloc(sizeof(Pair) * 6000);
-    if (!arr) {
-        printf("[!] OOM\n");
-        return;
+    analysis_data.stop_count = load_stopwords(analysis_data.stopwords);
+    ensure_toxic_dictionary();
+
+    if (st.exact) {
+        st.window_counts = (int*)stage_calloc(STREAM_MAX_VOCAB, sizeof(int));
+    }
+    st.ring_row = (int*)stage_malloc(sizeof(int) * st.window);
+    st.ring_class = (unsigned char*)stage_malloc(st.window);
+    st.ring_time = (uint32_t*)stage_malloc(sizeof(uint32_t) * st.window);
+    if ((st.exact && (!st.window_counts || !vocab_reserve(&st.vocab, INTERN_INITIAL))) ||
+        !st.ring_row || !st.ring_class || !st.ring_time || !approx_init(&st.approx)) {
+        printf("Error: Memory allocation failed (stream)\n");
+        free_stream_state(&st);
+        return 1;
     }
 
-    int n = build_pairs_from_tokens(w, wc, arr, 6000);
-    // Sort the unique words alphabetically.
-    sort_pairs(arr, n, KEY_ALPHA, g_alg);
+    printf("Streaming from stdin (window %d tokens", st.window);
+    if (st.window_seconds > 0) printf(" / %d s", st.window_seconds);
+    printf(", snapshot every %d tokens", st.every);
+    if (st.interval > 0) printf(" or %d s", st.interval);
+    printf(")...\n");
+    fflush(stdout);
 
-    const int perPage = 50;
-    int page = 0;
-    char cmd[16];
+    st.started = st.last_snapshot = time(NULL);
+    st.next_snapshot = st.every;
+    double started_ms = wall_ms();
 
-    for (;;) {
-        int start = page * perPage;
-        if (start >= n) {
-            printf("[i] No more words.\n");
-            break;
+    // Chunks are cut at a delimiter so a word is never split across reads
+    char buf[STREAM_BUFFER];
+    size_t carry = 0;
+    int done = 0;
+    while (!done) {
+        if (!fgets(buf + carry, (int)(sizeof(buf) - carry), stdin)) {
+            if (carry == 0) break;
+            buf[carry] = '\0';
+            done = 1;
         }
-        int end = start + perPage;
-        if (end > n) end = n;
-
-        printf("\n-- Alphabetical listing (words %d-%d of %d) --\n",
-            start + 1, end, n);
-        for (int i = start; i < end; ++i) {
-            printf("%-20s %d\n", arr[i].word, arr[i].count);
+        size_t len = carry + strlen(buf + carry);
+        if (!done) st.bytes += (long long)(len - carry);
+        size_t cut = len;
+        if (!done && len > 0 && buf[len - 1] != '\n') {
+            while (cut > 0 && !strchr(DELIMS, buf[cut - 1])) cut--;
+            if (cut == 0) cut = len;
         }
 
-        // Prompt the user for navigation commands.
-        if (page == 0 && end == n) {
-            printf("[Q]uit : ");
-        }
-        else if (page == 0) {
-            printf("[N]ext, [Q]uit : ");
-        }
-        else if (end == n) {
-            printf("[P]rev, [Q]uit : ");
-        }
-        else {
-            printf("[P]rev, [N]ext, [Q]uit : ");
-        }
+        char tail[STREAM_BUFFER];
+        size_t tail_len = len - cut;
+        memcpy(tail, buf + cut, tail_len);
+        buf[cut] = '\0';
 
-        if (!read_line(cmd, sizeof(cmd))) {
-            break;
-        }
-        // Empty input: do nothing and re-prompt.
-        if (cmd[0] == '\0') {
-            continue;
-        }
+        time_t now = time(NULL);
+        stream_text(&st, buf, (uint32_t)(now - st.started));
 
-        // Strictly parse: only accept a single character n / p / q (case-insensitive).
-        if (strcmp(cmd, "n") == 0 || strcmp(cmd, "N") == 0) {
-            if ((page + 1) * perPage >= n) {
-                printf("[i] Already at last page.\n");
-            }
-            else {
-                page++;
-            }
-        }
-        else if (strcmp(cmd, "p") == 0 || strcmp(cmd, "P") == 0) {
-            if (page == 0) {
-                printf("[i] Already at first page.\n");
-            }
-            else {
-                page--;
-            }
-        }
-        else if (strcmp(cmd, "q") == 0 || strcmp(cmd, "Q") == 0 || strcmp(cmd, "0") == 0) {
-            break;
-        }
-        else {
-            // Inputs like "npq", "nn", or "x" will fall into this branch.
-            printf("[i] Unknown command. Please use n / p / q.\n");
+        memcpy(buf, tail, tail_len);
+        carry = tail_len;
+
+        if ((st.every > 0 && st.tokens >= st.next_snapshot) ||
+            (st.interval > 0 && now - st.last_snapshot >= st.interval)) {
+            stream_snapshot(&st, "Snapshot", now);
         }
     }
-    free(arr);
-}
 
+    stream_snapshot(&st, "Final", time(NULL));
+    append_stream_metrics(&st, wall_ms() - started_ms);
+    free_stream_state(&st);
+    return 0;
+}
 
+// ===== 9. Benchmarks and Verification (--bench, --bench-sort, --verify) =====
+// "--bench" writes a Zipf-distributed synthetic corpus at each requested
+// size, runs the pipeline over it stage by stage and prints throughput and
+// peak memory per stage, as a table and as CSV. The same seed always
+// produces the same corpus.
+
+struct BenchOptions {
+    int sizes_mb[BENCH_MAX_SIZES];
+    int size_count;
+    int vocab;              // Distinct generated words
+    double zipf;            // Zipf exponent (rank r has weight 1 / r^zipf)
+    double toxic_rate;      // Fraction of tokens drawn from the toxic dictionary
+    int csv;                // Generate "id,text" CSV instead of plain text
+    uint64_t seed;
+    int keep;               // Keep the generated corpora and report
+    char out_path[260];     // CSV results
+    char generate_path[260]; // --generate: write one corpus and stop
+};
 
-// ===== 6. Stage 4/5 - Saving Reports (TXT + optional CSV)
+struct BenchCorpus {
+    double* cdf;            // Cumulative Zipf weights, cdf[vocab - 1] == 1
+    char* words;            // vocab words, BENCH_WORD_LENGTH bytes each
+    int vocab;
+    struct ToxicDictionary* dict; // Pinned while toxic points into it
+    const char** toxic;     // Single-word dictionary entries
+    int toxic_count;
+};
 
-// Write a full analysis report for the given token list into the provided FILE*.
-static void write_full_report(FILE* f,
-    const char* sourcePath,
-    char (*words)[50],
-    int wordCount)
-{
-    // Load toxic word dictionary (for basic toxicity analysis in this report).
-    load_toxicwords();
+// splitmix64: hll_mix() already adds the golden-ratio increment
+static uint64_t bench_rand(uint64_t* state) {
+    return hll_mix((*state)++);
+}
 
-    // ===== 1. Compute unique words and their frequencies (basic statistics) =====
-    char uniq[1000][50];
-    int  freq[5000];
-    int  ucnt = 0;
+// Starting state for a seed; scrambled so nearby seeds don't share a stream
+static uint64_t bench_seed(uint64_t seed) {
+    return hll_mix(hll_mix(seed));
+}
 
-    for (int i = 0; i < wordCount && ucnt < 1000; i++) {
-        int k = -1;
-        for (int j = 0; j < ucnt; j++) {
-            if (strcmp(words[i], uniq[j]) == 0) { k = j; break; }
-        }
-        if (k == -1) {
-            strcpy(uniq[ucnt], words[i]);
-            freq[ucnt] = 1;
-            ucnt++;
-        }
-        else {
-            freq[k]++;
-        }
-    }
+static double bench_uniform(uint64_t* state) {
+    return (bench_rand(state) >> 11) * (1.0 / 9007199254740992.0);
+}
 
-    // Sort unique words by frequency (descending) and then alphabetically (A–Z).
-    for (int i = 0; i < ucnt - 1; i++) {
-        for (int j = 0; j < ucnt - i - 1; j++) {
-            if (freq[j] < freq[j + 1] ||
-                (freq[j] == freq[j + 1] && strcmp(uniq[j], uniq[j + 1]) > 0)) {
+// Pronounceable word for a rank: base-90 digits as consonant-vowel syllables
+static void bench_word(int rank, char* out) {
+    static const char consonants[] = "bcdfghjklmnprstvwz";
+    static const char vowels[] = "aeiou";
+    int n = 0;
+    unsigned int r = (unsigned int)rank + 1;
+    while (r > 0 && n < BENCH_WORD_LENGTH - 3) {
+        unsigned int syl = r % 90;
+        out[n++] = consonants[syl / 5];
+        out[n++] = vowels[syl % 5];
+        r /= 90;
+    }
+    if (n == 2) out[n++] = 'x'; // Keep one-syllable words off the stopword list
+    out[n] = '\0';
+}
 
-                int tf = freq[j];
-                freq[j] = freq[j + 1];
-                freq[j + 1] = tf;
+static void bench_corpus_free(struct BenchCorpus* c) {
+    free(c->cdf);
+    free(c->words);
+    free(c->toxic);
+    toxic_dict_release(c->dict);
+    memset(c, 0, sizeof(*c));
+}
 
-                char tmp[50];
-                strcpy(tmp, uniq[j]);
-                strcpy(uniq[j], uniq[j + 1]);
-                strcpy(uniq[j + 1], tmp);
-            }
-        }
+static int bench_corpus_init(struct BenchCorpus* c, const struct BenchOptions* o) {
+    memset(c, 0, sizeof(*c));
+    c->vocab = o->vocab;
+    c->cdf = (double*)stage_malloc(sizeof(double) * o->vocab);
+    c->words = (char*)stage_malloc((size_t)o->vocab * BENCH_WORD_LENGTH);
+    if (!c->cdf || !c->words) {
+        printf("Error: Memory allocation failed (bench corpus)\n");
+        bench_corpus_free(c);
+        return 0;
     }
 
-    // ===== 2. Basic toxicity analysis (based on uniq/freq + is_toxic_word) =====
-    int toxic_words_count_basic = 0;        // Unique toxic words detected by basic check.
-    int total_toxic_occurrences_basic = 0;  // Total occurrences of those toxic words.
-
-    // To keep the report readable, only keep the top 100 toxic words for printing.
-    char toxic_words_list[100][50];
-    int  toxic_freq[100] = { 0 };
-    int  toxic_severity[100] = { 0 };
-
-    for (int i = 0; i < ucnt; i++) {
-        if (is_toxic_word(uniq[i])) {
-            if (toxic_words_count_basic < 100) {
-                strcpy(toxic_words_list[toxic_words_count_basic], uniq[i]);
-                toxic_freq[toxic_words_count_basic] = freq[i];
-                toxic_severity[toxic_words_count_basic] = get_toxic_severity(uniq[i]);
-                toxic_words_count_basic++;
-            }
-            total_toxic_occurrences_basic += freq[i];
-        }
+    double sum = 0.0;
+    for (int r = 0; r < o->vocab; r++) {
+        sum += 1.0 / pow(r + 1.0, o->zipf);
+        c->cdf[r] = sum;
+        bench_word(r, c->words + (size_t)r * BENCH_WORD_LENGTH);
     }
+    for (int r = 0; r < o->vocab; r++) c->cdf[r] /= sum;
+    c->cdf[o->vocab - 1] = 1.0;
 
-    // Sort the kept toxic words by frequency (descending).
-    for (int i = 0; i < toxic_words_count_basic - 1; i++) {
-        for (int j = 0; j < toxic_words_count_basic - i - 1; j++) {
-            if (toxic_freq[j] < toxic_freq[j + 1]) {
-                int tf = toxic_freq[j];
-                toxic_freq[j] = toxic_freq[j + 1];
-                toxic_freq[j + 1] = tf;
-
-                char tmpw[50];
-                strcpy(tmpw, toxic_words_list[j]);
-                strcpy(toxic_words_list[j], toxic_words_list[j + 1]);
-                strcpy(toxic_words_list[j + 1], tmpw);
-
-                int ts = toxic_severity[j];
-                toxic_severity[j] = toxic_severity[j + 1];
-                toxic_severity[j + 1] = ts;
-            }
+    if (o->toxic_rate > 0.0) {
+        struct ToxicDictionary* dict = c->dict = toxic_dict_acquire();
+        c->toxic = (const char**)stage_malloc(sizeof(char*) * (dict->word_count > 0 ? dict->word_count : 1));
+        if (!c->toxic) {
+            printf("Error: Memory allocation failed (bench corpus)\n");
+            bench_corpus_free(c);
+            return 0;
+        }
+        for (int i = 0; i < dict->word_count; i++) {
+            if (!strchr(dict->words[i].word, ' ')) c->toxic[c->toxic_count++] = dict->words[i].word;
         }
+        if (c->toxic_count == 0) printf("[!] Warning: No toxic words loaded; corpus will be clean.\n");
     }
+    return 1;
+}
 
-    // ===== 3. Detect which advanced features have data in this session =====
-    // Advanced text statistics: only valid if they refer to this same source file.
-    int has_advanced_text_stats =
-        analysis_data.text_filtered &&
-        current_filename[0] != '\0' &&
-        (strcmp(current_filename, sourcePath) == 0);
+static const char* bench_next_word(const struct BenchCorpus* c, const struct BenchOptions* o, uint64_t* rng) {
+    if (c->toxic_count > 0 && bench_uniform(rng) < o->toxic_rate) {
+        return c->toxic[bench_rand(rng) % (uint64_t)c->toxic_count];
+    }
+    double u = bench_uniform(rng);
+    int lo = 0, hi = c->vocab - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (c->cdf[mid] < u) lo = mid + 1;
+        else hi = mid;
+    }
+    return c->words + (size_t)lo * BENCH_WORD_LENGTH;
+}
 
-    // Advanced toxic statistics: check if Stage 3 counters were updated.
-    int has_advanced_toxic_stats =
-        (analysis_data.toxic_words_count > 0 ||
-            analysis_data.toxic_phrases_count > 0 ||
-            analysis_data.toxicity_density > 0.0f);
+// Write about `bytes` bytes of corpus; returns the bytes written, -1 on error
+static long long bench_generate(const char* path, long long bytes,
+    const struct BenchCorpus* c, const struct BenchOptions* o, long long* tokens) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        printf("Error: Cannot create benchmark corpus: %s\n", path);
+        return -1;
+    }
+    uint64_t rng = bench_seed(o->seed);
+    long long written = 0;
+    *tokens = 0;
+    int row = 0;
+    char line[1024];
+    if (o->csv) written += fprintf(f, "id,text\n");
+
+    while (written < bytes) {
+        int n = o->csv ? sprintf(line, "%d,", ++row) : 0;
+        int words = 8 + (int)(bench_rand(&rng) % 9);
+        *tokens += words;
+        for (int w = 0; w < words; w++) {
+            n += sprintf(line + n, w ? " %s" : "%s", bench_next_word(c, o, &rng));
+        }
+        line[n++] = o->csv ? '\n' : '.';
+        if (!o->csv) line[n++] = (bench_rand(&rng) & 3) ? ' ' : '\n';
+        line[n] = '\0';
+        if (fputs(line, f) == EOF) break;
+        written += n;
+    }
+    if (fclose(f) != 0 || written < bytes) {
+        printf("Error: Failed writing benchmark corpus: %s\n", path);
+        return -1;
+    }
+    return written;
+}
 
-    // Sorting performance: comparisons/moves/time > 0 means a sort was executed.
-    int has_sort_performance =
-        (g_stats.comps > 0 || g_stats.moves > 0 || g_stats.ms > 0.0);
+// Pipeline stages print progress; route stdout to the null device while
+// one is timed. Not available on Windows, where the output passes through.
+static int bench_mute(void) {
+    fflush(stdout);
+#ifndef _WIN32
+    int saved = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (saved >= 0 && null_fd >= 0) dup2(null_fd, STDOUT_FILENO);
+    if (null_fd >= 0) close(null_fd);
+    return saved;
+#else
+    return -1;
+#endif
+}
 
-    // ===== 4. Report header and overall summary =====
-    fprintf(f, "Text Analysis Report\n");
-    fprintf(f, "====================\n\n");
+static void bench_unmute(int saved) {
+    fflush(stdout);
+#ifndef _WIN32
+    if (saved >= 0) {
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+#else
+    (void)saved;
+#endif
+}
 
-    // 4.1 Global overview (basic statistics always present).
-    fprintf(f, "Overall Summary\n");
-    fprintf(f, "Metric,Value\n");
-    fprintf(f, "Source file,%s\n", sourcePath);
-    fprintf(f, "File type,%s\n",
-        isCSVFile(sourcePath) ? "CSV" : "Text");
-    fprintf(f, "Analysis date,%s\n", __DATE__);
-    fprintf(f, "Total tokens (raw input),%d\n", wordCount);
-    fprintf(f, "Unique words (recomputed),%d\n", ucnt);
-    fprintf(f, "Unique toxic words (basic check),%d\n", toxic_words_count_basic);
-    fprintf(f, "Total toxic occurrences (basic check),%d\n",
-        total_toxic_occurrences_basic);
+// One result row: printed to the table and appended to the CSV
+static void bench_row(FILE* csv, int size_mb, const char* format, const char* stage,
+    double ms, long long bytes, long long tokens) {
+    double secs = ms / 1000.0;
+    double mbps = (secs > 0.0 && bytes > 0) ? bytes / 1048576.0 / secs : 0.0;
+    double tps = (secs > 0.0 && tokens > 0) ? tokens / secs : 0.0;
+    long rss = peak_rss_kb();
+    printf("%6d | %-24s | %10.2f | %10.1f | %12.0f | %10lld | %10ld\n",
+        size_mb, stage, ms, mbps, tps, tokens, rss);
+    if (csv) {
+        fprintf(csv, "%d,%s,%s,%.3f,%lld,%lld,%.3f,%.0f,%ld\n",
+            size_mb, format, stage, ms, bytes, tokens, mbps, tps, rss);
+        fflush(csv);
+    }
+}
 
-    float toxicity_percentage_basic = 0.0f;
-    if (wordCount > 0) {
-        toxicity_percentage_basic =
-            (float)total_toxic_occurrences_basic / wordCount * 100.0f;
+// Run every stage over one corpus; returns 0 if the corpus couldn't be made
+static int bench_run_size(FILE* csv, int size_mb, const struct BenchCorpus* c, const struct BenchOptions* o) {
+    const char* format = o->csv ? "csv" : "text";
+    char path[64];
+    snprintf(path, sizeof(path), "bench_%dmb.%s", size_mb, o->csv ? "csv" : "txt");
+
+    long long generated = 0;
+    double t0 = wall_ms();
+    long long bytes = bench_generate(path, (long long)size_mb * 1048576, c, o, &generated);
+    if (bytes < 0) return 0;
+    bench_row(csv, size_mb, format, "generate", wall_ms() - t0, bytes, generated);
+
+    // Stage 1: load and tokenise into words1
+    strncpy(inputFilePath1, path, sizeof(inputFilePath1) - 1);
+    inputFilePath1[sizeof(inputFilePath1) - 1] = '\0';
+    int muted = bench_mute();
+    t0 = wall_ms();
+    loadTextFile(1);
+    double ms = wall_ms() - t0;
+    bench_unmute(muted);
+    bench_row(csv, size_mb, format, "loadTextFile", ms, bytes, wordCount1);
+
+    // Stage 2: reads at most MAX_TEXT_LENGTH bytes of the file
+    muted = bench_mute();
+    t0 = wall_ms();
+    process_text_file(path);
+    ms = wall_ms() - t0;
+    bench_unmute(muted);
+    long long text_bytes = analysis_data.text ? (long long)strlen(analysis_data.text) : 0;
+    bench_row(csv, size_mb, format, "process_text_file", ms, text_bytes, analysis_data.original_word_count);
+
+    // Stage 3
+    if (analysis_data.text_filtered) {
+        muted = bench_mute();
+        t0 = wall_ms();
+        run_toxic_analysis();
+        ms = wall_ms() - t0;
+        bench_unmute(muted);
+        bench_row(csv, size_mb, format, "run_toxic_analysis", ms, 0, analysis_data.total_words_filtered);
+    }
+    else {
+        printf("%6d | %-24s | skipped: Stage 2 failed (is stopwords.txt present?)\n", size_mb, "run_toxic_analysis");
     }
-    fprintf(f, "Toxicity percentage (basic check),%.2f%%\n",
-        toxicity_percentage_basic);
-    fprintf(f, "Toxic dictionary terms loaded,%d\n", g_toxic_count);
-    fprintf(f, "\n");
 
-    // 4.2 Feature run summary – explicitly tell which analyses were run or not.
-    fprintf(f, "Feature Run Summary\n");
-    fprintf(f, "Feature,Status,Notes\n");
-    fprintf(f,
-        "Basic token statistics,GENERATED,"
-        "Always computed when saving this report\n");
-    fprintf(f,
-        "Advanced text statistics,%s,%s\n",
-        has_advanced_text_stats ? "AVAILABLE" : "NOT AVAILABLE",
-        has_advanced_text_stats
-        ? "Results taken from previous advanced analysis"
-        : "Advanced analysis menu was not used for this file");
-    fprintf(f,
-        "Advanced toxic detection,%s,%s\n",
-        has_advanced_toxic_stats ? "AVAILABLE" : "NOT AVAILABLE",
-        has_advanced_toxic_stats
-        ? "Uses dictionary-based word/phrase analysis"
-        : "Dictionary-based toxic analysis was not performed or found no data");
-    fprintf(f,
-        "Sorting & performance,%s,%s\n",
-        has_sort_performance ? "AVAILABLE" : "NOT AVAILABLE",
-        has_sort_performance
-        ? "Statistics captured from the last sorting operation"
-        : "No sorting experiment was recorded in this session");
-    fprintf(f, "\n");
+    // Stage 4: pairs over the loaded tokens, then every sort on the same input.
+    // Counting stops at the unique-word cap, so rows report the tokens
+    // actually counted rather than wordCount1.
+    Pair* pairs = (Pair*)stage_malloc(sizeof(Pair) * BENCH_MAX_PAIRS * 2);
+    if (!pairs) {
+        printf("Error: Memory allocation failed (bench pairs)\n");
+    }
+    else {
+        t0 = wall_ms();
+        int n = build_pairs_from_tokens(words1, wordCount1, pairs, BENCH_MAX_PAIRS);
+        ms = wall_ms() - t0;
+        long long counted = 0;
+        for (int r = 0; r < n; r++) counted += pairs[r].count;
+        bench_row(csv, size_mb, format, "build_pairs_from_tokens", ms, 0, counted);
+
+        static const SortAlg algs[] = { ALG_BUBBLE, ALG_QUICK, ALG_MERGE, ALG_TIM, ALG_AUTO };
+        static const char* const alg_names[] = {
+            "sort_pairs (bubble)", "sort_pairs (quick)", "sort_pairs (merge)",
+            "sort_pairs (tim)", "sort_pairs (auto)"
+        };
+        for (int a = 0; a < 5; a++) {
+            Pair* work = pairs + BENCH_MAX_PAIRS;
+            memcpy(work, pairs, sizeof(Pair) * (n > 0 ? n : 1));
+            g_stats.comps = g_stats.moves = 0;
+            g_stats.ms = 0.0;
+            t0 = wall_ms();
+            sort_pairs(work, n, KEY_FREQ_DESC, algs[a]);
+            bench_row(csv, size_mb, format, alg_names[a], wall_ms() - t0, 0, n);
+        }
+        free(pairs);
+    }
+
+    // Report writing
+    const char* report_path = "bench_report.txt";
+    FILE* rf = fopen(report_path, "w");
+    if (rf) {
+        muted = bench_mute();
+        t0 = wall_ms();
+        write_full_report(rf, path, words1, wordCount1);
+        fclose(rf);
+        ms = wall_ms() - t0;
+        bench_unmute(muted);
+        long long counted = 0;
+        for (int r = 0; r < g_stage4_vocab.size; r++) counted += g_stage4_vocab.counts[r];
+        bench_row(csv, size_mb, format, "write_full_report", ms, 0, counted);
+        if (!o->keep) remove(report_path);
+    }
+    else {
+        printf("Error: Cannot create %s\n", report_path);
+    }
 
-    // ===== 5. Basic word-frequency statistics (always available) =====
-    fprintf(f, "Basic Token Statistics\n");
-    fprintf(f, "Metric,Value\n");
+    if (!o->keep) remove(path);
+    return 1;
+}
 
-    int singleOccurrence = 0;
-    for (int i = 0; i < ucnt; i++) {
-        if (freq[i] == 1) singleOccurrence++;
-    }
-    float avgFrequency =
-        (ucnt > 0) ? (float)wordCount / (float)ucnt : 0.0f;
+// Comma-separated integers in [lo, hi], at most BENCH_MAX_SIZES of them
+static int parse_int_list(const char* arg, int lo, int hi, int* out, int* count) {
+    if (!arg) return 0;
+    *count = 0;
+    const char* p = arg;
+    while (*p) {
+        char* end;
+        long v = strtol(p, &end, 10);
+        if (end == p || v < lo || v > hi || *count >= BENCH_MAX_SIZES) return 0;
+        out[(*count)++] = (int)v;
+        if (*end == ',') end++;
+        else if (*end) return 0;
+        p = end;
+    }
+    return *count > 0;
+}
 
-    fprintf(f, "Unique word count,%d\n", ucnt);
-    fprintf(f, "Words with single occurrence,%d\n", singleOccurrence);
-    fprintf(f, "Average frequency per unique word,%.2f\n", avgFrequency);
-    fprintf(f, "\n");
+static int parse_bench_double(const char* arg, double lo, double hi, double* out) {
+    char* end;
+    double v = arg ? strtod(arg, &end) : 0.0;
+    if (!arg || *end || !(v >= lo && v <= hi)) return 0;
+    *out = v;
+    return 1;
+}
 
-    // Top 20 most frequent words.
-    fprintf(f, "Top Words by Frequency (up to 20)\n");
-    fprintf(f, "Rank,Word,Frequency,%% of all tokens,Is toxic\n");
-    int totalWords = wordCount;
-    int topn = (ucnt < 20) ? ucnt : 20;
-    for (int i = 0; i < topn; i++) {
-        float percentage = (float)freq[i] / totalWords * 100.0f;
-        const char* is_toxic_flag = is_toxic_word(uniq[i]) ? "Yes" : "No";
-        fprintf(f, "%d,%s,%d,%.2f%%,%s\n",
-            i + 1, uniq[i], freq[i], percentage, is_toxic_flag);
+// Entry point for --bench. Options: --sizes MB[,MB...], --vocab N,
+// --zipf S, --toxic-rate R, --csv-input, --seed N, --out PATH, --keep,
+// --generate PATH (write one corpus of the first size and exit).
+int run_bench_mode(int argc, char** argv) {
+    struct BenchOptions o;
+    memset(&o, 0, sizeof(o));
+    parse_int_list(BENCH_SIZES_DEFAULT, 1, BENCH_MAX_SIZE_MB, o.sizes_mb, &o.size_count);
+    o.vocab = BENCH_VOCAB_DEFAULT;
+    o.zipf = BENCH_ZIPF_DEFAULT;
+    o.toxic_rate = BENCH_TOXIC_RATE_DEFAULT;
+    o.seed = 1;
+    strcpy(o.out_path, BENCH_RESULTS_PATH);
+
+    for (int i = 0; i < argc; i++) {
+        const char* opt = argv[i];
+        const char* val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        int ok = 1;
+        int seed = 0;
+        if (strcmp(opt, "--sizes") == 0)           ok = parse_int_list(val, 1, BENCH_MAX_SIZE_MB, o.sizes_mb, &o.size_count), i++;
+        else if (strcmp(opt, "--vocab") == 0)      ok = parse_stream_int(val, 1, 10000000, &o.vocab), i++;
+        else if (strcmp(opt, "--zipf") == 0)       ok = parse_bench_double(val, 0.0, 10.0, &o.zipf), i++;
+        else if (strcmp(opt, "--toxic-rate") == 0) ok = parse_bench_double(val, 0.0, 1.0, &o.toxic_rate), i++;
+        else if (strcmp(opt, "--seed") == 0)       ok = parse_stream_int(val, 0, 0x7FFFFFFF, &seed), o.seed = (uint64_t)seed, i++;
+        else if (strcmp(opt, "--csv-input") == 0)  o.csv = 1;
+        else if (strcmp(opt, "--keep") == 0)       o.keep = 1;
+        else if ((strcmp(opt, "--out") == 0 || strcmp(opt, "--generate") == 0) && val) {
+            char* dst = (opt[2] == 'o') ? o.out_path : o.generate_path;
+            strncpy(dst, val, sizeof(o.out_path) - 1);
+            dst[sizeof(o.out_path) - 1] = '\0';
+            i++;
+        }
+        else {
+            printf("Error: Unknown bench option: %s\n", opt);
+            return 1;
+        }
+        if (!ok) {
+            printf("Error: Invalid value for %s\n", opt);
+            return 1;
+        }
     }
-    fprintf(f, "\n");
 
-    // ===== 6. Advanced text statistics (corresponds to word_analysis results) =====
-    fprintf(f, "Advanced Text Statistics (stopwords & normalisation)\n");
-    if (has_advanced_text_stats) {
-        fprintf(f, "Metric,Value\n");
-        fprintf(f, "Filtered words (after stopwords),%d\n",
-            analysis_data.total_words_filtered);
-        fprintf(f, "Unique words (filtered),%d\n",
-            analysis_data.word_count);
-        fprintf(f, "Detected sentences,%d\n",
-            analysis_data.sentences);
+    int muted = bench_mute();
+    struct BenchCorpus corpus;
+    int ready = bench_corpus_init(&corpus, &o);
+    bench_unmute(muted);
+    if (!ready) return 1;
 
-        double avgSentenceLen =
-            (analysis_data.sentences > 0)
-            ? (double)analysis_data.total_words_filtered /
-            analysis_data.sentences
-            : 0.0;
-        fprintf(f, "Average sentence length (words),%.2f\n",
-            avgSentenceLen);
+    if (o.generate_path[0]) {
+        long long tokens = 0;
+        long long bytes = bench_generate(o.generate_path, (long long)o.sizes_mb[0] * 1048576, &corpus, &o, &tokens);
+        if (bytes >= 0) printf("Wrote %lld bytes (%lld tokens) to %s\n", bytes, tokens, o.generate_path);
+        bench_corpus_free(&corpus);
+        return bytes < 0;
+    }
 
-        fprintf(f, "Stopwords filtered out,%d\n",
-            analysis_data.stopwords_removed);
+    FILE* csv = fopen(o.out_path, "w");
+    if (!csv) printf("[!] Cannot create %s; printing the table only\n", o.out_path);
+    else fprintf(csv, "size_mb,format,stage,ms,bytes,tokens,mb_per_s,tokens_per_s,peak_rss_kb\n");
 
-        double lex_div = 0.0;
-        if (analysis_data.total_words_filtered > 0) {
-            lex_div = (double)analysis_data.word_count /
-                analysis_data.total_words_filtered;
+    printf("Benchmark: %s corpus, vocabulary %d, Zipf s=%.2f, toxic rate %.3f, seed %llu\n",
+        o.csv ? "CSV" : "text", o.vocab, o.zipf, o.toxic_rate, (unsigned long long)o.seed);
+    printf("%6s | %-24s | %10s | %10s | %12s | %10s | %10s\n",
+        "MB", "Stage", "ms", "MB/s", "tokens/s", "tokens", "peak KB");
+    printf("-------+--------------------------+------------+------------+--------------+------------+-----------\n");
+
+    int rc = 0;
+    for (int s = 0; s < o.size_count; s++) {
+        if (!bench_run_size(csv, o.sizes_mb[s], &corpus, &o)) {
+            rc = 1;
+            break;
         }
-        fprintf(f, "Lexical diversity (filtered),%.3f\n", lex_div);
-        fprintf(f, "Text normalisation,%s\n",
-            analysis_data.variant_processing_enabled
-            ? "ENABLED"
-            : "DISABLED");
     }
-    else {
-        fprintf(f,
-            "No advanced text statistics are available for this file.\n"
-            "Use the advanced analysis menu before saving the report if you\n"
-            "want these values to be included.\n");
+
+    if (csv) {
+        fclose(csv);
+        printf("Saved benchmark results to %s\n", o.out_path);
     }
-    fprintf(f, "\n");
+    cleanup_analysis_data();
+    bench_corpus_free(&corpus);
+    return rc;
+}
 
-    // ===== 7. Toxic content overview =====
-    fprintf(f, "Toxic Content Overview\n");
+// ----- Sorting scaling benchmark (--bench-sort) -----
+// compare_algorithms_topN() sorts the current file once; this times each
+// SortAlg over synthetic pair arrays of several sizes and input orders,
+// with warmup and repetitions, to choose a default algorithm per shape.
 
-    // 7.1 Basic toxic word check (always available in this report).
-    fprintf(f, "Basic dictionary check (current report)\n");
-    fprintf(f, "Metric,Value\n");
-    fprintf(f, "Unique toxic words (basic),%d\n",
-        toxic_words_count_basic);
-    fprintf(f, "Total toxic occurrences (basic),%d\n",
-        total_toxic_occurrences_basic);
-    fprintf(f, "Toxicity percentage (basic),%.2f%%\n",
-        toxicity_percentage_basic);
+typedef enum { ORDER_RANDOM, ORDER_SORTED, ORDER_REVERSE, ORDER_TIES, ORDER_ZIPF, ORDER_COUNT } BenchOrder;
+static const char* const g_bench_order_names[ORDER_COUNT] = {
+    "random", "sorted", "reverse", "ties", "zipf"
+};
 
-    // Top 10 toxic words (basic view).
-    if (toxic_words_count_basic > 0) {
-        fprintf(f, "Top toxic words (up to 10)\n");
-        fprintf(f, "Rank,Word,Frequency,Severity,%% of all tokens\n");
-        int topT = (toxic_words_count_basic < 10)
-            ? toxic_words_count_basic
-            : 10;
-        for (int i = 0; i < topT; i++) {
-            float wp = (float)toxic_freq[i] / wordCount * 100.0f;
-            fprintf(f, "%d,%s,%d,%d,%.2f%%\n",
-                i + 1,
-                toxic_words_list[i],
-                toxic_freq[i],
-                toxic_severity[i],
-                wp);
+struct SortBenchResult {
+    double median_ms;
+    double p95_ms;
+    long long comps;
+    long long moves;
+    int ordered;            // Output checked against cmp_pairs()
+};
+
+// Bubble sort is quadratic unless the input is already sorted; this quick
+// sort (last-element pivot) is quadratic on sorted and reverse input.
+static int sort_bench_quadratic(SortAlg alg, BenchOrder order) {
+    if (alg == ALG_BUBBLE) return order != ORDER_SORTED;
+    if (alg == ALG_QUICK) return order == ORDER_SORTED || order == ORDER_REVERSE;
+    return 0;
+}
+
+static int cmp_double_asc(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Distinct words for the pair IDs, interned once for the largest size
+static int sort_bench_intern(uint32_t* ids, int n) {
+    char word[BENCH_WORD_LENGTH];
+    for (int r = 0; r < n; r++) {
+        bench_word(r, word);
+        ids[r] = intern_word(word);
+        if (ids[r] == TOKEN_NONE) return 0;
+    }
+    return 1;
+}
+
+static void sort_bench_fill(Pair* a, const uint32_t* ids, int n, BenchOrder order, SortKey key, uint64_t* rng) {
+    for (int i = 0; i < n; i++) {
+        a[i].id = ids[i];
+        switch (order) {
+        case ORDER_TIES: a[i].count = 1 + (int)(bench_rand(rng) % 4); break;
+        case ORDER_ZIPF: a[i].count = 1 + (int)(n / pow(i + 1.0, BENCH_ZIPF_DEFAULT)); break;
+        default:         a[i].count = 1 + (int)(bench_rand(rng) % (uint64_t)n); break;
         }
     }
-    else {
-        fprintf(f,
-            "The basic dictionary check did not find any toxic words "
-            "in this file.\n");
+    for (int i = n - 1; i > 0; i--) {
+        int j = (int)(bench_rand(rng) % (uint64_t)(i + 1));
+        Pair t = a[i]; a[i] = a[j]; a[j] = t;
     }
-    fprintf(f, "\n");
+    if (order == ORDER_SORTED || order == ORDER_REVERSE) {
+        merge_sort_pairs(a, 0, n - 1, key);
+    }
+    if (order == ORDER_REVERSE) {
+        for (int i = 0, j = n - 1; i < j; i++, j--) {
+            Pair t = a[i]; a[i] = a[j]; a[j] = t;
+        }
+    }
+}
 
-    // 7.2 Extended dictionary/phrase analysis (if Stage 3 data exist).
-    fprintf(f, "Dictionary & phrase-based toxic analysis (if available)\n");
-    if (has_advanced_toxic_stats) {
-        fprintf(f, "Metric,Value\n");
-        fprintf(f, "Toxic words in internal list,%d\n",
-            analysis_data.toxic_words_count);
-        fprintf(f, "Toxic phrases (bigrams/trigrams),%d\n",
-            analysis_data.toxic_phrases_count);
-        fprintf(f, "Total toxic occurrences (internal counters),%d\n",
-            analysis_data.total_toxic_occurrences);
-        fprintf(f, "Toxicity density (internal),%.4f\n",
-            analysis_data.toxicity_density);
-        fprintf(f, "Bigram toxic occurrences,%d\n",
-            analysis_data.bigram_toxic_occurrences);
-        fprintf(f, "Trigram toxic occurrences,%d\n",
-            analysis_data.trigram_toxic_occurrences);
+static void sort_bench_run(const Pair* input, Pair* work, int n, SortKey key, SortAlg alg,
+    int warmup, int reps, struct SortBenchResult* out) {
+    double times[BENCH_SORT_MAX_REPS];
+    for (int r = 0; r < warmup + reps; r++) {
+        memcpy(work, input, sizeof(Pair) * n);
+        stats_reset();
+        double t0 = wall_ms();
+        sort_pairs(work, n, key, alg);
+        double ms = wall_ms() - t0;
+        if (r >= warmup) times[r - warmup] = ms;
+    }
+    qsort(times, reps, sizeof(double), cmp_double_asc);
+    out->median_ms = (reps % 2) ? times[reps / 2] : (times[reps / 2 - 1] + times[reps / 2]) / 2.0;
+    out->p95_ms = times[(int)ceil(0.95 * reps) - 1];
+    out->comps = g_stats.comps;  // Same every repetition
+    out->moves = g_stats.moves;
+    out->ordered = 1;
+    for (int i = 1; i < n && out->ordered; i++) {
+        if (cmp_pairs(&work[i - 1], &work[i], key) > 0) out->ordered = 0;
     }
-    else {
-        fprintf(f,
-            "No extended toxic analysis data are available for this file.\n"
-            "Run the toxic content detection features before saving the\n"
-            "report if you want these details.\n");
+}
+
+// Entry point for --bench-sort. Options: --sizes N[,N...], --reps N,
+// --warmup N, --key freq|alpha, --max-quadratic N, --seed N, --out PATH.
+int run_sort_bench_mode(int argc, char** argv) {
+    int sizes[BENCH_MAX_SIZES];
+    int size_count = 0;
+    int reps = BENCH_SORT_REPS_DEFAULT, warmup = 1, seed = 1;
+    int max_quadratic = BENCH_SORT_QUADRATIC_MAX;
+    SortKey key = KEY_FREQ_DESC;
+    char out_path[260] = BENCH_SORT_RESULTS_PATH;
+    parse_int_list(BENCH_SORT_SIZES_DEFAULT, 2, BENCH_SORT_MAX_N, sizes, &size_count);
+
+    for (int i = 0; i < argc; i++) {
+        const char* opt = argv[i];
+        const char* val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        int ok = 1;
+        if (strcmp(opt, "--sizes") == 0)              ok = parse_int_list(val, 2, BENCH_SORT_MAX_N, sizes, &size_count), i++;
+        else if (strcmp(opt, "--reps") == 0)          ok = parse_stream_int(val, 1, BENCH_SORT_MAX_REPS, &reps), i++;
+        else if (strcmp(opt, "--warmup") == 0)        ok = parse_stream_int(val, 0, 100, &warmup), i++;
+        else if (strcmp(opt, "--max-quadratic") == 0) ok = parse_stream_int(val, 0, BENCH_SORT_MAX_N, &max_quadratic), i++;
+        else if (strcmp(opt, "--seed") == 0)          ok = parse_stream_int(val, 0, 0x7FFFFFFF, &seed), i++;
+        else if (strcmp(opt, "--key") == 0 && val) {
+            if (strcmp(val, "freq") == 0) key = KEY_FREQ_DESC;
+            else if (strcmp(val, "alpha") == 0) key = KEY_ALPHA;
+            else ok = 0;
+            i++;
+        }
+        else if (strcmp(opt, "--out") == 0 && val) {
+            strncpy(out_path, val, sizeof(out_path) - 1);
+            out_path[sizeof(out_path) - 1] = '\0';
+            i++;
+        }
+        else {
+            printf("Error: Unknown bench option: %s\n", opt);
+            return 1;
+        }
+        if (!ok) {
+            printf("Error: Invalid value for %s\n", opt);
+            return 1;
+        }
     }
-    fprintf(f, "\n");
 
-    // ===== 8. Sorting / performance overview =====
-    fprintf(f, "Sorting & Performance Overview\n");
-    if (has_sort_performance) {
-        fprintf(f, "Metric,Value\n");
-        fprintf(f, "Current sort key,%s\n",
-            (g_key == KEY_FREQ_DESC)
-            ? "Frequency (descending, ties→alpha)"
-            : "Alphabetical (A→Z)");
-        fprintf(f, "Current sort algorithm,%s\n",
-            (g_alg == ALG_BUBBLE)
-            ? "Bubble"
-            : (g_alg == ALG_QUICK ? "Quick" : "Merge"));
-        fprintf(f, "Secondary tiebreak,%s\n",
-            g_use_secondary_tiebreak
-            ? "ON (alpha as secondary key)"
-            : "OFF (pure primary key)");
-        fprintf(f, "Configured Top N,%d\n", g_topN);
-        fprintf(f, "Last sort comparisons,%lld\n", g_stats.comps);
-        fprintf(f, "Last sort moves,%lld\n", g_stats.moves);
-        fprintf(f, "Last sort time (ms),%.3f\n", g_stats.ms);
+    int max_n = 0;
+    for (int s = 0; s < size_count; s++) if (sizes[s] > max_n) max_n = sizes[s];
+    uint32_t* ids = (uint32_t*)stage_malloc(sizeof(uint32_t) * max_n);
+    Pair* input = (Pair*)stage_malloc(sizeof(Pair) * max_n);
+    Pair* work = (Pair*)stage_malloc(sizeof(Pair) * max_n);
+    if (!ids || !input || !work || !sort_bench_intern(ids, max_n)) {
+        printf("Error: Memory allocation failed (sort bench)\n");
+        free(ids); free(input); free(work);
+        return 1;
     }
-    else {
-        fprintf(f,
-            "No sorting statistics were recorded in this session.\n"
-            "Use the sorting/reporting menu before saving the report\n"
-            "if you want performance numbers to appear here.\n");
+
+    FILE* csv = fopen(out_path, "w");
+    if (!csv) printf("[!] Cannot create %s; printing the table only\n", out_path);
+    else fprintf(csv, "n,order,alg,key,reps,median_ms,p95_ms,comparisons,moves,ns_per_elem\n");
+
+    printf("Sort benchmark: key=%s, tiebreak=%s, %d warmup + %d timed runs, quadratic cases up to n=%d\n",
+        key == KEY_FREQ_DESC ? "freq desc" : "alpha",
+        g_use_secondary_tiebreak ? "ON" : "OFF", warmup, reps, max_quadratic);
+    printf("%8s | %-7s | %-6s | %10s | %10s | %14s | %14s | %9s\n",
+        "n", "Order", "Alg", "Median ms", "p95 ms", "Comparisons", "Moves", "ns/elem");
+    printf("---------+---------+--------+------------+------------+----------------+----------------+----------\n");
+
+    // Fastest algorithm per (size, order), summarised at the end
+    SortAlg best[BENCH_MAX_SIZES][ORDER_COUNT];
+    double best_ms[BENCH_MAX_SIZES][ORDER_COUNT];
+
+    uint64_t rng = bench_seed((uint64_t)seed);
+    for (int s = 0; s < size_count; s++) {
+        int n = sizes[s];
+        for (int o = 0; o < ORDER_COUNT; o++) {
+            sort_bench_fill(input, ids, n, (BenchOrder)o, key, &rng);
+            best_ms[s][o] = -1.0;
+            for (int a = ALG_BUBBLE; a <= ALG_AUTO; a++) {
+                if (n > max_quadratic && sort_bench_quadratic((SortAlg)a, (BenchOrder)o)) {
+                    printf("%8d | %-7s | %-6s | skipped (quadratic above n=%d)\n",
+                        n, g_bench_order_names[o], g_sort_alg_names[a], max_quadratic);
+                    continue;
+                }
+                struct SortBenchResult r;
+                sort_bench_run(input, work, n, key, (SortAlg)a, warmup, reps, &r);
+                double ns = r.median_ms * 1e6 / n;
+                printf("%8d | %-7s | %-6s | %10.3f | %10.3f | %14lld | %14lld | %9.1f%s\n",
+                    n, g_bench_order_names[o], g_sort_alg_names[a],
+                    r.median_ms, r.p95_ms, r.comps, r.moves, ns, r.ordered ? "" : "  [!] NOT SORTED");
+                if (csv) {
+                    fprintf(csv, "%d,%s,%s,%s,%d,%.4f,%.4f,%lld,%lld,%.2f\n",
+                        n, g_bench_order_names[o], g_sort_alg_names[a],
+                        key == KEY_FREQ_DESC ? "freq" : "alpha", reps,
+                        r.median_ms, r.p95_ms, r.comps, r.moves, ns);
+                    fflush(csv);
+                }
+                if (best_ms[s][o] < 0.0 || r.median_ms < best_ms[s][o]) {
+                    best_ms[s][o] = r.median_ms;
+                    best[s][o] = (SortAlg)a;
+                }
+            }
+        }
     }
-}
 
-// Save the current analysis results to a TXT report and optionally a CSV report.
-void saveResultsToFile(void) {
-    if (!file1Loaded && !file2Loaded) {
-        printf("[!] No text loaded. Use menu 1 first.\n");
-        return;
+    printf("\nFastest by median time:\n%8s", "n");
+    for (int o = 0; o < ORDER_COUNT; o++) printf(" | %-7s", g_bench_order_names[o]);
+    printf("\n");
+    for (int s = 0; s < size_count; s++) {
+        printf("%8d", sizes[s]);
+        for (int o = 0; o < ORDER_COUNT; o++) printf(" | %-7s", g_sort_alg_names[best[s][o]]);
+        printf("\n");
     }
 
-    // Automatically select a valid active source (File 1 / File 2) based on current state.
-    if (!auto_select_source_file()) {
-        printf("[X] No files available. Please load files in Stage 1 first.\n");
-        return;
+    if (csv) {
+        fclose(csv);
+        printf("Saved sort benchmark results to %s\n", out_path);
     }
+    free(ids); free(input); free(work);
+    return 0;
+}
 
-    const char* sourcePath;
-    char (*words)[50];
-    int  wordCount;
+// ----- Differential verification (--verify) -----
+// Runs the optimised paths and plain reference versions side by side on
+// fuzzed corpora: vocabulary counts (add_token_to_analysis), pattern search
+// (vocab_search), token positions (position_index_build), per-token toxicity
+// (is_toxic_word, token_toxicity), severity histograms, the most toxic
+// sentences, detect_toxic_phrases, build_pairs_from_tokens, every sort, the
+// Top-N rows and the written report. Each check stops at its first divergence.
 
-    // Select the path using the current g_use_file 
-    sourcePath = (g_use_file == 1) ? inputFilePath1 : inputFilePath2;
+static SortKey g_verify_key;
+static const int* g_verify_counts;
 
-    // Use pick_tokens，ensure that it have tokens which is same with Stage 4
-    pick_tokens(&words, &wordCount);
+static int cmp_pairs_reference(const void* a, const void* b) {
+    return cmp_pairs((const Pair*)a, (const Pair*)b, g_verify_key);
+}
 
-    if (!words || wordCount <= 0) {
-        printf("[X] No tokens available from current source file.\n");
-        printf("Tip: Make sure you have loaded the file in Stage 1.\n");
-        return;
+// Count descending, then row ascending (the order top_count_rows promises)
+static int cmp_rows_reference(const void* a, const void* b) {
+    int ra = *(const int*)a, rb = *(const int*)b;
+    int ca = g_verify_counts[ra], cb = g_verify_counts[rb];
+    if (ca != cb) return (cb > ca) ? 1 : -1;
+    return (ra > rb) - (ra < rb);
+}
+
+static int verify_fail(int run, uint64_t seed, const char* check) {
+    printf("[X] Run %d (seed %llu) %s: ", run, (unsigned long long)seed, check);
+    return 0;
+}
+
+// Linear scan of the dictionary; first entry wins, as in the hash index
+static int reference_word_index(const char* word) {
+    for (int i = 0; i < g_dict->word_count; i++) {
+        if (strcmp(g_dict->words[i].word, word) == 0) return i;
+    }
+    return -1;
+}
+
+// Uncached toxicity of a lowercased token: exact entry, else its leetspeak
+// decode (lighter run collapse first)
+static int reference_toxicity(const char* word, int* severity, int* dict_index) {
+    int idx = reference_word_index(word);
+    if (idx == -1 && analysis_data.leet_normalisation_enabled && strlen(word) < MAX_WORD_LENGTH) {
+        char decoded[MAX_WORD_LENGTH];
+        for (int max_run = 2; max_run >= 1 && idx == -1; max_run--) {
+            leet_decode(word, decoded, max_run);
+            if (strcmp(decoded, word) != 0) idx = reference_word_index(decoded);
+        }
+    }
+    *dict_index = idx;
+    *severity = (idx == -1) ? 0 : g_dict->words[idx].severity;
+    return idx != -1;
+}
+
+// A fuzzed corpus: Zipf words plus the shapes the fast paths special-case
+// (leetspeak, letter runs, case, hashtags, stopwords, phrases, junk)
+static int verify_generate(const char* path, long long bytes, const struct BenchCorpus* c,
+    const struct BenchOptions* o, uint64_t* rng) {
+    static const char leet_from[] = "aeiost";
+    static const char* const leet_to[] = { "4@", "3", "1!", "0", "5$", "7" };
+    static const char punct[] = ".,!?;:\"()-#@*";
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        printf("Error: Cannot create %s\n", path);
+        return 0;
     }
 
+    long long written = 0;
+    char word[MAX_WORD_LENGTH * 3 + 8];
+    while (written < bytes) {
+        int kind = (int)(bench_rand(rng) % 100);
+        const char* base = bench_next_word(c, o, rng);
+        if (kind < 8 && analysis_data.stop_count > 0) {
+            base = analysis_data.stopwords[bench_rand(rng) % (uint64_t)analysis_data.stop_count];
+        }
+        else if (kind < 14 && g_dict->phrase_count > 0) {
+            base = g_dict->phrases[bench_rand(rng) % (uint64_t)g_dict->phrase_count].phrase;
+        }
+        else if (kind < 20 && c->toxic_count > 0) {
+            base = c->toxic[bench_rand(rng) % (uint64_t)c->toxic_count];
+        }
+        strncpy(word, base, sizeof(word) - 8);
+        word[sizeof(word) - 8] = '\0';
 
-    // 2. Clean up the filename entered by the user.
-    char base[512];
-    strncpy(base, outputFilePath, sizeof(base) - 1);
-    base[sizeof(base) - 1] = '\0';
-    strip_quotes(base);
+        size_t len = strlen(word);
+        int mutation = (int)(bench_rand(rng) % 100);
+        if (mutation < 10) {                    // Leetspeak
+            for (size_t i = 0; i < len; i++) {
+                const char* p = strchr(leet_from, word[i]);
+                if (p && (bench_rand(rng) & 1)) {
+                    const char* to = leet_to[p - leet_from];
+                    word[i] = to[bench_rand(rng) % strlen(to)];
+                }
+            }
+        }
+        else if (mutation < 14 && len > 0 && len < 40) { // Letter run ("shiiit")
+            size_t at = bench_rand(rng) % len;
+            int extra = 1 + (int)(bench_rand(rng) % 3);
+            memmove(word + at + extra, word + at, len - at + 1);
+            memset(word + at, word[at + extra], extra);
+        }
+        else if (mutation < 18) {               // Case
+            for (size_t i = 0; i < len; i++) if (bench_rand(rng) & 1) word[i] = (char)toupper((unsigned char)word[i]);
+        }
+        else if (mutation < 21) {               // Hashtag or mention
+            memmove(word + 1, word, len + 1);
+            word[0] = (bench_rand(rng) & 1) ? '#' : '@';
+        }
+        else if (mutation < 23) {               // Junk: digits, symbols, over-long words
+            int n = 1 + (int)(bench_rand(rng) % (MAX_WORD_LENGTH + 10));
+            for (int i = 0; i < n; i++) word[i] = (char)('!' + bench_rand(rng) % 94);
+            word[n] = '\0';
+        }
 
-    // If the user did not provide an extension, default to .txt.
-    char* dot = strrchr(base, '.');
-    if (dot == NULL) {
-        strcat(base, ".txt");
+        written += fprintf(f, "%s", word);
+        if (bench_rand(rng) % 6 == 0) {
+            fputc(punct[bench_rand(rng) % (sizeof(punct) - 1)], f);
+            written++;
+        }
+        fputc((bench_rand(rng) % 12 == 0) ? '\n' : ' ', f);
+        written++;
     }
+    return fclose(f) == 0;
+}
 
-    // At this point, `base` is guaranteed to be of the form name.xxx.
-    // First build txt_path.
-    char txt_path[512];
-    strncpy(txt_path, base, sizeof(txt_path) - 1);
-    txt_path[sizeof(txt_path) - 1] = '\0';
+// Filtered list and vocabulary against a direct-addressed recount
+static int verify_vocabulary(int run, uint64_t seed) {
+    const uint32_t* ids = analysis_data.filtered_word_ids;
+    int n = analysis_data.filtered_word_count;
+    int* ref = (int*)stage_calloc(g_intern_count + 1, sizeof(int));
+    if (!ref) return 1;
+
+    int ok = 1, distinct = 0;
+    long long chars = 0;
+    for (int i = 0; i < n && ok; i++) {
+        const char* w = token_text(ids[i]);
+        int letters = 0;
+        for (const char* p = w; *p; p++) if (ISALPHA(*p)) { letters = 1; break; }
+        if (!letters || is_stopword((char*)w, analysis_data.stopwords, analysis_data.stop_count)) {
+            ok = verify_fail(run, seed, "add_token_to_analysis");
+            printf("token %d \"%s\" should have been filtered out\n", i, w);
+        }
+        if (ref[ids[i]]++ == 0) distinct++;
+        chars += (long long)strlen(w);
+    }
+    if (ok && (n != analysis_data.total_words_filtered || chars != analysis_data.total_chars)) {
+        ok = verify_fail(run, seed, "add_token_to_analysis");
+        printf("totals %d words / %d chars, reference %d / %lld\n",
+            analysis_data.total_words_filtered, analysis_data.total_chars, n, chars);
+    }
+    if (ok && analysis_data.vocab_dropped == 0 && distinct != analysis_data.vocab.size) {
+        ok = verify_fail(run, seed, "add_token_to_analysis");
+        printf("%d unique words, reference %d\n", analysis_data.vocab.size, distinct);
+    }
+    for (int r = 0; r < analysis_data.vocab.size && ok; r++) {
+        uint32_t id = analysis_data.vocab.ids[r];
+        if (analysis_data.vocab.counts[r] != ref[id]) {
+            ok = verify_fail(run, seed, "add_token_to_analysis");
+            printf("row %d \"%s\" counted %d, reference %d\n", r, token_text(id), analysis_data.vocab.counts[r], ref[id]);
+        }
+    }
+    free(ref);
+    return ok;
+}
 
-    // Then derive csv_path from txt_path by changing the extension to .csv.
-    char csv_path[512];
-    strncpy(csv_path, txt_path, sizeof(csv_path) - 1);
-    csv_path[sizeof(csv_path) - 1] = '\0';
+// Position lists decoded in token order must give back 0, 1, 2, ...
+static int verify_positions(int run, uint64_t seed) {
+    const struct PositionIndex* pi = &analysis_data.positions;
+    const uint32_t* ids = analysis_data.original_word_ids;
+    int n = analysis_data.original_word_count;
+    if (!pi->gaps) {
+        int ok = verify_fail(run, seed, "position_index_build");
+        printf("no index was built\n");
+        return ok;
+    }
+
+    const unsigned char** cursor = (const unsigned char**)stage_malloc(sizeof(*cursor) * (pi->ids + 1));
+    int* last = (int*)stage_malloc(sizeof(int) * (pi->ids + 1));
+    int* seen = (int*)stage_calloc(pi->ids + 1, sizeof(int));
+    if (!cursor || !last || !seen) {
+        free(cursor); free(last); free(seen);
+        return 1;
+    }
+    for (uint32_t id = 0; id < pi->ids; id++) {
+        cursor[id] = pi->gaps + pi->start[id];
+        last[id] = -1;
+    }
 
-    char* dot2 = strrchr(csv_path, '.');
-    if (dot2 != NULL) {
-        strcpy(dot2, ".csv");
+    int ok = 1;
+    for (int i = 0; i < n && ok; i++) {
+        uint32_t id = ids[i];
+        if (id >= pi->ids || seen[id] == pi->freq[id]) {
+            ok = verify_fail(run, seed, "position_index_build");
+            printf("token %d \"%s\" is missing from the index\n", i, token_text(id));
+            break;  // Its cursor is past the list (or does not exist)
+        }
+        position_next(&cursor[id], &last[id]);
+        seen[id]++;
+        if (last[id] != i) {
+            ok = verify_fail(run, seed, "position_index_build");
+            printf("\"%s\" decoded position %d, expected %d\n", token_text(id), last[id], i);
+        }
     }
-    else {
-        strcat(csv_path, ".csv");
+    for (uint32_t id = 0; id < pi->ids && ok; id++) {
+        if (seen[id] != pi->freq[id] || cursor[id] != pi->gaps + pi->start[id + 1]) {
+            ok = verify_fail(run, seed, "position_index_build");
+            printf("\"%s\" has %d indexed positions, reference %d\n", token_text(id), pi->freq[id], seen[id]);
+        }
     }
+    free(cursor); free(last); free(seen);
+    return ok;
+}
 
-    // ===== 3. Generate the TXT report first. =====
-#ifdef _WIN32
-    FILE* f_txt = fopen_u8(txt_path, "w");
-#else
-    FILE* f_txt = fopen(txt_path, "w");
-#endif
-    if (!f_txt) {
-        printf("[!] Error: Cannot create output file '%s'\n", txt_path);
-        perror("Detailed error");
-        handleError("Cannot open text output file");
-        return;
+// Recursive glob, the textbook definition of '*' and '?'
+static int reference_wildcard(const char* pattern, const char* word) {
+    if (*pattern == '\0') return *word == '\0';
+    if (*pattern == '*') {
+        return reference_wildcard(pattern + 1, word) ||
+            (*word && reference_wildcard(pattern, word + 1));
+    }
+    if (*word && (*pattern == '?' || *pattern == *word)) {
+        return reference_wildcard(pattern + 1, word + 1);
     }
+    return 0;
+}
 
-    write_full_report(f_txt, sourcePath, words, wordCount);
-    fclose(f_txt);
-    printf("\nSaved TEXT report to %s\n", txt_path);
+// vocab_search against a linear scan, on patterns cut from vocabulary words
+static int verify_search(int run, uint64_t seed) {
+    const struct VocabTable* v = &analysis_data.vocab;
+    if (v->size == 0) return 1;
+    int* ref = (int*)stage_malloc(sizeof(int) * v->size);
+    if (!ref) return 1;
+
+    uint64_t rng = bench_seed(seed ^ 0x5EA4C4ull);
+    int ok = 1;
+    for (int q = 0; q < VERIFY_SEARCH_QUERIES && ok; q++) {
+        const char* w = vocab_text(v, (int)(bench_rand(&rng) % v->size));
+        int len = (int)strlen(w);
+        int k = 1 + (int)(bench_rand(&rng) % len);
+        char pattern[MAX_WORD_LENGTH + 2];
+        switch (q % 5) {
+        case 0: snprintf(pattern, sizeof(pattern), "%.*s*", k, w); break;           // Prefix
+        case 1: snprintf(pattern, sizeof(pattern), "*%s", w + len - k); break;      // Suffix
+        case 2: snprintf(pattern, sizeof(pattern), "%.1s*%s", w, w + len - 1); break;
+        case 3:                                                                     // One '?'
+            snprintf(pattern, sizeof(pattern), "%s", w);
+            pattern[k - 1] = '?';
+            break;
+        default: snprintf(pattern, sizeof(pattern), "*%.*s*", k < 3 ? k : 3, w + (len - k)); break;
+        }
 
-    // ===== 4. Ask the user whether a CSV version is also needed. =====
-    printf("Do you also want a CSV version for spreadsheets? (y/n): ");
-    char ans[16];
-    if (!read_line(ans, sizeof(ans))) {
-        // If input cannot be read, treat it as "no".
-        return;
+        int* rows;
+        int n = vocab_search(&analysis_data.search, pattern, &rows);
+        if (n < 0) break;
+        int m = 0;
+        for (int r = 0; r < v->size; r++) {
+            if (reference_wildcard(pattern, vocab_text(v, r))) ref[m++] = r;
+        }
+        qsort(ref, m, sizeof(int), cmp_search_word);
+        if (n != m || memcmp(rows, ref, sizeof(int) * n) != 0) {
+            ok = verify_fail(run, seed, "vocab_search");
+            printf("'%s' matched %d words, reference %d\n", pattern, n, m);
+        }
+        free(rows);
     }
+    free(ref);
+    return ok;
+}
 
-    if (ans[0] != 'y' && ans[0] != 'Y') {
-        printf("CSV report not generated.\n");
-        return;
+// The heap's ranking against scoring every sentence and sorting them all
+static int verify_toxic_sentences(int run, uint64_t seed, const uint32_t* ids, int n) {
+    const struct PositionIndex* pi = &analysis_data.positions;
+    if (!pi->sentence_filtered || pi->sentences == 0) return 1;
+    struct ToxicSentence* all = (struct ToxicSentence*)stage_malloc(sizeof(struct ToxicSentence) * pi->sentences);
+    if (!all) return 1;
+
+    int m = 0;
+    for (int k = 0; k < pi->sentences; k++) {
+        int from = pi->sentence_filtered[k];
+        int to = (k + 1 < pi->sentences) ? pi->sentence_filtered[k + 1] : n;
+        struct ToxicSentence ts = { k, 0, 0, to - from };
+        for (int i = from; i < to; i++) {
+            const struct TokenToxicity* t = token_toxicity(ids[i]);
+            if (!t->toxic) continue;
+            ts.toxic++;
+            if (t->severity >= 1 && t->severity <= 5 && t->severity > ts.max_severity) ts.max_severity = t->severity;
+        }
+        if (ts.toxic > 0) all[m++] = ts;
+    }
+    qsort(all, m, sizeof(struct ToxicSentence), cmp_toxic_sentence);
+
+    int ok = 1;
+    int expect = m < TOXIC_SENTENCES_TOP ? m : TOXIC_SENTENCES_TOP;
+    if (analysis_data.top_sentence_count != expect) {
+        ok = verify_fail(run, seed, "toxic_sentence_offer");
+        printf("%d sentences ranked, reference %d\n", analysis_data.top_sentence_count, expect);
+    }
+    for (int i = 0; i < expect && ok; i++) {
+        const struct ToxicSentence* a = &analysis_data.top_sentences[i];
+        if (memcmp(a, &all[i], sizeof(*a)) != 0) {
+            ok = verify_fail(run, seed, "toxic_sentence_offer");
+            printf("rank %d: sentence %d (%d toxic), reference sentence %d (%d toxic)\n",
+                i + 1, a->sentence + 1, a->toxic, all[i].sentence + 1, all[i].toxic);
+        }
     }
+    free(all);
+    return ok;
+}
 
-    // ===== 5. Generate the CSV report. =====
-#ifdef _WIN32
-    FILE* f_csv = fopen_u8(csv_path, "w");
-#else
-    FILE* f_csv = fopen(csv_path, "w");
-#endif
-    if (!f_csv) {
-        printf("[!] Error: Cannot create CSV file '%s'\n", csv_path);
-        perror("Detailed error");
-        handleError("Cannot open CSV output file");
-        return;
+// Hotspot windows against summing every window directly from the verdicts
+static int verify_hotspots(int run, uint64_t seed, const uint32_t* ids, int n, const unsigned char* lut) {
+    if (n == 0) return 1;
+    int* toxic = (int*)stage_malloc(sizeof(int) * n);
+    int* score = (int*)stage_malloc(sizeof(int) * n);
+    if (!toxic || !score) {
+        free(toxic);
+        free(score);
+        return 1;
     }
 
-    write_full_report(f_csv, sourcePath, words, wordCount);
-    fclose(f_csv);
-    printf("Saved CSV report to %s\n", csv_path);
+    uint64_t rng = bench_seed(seed ^ 0x407590ull);
+    int ok = 1;
+    for (int q = 0; q < VERIFY_HOTSPOT_WINDOWS && ok; q++) {
+        // Single words, the whole list, past the end, and random sizes
+        int window = q == 0 ? 1 : q == 1 ? n : q == 2 ? n + 3 : 1 + (int)(bench_rand(&rng) % 64);
+        int w = window < n ? window : n;
+        int k = 1 + (int)(bench_rand(&rng) % HOTSPOT_TOP_MAX);
+        for (int s = 0; s + w <= n; s++) {
+            toxic[s] = score[s] = 0;
+            for (int i = s; i < s + w; i++) {
+                const struct TokenToxicity* t = token_toxicity(ids[i]);
+                if (!t->toxic) continue;
+                toxic[s]++;
+                score[s] += (t->severity >= 1 && t->severity <= 5) ? t->severity : 1;
+            }
+        }
 
-    // Console output summary
-    printf("Your reports include:\n");
-    printf(" - TEXT report: %s\n", txt_path);
-    printf(" - CSV  report: %s\n", csv_path);
-}
+        // Same greedy pick, over the direct sums
+        struct ToxicHotspot ref[HOTSPOT_TOP_MAX], got[HOTSPOT_TOP_MAX];
+        int m = 0;
+        while (m < k) {
+            int best = -1;
+            for (int s = 0; s + w <= n; s++) {
+                int free_window = toxic[s] > 0;
+                for (int j = 0; j < m && free_window; j++) free_window = (s >= ref[j].start + w || ref[j].start >= s + w);
+                if (!free_window) continue;
+                if (best < 0 || score[s] > score[best] || (score[s] == score[best] && toxic[s] > toxic[best])) best = s;
+            }
+            if (best < 0) break;
+            ref[m].start = best;
+            ref[m].toxic = toxic[best];
+            ref[m].score = score[best];
+            m++;
+        }
 
+        int found = toxic_hotspots(ids, n, lut, window, k, got);
+        if (found != m || memcmp(got, ref, sizeof(struct ToxicHotspot) * m) != 0) {
+            ok = verify_fail(run, seed, "toxic_hotspots");
+            printf("window %d, top %d: %d found, reference %d", window, k, found, m);
+            if (found > 0 && m > 0) printf(" (first at %d score %d, reference %d score %d)",
+                got[0].start, got[0].score, ref[0].start, ref[0].score);
+            printf("\n");
+        }
+    }
+    free(toxic);
+    free(score);
+    return ok;
+}
 
-// ===== 7. Stage 4/6 - Sorting & Reporting Main Menu (User Interaction)
+// Per-token verdicts, then the histogram kernel and score_toxic_tokens
+static int verify_toxicity(int run, uint64_t seed) {
+    const uint32_t* lists[2] = { analysis_data.original_word_ids, analysis_data.filtered_word_ids };
+    int sizes[2] = { analysis_data.original_word_count, analysis_data.filtered_word_count };
+    for (int l = 0; l < 2; l++) {
+        for (int i = 0; i < sizes[l]; i++) {
+            const char* w = token_text(lists[l][i]);
+            int sev, idx;
+            int toxic = reference_toxicity(w, &sev, &idx);
+            const struct TokenToxicity* t = token_toxicity(lists[l][i]);
+            if (is_toxic_word(w) != toxic || t->toxic != toxic || t->severity != sev || t->dict_index != idx) {
+                verify_fail(run, seed, "is_toxic_word/token_toxicity");
+                printf("\"%s\": fast toxic=%d/%d severity %d entry %d, reference toxic=%d severity %d entry %d\n",
+                    w, is_toxic_word(w), t->toxic, t->severity, t->dict_index, toxic, sev, idx);
+                return 0;
+            }
+        }
+    }
 
-// Show the sorting & reporting menu and dispatch user commands.
-void menu_sort_and_report(void) {
-    int sub = -1;
-    if (!auto_select_source_file()) {
-        // No files available → show a message and return directly to the main menu.
-        printf("\n[X] No files available for sorting/reporting. "
-            "Please load files in Stage 1 first.\n");
-        return;
+    const uint32_t* ids = analysis_data.filtered_word_ids;
+    int n = analysis_data.filtered_word_count;
+    const unsigned char* lut = build_severity_lut(&analysis_data.vocab);
+    if (!lut || analysis_data.vocab_dropped > 0) return 1;
+
+    // Every tail length, so the vector and unrolled loops both finish early;
+    // the last pass (cut == 0) leaves the full-list counts in ref
+    int ref[SEVERITY_CLASSES];
+    for (int cut = (n < 8 ? n : 8); cut >= 0; cut--) {
+        memset(ref, 0, sizeof(ref));
+        for (int i = 0; i < n - cut; i++) {
+            const struct TokenToxicity* t = token_toxicity(ids[i]);
+            ref[toxicity_class(t->toxic, t->severity)]++;
+        }
+        int hist[SEVERITY_CLASSES];
+        severity_histogram(ids, n - cut, lut, hist);
+        for (int c = 0; c < SEVERITY_CLASSES; c++) {
+            if (hist[c] != ref[c]) {
+                verify_fail(run, seed, "severity_histogram");
+                printf("%d tokens, class %d: %d, reference %d\n", n - cut, c, hist[c], ref[c]);
+                return 0;
+            }
+        }
     }
-    do {
-        // On each loop, confirm the current source (in case Stage 1 changed the active file).
-        if (!auto_select_source_file()) {
-            printf("\n[X] No files available.\n");
-            return;
+
+    // Whole list, then sentence by sentence: the totals must not change
+    const struct PositionIndex* pi = &analysis_data.positions;
+    for (int by_sentence = 0; by_sentence < 2; by_sentence++) {
+        if (by_sentence) score_toxic_tokens(ids, n, &analysis_data.vocab, pi->sentence_filtered, pi->sentences);
+        else score_toxic_tokens(ids, n, &analysis_data.vocab, NULL, 0);
+        int total = 0;
+        for (int c = 1; c < SEVERITY_CLASSES; c++) total += ref[c];
+        if (analysis_data.total_toxic_occurrences != total) {
+            verify_fail(run, seed, "score_toxic_tokens");
+            printf("total %d, reference %d\n", analysis_data.total_toxic_occurrences, total);
+            return 0;
+        }
+        for (int c = 1; c <= 5; c++) {
+            if (analysis_data.severity_count[c] != ref[c]) {
+                verify_fail(run, seed, "score_toxic_tokens");
+                printf("severity %d: %d, reference %d\n", c, analysis_data.severity_count[c], ref[c]);
+                return 0;
+            }
         }
+    }
+    int ok = verify_toxic_sentences(run, seed, ids, n);
+    return verify_hotspots(run, seed, ids, n, lut) && ok;
+}
 
-        const char* activePath = (g_use_file == 1)
-            ? inputFilePath1
-            : inputFilePath2;
-        printf("\n=== Sorting & Reporting ===\n");
-        printf("Current source file      : %s (%s)\n",
-            (g_use_file == 1) ? "File 1" : "File 2",
-            activePath);
-        printf("----------------------------------------\n");
-        printf("1. Set sort KEY (current: %s)\n",
-            g_key == KEY_FREQ_DESC ? "Frequency in descending" : "Alphabetical (A->Z)");
-        printf("2. Set sort ALGORITHM (current: %s)\n",
-            g_alg == ALG_BUBBLE ? "Bubble" : (g_alg == ALG_QUICK ? "Quick" : "Merge"));
-        printf("3. Toggle secondary tiebreak (current: %s)\n",
-            g_use_secondary_tiebreak ? "ON (alpha as tiebreak)" : "OFF (pure primary key)");
-        printf("4. Set Top N (current: %d)\n", g_topN);
-        printf("5. Show Top N (ALL words)\n");
-        printf("6. Show Top N (TOXIC words only)\n");
-        printf("7. Compare algorithms (Top N)\n");
-        printf("8. Extra summary (toxic ratio)\n");
-        printf("9  List ALL words alphabetically\n");
-        printf("0. Back\n");
-        printf("Select: ");
+// detect_toxic_phrases against string building and a linear phrase scan
+static int verify_phrases(int run, uint64_t seed) {
+    reset_toxic_counts();
+    detect_toxic_phrases();
 
-        if (scanf("%d", &sub) != 1) {
-            int c;
-            while ((c = getchar()) != '\n' && c != EOF);
-            printf("Invalid input. Please enter 0-9.\n");
-            sub = -1;
-            continue;
+    int* ref = (int*)stage_calloc(g_dict->phrase_count + 1, sizeof(int));
+    if (!ref) return 1;
+    const uint32_t* ids = analysis_data.original_word_ids;
+    int n = analysis_data.original_word_count;
+    int bigrams = 0, trigrams = 0;
+    char text[MAX_WORD_LENGTH * 3 + 4];
+    for (int i = 0; i + 1 < n; i++) {
+        for (int len = 2; len <= 3 && i + len <= n; len++) {
+            text[0] = '\0';
+            for (int k = 0; k < len; k++) {
+                if (k) strcat(text, " ");
+                strcat(text, token_text(ids[i + k]));
+            }
+            for (int p = 0; p < g_dict->phrase_count; p++) {
+                if (g_dict->phrases[p].ngram_len == len && strcmp(g_dict->phrases[p].phrase, text) == 0) {
+                    ref[p]++;
+                    if (len == 2) bigrams++;
+                    else trigrams++;
+                    break;
+                }
+            }
         }
+    }
 
-        int c;
-        while ((c = getchar()) != '\n' && c != EOF);
+    int ok = 1;
+    if (analysis_data.bigram_toxic_occurrences != bigrams || analysis_data.trigram_toxic_occurrences != trigrams) {
+        ok = verify_fail(run, seed, "detect_toxic_phrases");
+        printf("%d bigrams / %d trigrams, reference %d / %d\n",
+            analysis_data.bigram_toxic_occurrences, analysis_data.trigram_toxic_occurrences, bigrams, trigrams);
+    }
+    for (int p = 0; p < g_dict->phrase_count && ok; p++) {
+        if (g_dict->phrases[p].frequency != ref[p]) {
+            ok = verify_fail(run, seed, "detect_toxic_phrases");
+            printf("\"%s\" counted %d, reference %d\n", g_dict->phrases[p].phrase, g_dict->phrases[p].frequency, ref[p]);
+        }
+    }
+    free(ref);
+    return ok;
+}
 
+// build_pairs_from_tokens (with and without hitting the row cap), every
+// SortAlg against qsort, and top_count_rows against a full sort
+static int verify_pairs_and_sorts(int run, uint64_t seed) {
+    const uint32_t* ids = analysis_data.original_word_ids;
+    int n = analysis_data.original_word_count;
+    Pair* fast = (Pair*)stage_malloc(sizeof(Pair) * BENCH_MAX_PAIRS);
+    Pair* ref = (Pair*)stage_malloc(sizeof(Pair) * BENCH_MAX_PAIRS);
+    Pair* sorted = (Pair*)stage_malloc(sizeof(Pair) * BENCH_MAX_PAIRS);
+    int* row_of = (int*)stage_malloc(sizeof(int) * (g_intern_count + 1));
+    int ok = fast && ref && sorted && row_of;
+
+    static const int caps[] = { 50, BENCH_MAX_PAIRS };
+    int rows = 0;
+    for (int c = 0; c < 2 && ok; c++) {
+        for (uint32_t i = 0; i <= g_intern_count; i++) row_of[i] = -1;
+        rows = 0;
+        for (int i = 0; i < n; i++) {
+            if (row_of[ids[i]] == -1) {
+                if (rows == caps[c]) break;
+                row_of[ids[i]] = rows;
+                ref[rows].id = ids[i];
+                ref[rows++].count = 0;
+            }
+            ref[row_of[ids[i]]].count++;
+        }
+        int got = build_pairs_from_tokens(ids, n, fast, caps[c]);
+        if (got != rows) {
+            ok = verify_fail(run, seed, "build_pairs_from_tokens");
+            printf("cap %d: %d pairs, reference %d\n", caps[c], got, rows);
+        }
+        for (int r = 0; r < rows && ok; r++) {
+            if (fast[r].id != ref[r].id || fast[r].count != ref[r].count) {
+                ok = verify_fail(run, seed, "build_pairs_from_tokens");
+                printf("cap %d, pair %d: \"%s\" x%d, reference \"%s\" x%d\n", caps[c], r,
+                    token_text(fast[r].id), fast[r].count, token_text(ref[r].id), ref[r].count);
+            }
+        }
+    }
 
-        switch (sub) {
-        case 1: {
-            // Configure sorting key (frequency or alphabetical).
-            int k;
-            printf("Choose key: 1=Frequency desc, 2=Alphabetical : ");
-            if (scanf("%d", &k) == 1) {
-                g_key = (k == 2 ? KEY_ALPHA : KEY_FREQ_DESC);
+    // ref holds the uncapped pairs; the tiebreak makes the order total
+    int saved_tiebreak = g_use_secondary_tiebreak;
+    g_use_secondary_tiebreak = 1;
+    for (int k = KEY_FREQ_DESC; k <= KEY_ALPHA && ok; k++) {
+        g_verify_key = (SortKey)k;
+        memcpy(sorted, ref, sizeof(Pair) * rows);
+        qsort(sorted, rows, sizeof(Pair), cmp_pairs_reference);
+        for (int a = ALG_BUBBLE; a <= ALG_AUTO && ok; a++) {
+            memcpy(fast, ref, sizeof(Pair) * rows);
+            sort_pairs(fast, rows, (SortKey)k, (SortAlg)a);
+            for (int r = 0; r < rows; r++) {
+                if (fast[r].id != sorted[r].id || fast[r].count != sorted[r].count) {
+                    ok = verify_fail(run, seed, "sort_pairs");
+                    printf("%s, key %s, rank %d: \"%s\" x%d, reference \"%s\" x%d\n",
+                        g_sort_alg_names[a], k == KEY_FREQ_DESC ? "freq" : "alpha", r + 1,
+                        token_text(fast[r].id), fast[r].count, token_text(sorted[r].id), sorted[r].count);
+                    break;
+                }
             }
-            else {
-                printf("Invalid key choice.\n");
+        }
+    }
+    g_use_secondary_tiebreak = saved_tiebreak;
+
+    // Top-N rows of the vocabulary table
+    const struct VocabTable* v = &analysis_data.vocab;
+    int* top = ok ? (int*)stage_malloc(sizeof(int) * (v->size + 1)) : NULL;
+    int* all = ok ? (int*)stage_malloc(sizeof(int) * (v->size + 1)) : NULL;
+    if (top && all) {
+        int m = 0;
+        for (int r = 0; r < v->size; r++) if (v->counts[r] > 0) all[m++] = r;
+        g_verify_counts = v->counts;
+        qsort(all, m, sizeof(int), cmp_rows_reference);
+        static const int ks[] = { 1, 10, 100 };
+        for (int t = 0; t < 3 && ok; t++) {
+            int want = ks[t] < m ? ks[t] : m;
+            int got = top_count_rows(v->counts, v->size, ks[t], top);
+            if (got != want) {
+                ok = verify_fail(run, seed, "top_count_rows");
+                printf("top %d: %d rows, reference %d\n", ks[t], got, want);
             }
-            while ((c = getchar()) != '\n' && c != EOF);
-        } break;
-        case 2: {
-            //Configure sorting algorithm (Bubble / Quick / Merge).
-            int a;
-            printf("Choose algorithm: 1=Bubble  2=Quick  3=Merge : ");
-            if (scanf("%d", &a) == 1) {
-                if (a == 1) g_alg = ALG_BUBBLE;
-                else if (a == 3) g_alg = ALG_MERGE;
-                else g_alg = ALG_QUICK;
+            for (int r = 0; r < want && ok; r++) {
+                if (top[r] != all[r]) {
+                    ok = verify_fail(run, seed, "top_count_rows");
+                    printf("top %d, rank %d: \"%s\" x%d, reference \"%s\" x%d\n", ks[t], r + 1,
+                        vocab_text(v, top[r]), v->counts[top[r]], vocab_text(v, all[r]), v->counts[all[r]]);
+                }
+            }
+        }
+    }
+    free(top); free(all);
+    free(fast); free(ref); free(sorted); free(row_of);
+    return ok;
+}
+
+// The report must not depend on what the caches held: write it warm, drop
+// every dictionary-derived cache, write it again and compare line by line
+// up to the timing section.
+static int verify_report(int run, uint64_t seed, const char* source) {
+    static const char* const paths[2] = { "verify_report_a.txt", "verify_report_b.txt" };
+    for (int p = 0; p < 2; p++) {
+        FILE* f = fopen(paths[p], "w");
+        if (!f) return 1;
+        int muted = bench_mute();
+        write_full_report(f, source, analysis_data.original_word_ids, analysis_data.original_word_count);
+        bench_unmute(muted);
+        fclose(f);
+        toxic_dict_changed();
+    }
+
+    FILE* a = fopen(paths[0], "r");
+    FILE* b = fopen(paths[1], "r");
+    int ok = 1;
+    char la[1024], lb[1024];
+    for (int line = 1; a && b && ok; line++) {
+        char* ra = fgets(la, sizeof(la), a);
+        char* rb = fgets(lb, sizeof(lb), b);
+        if (!ra || !rb) {
+            if (ra || rb) {
+                ok = verify_fail(run, seed, "write_full_report");
+                printf("one report ends at line %d\n", line);
             }
-        } break;
-        case 3:
-            g_use_secondary_tiebreak = !g_use_secondary_tiebreak;
-            printf("Secondary tiebreak is now %s\n",
-                g_use_secondary_tiebreak ? "ON" : "OFF");
-            break;
-        case 4: {
-            //Configure Top N value for reporting.
-            int n;
-            printf("Enter Top N (>=1): ");
-            if (scanf("%d", &n) == 1 && n > 0) g_topN = n;
-        } break;
-        case 5:
-            //Show Top N words across all tokens.
-            sort_and_show_topN_all(g_key, g_alg, g_topN);
-            break;
-        case 6:
-            //Show Top N toxic words only; typically sorted by frequency desc.
-            sort_and_show_topN_toxic(g_alg, g_topN);
-            break;
-        case 7:
-            compare_algorithms_topN(g_topN);
-            break;
-        case 8:
-            show_extra_summary();
-            break;
-        case 9:
-            list_alpha_all();
             break;
-        case 0:
+        }
+        if (strncmp(la, "Stage Timings", 13) == 0) break;
+        if (strncmp(la, "Last sort time", 14) == 0) continue;
+        if (strcmp(la, lb) != 0) {
+            ok = verify_fail(run, seed, "write_full_report");
+            printf("line %d differs:\n    warm: %s    cold: %s", line, la, lb);
+        }
+    }
+    if (a) fclose(a);
+    if (b) fclose(b);
+    remove(paths[0]);
+    remove(paths[1]);
+    return ok;
+}
+
+// Entry point for --verify. Options: --runs N, --size KB, --vocab N,
+// --seed N, --keep (keep the corpus of a failing run).
+int run_verify_mode(int argc, char** argv) {
+    struct BenchOptions o;
+    memset(&o, 0, sizeof(o));
+    o.vocab = VERIFY_VOCAB_DEFAULT;
+    o.zipf = BENCH_ZIPF_DEFAULT;
+    o.toxic_rate = BENCH_TOXIC_RATE_DEFAULT;
+    int runs = VERIFY_RUNS_DEFAULT, size_kb = VERIFY_SIZE_KB_DEFAULT, seed = 1;
+
+    for (int i = 0; i < argc; i++) {
+        const char* opt = argv[i];
+        const char* val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        int ok = 1;
+        if (strcmp(opt, "--runs") == 0)       ok = parse_stream_int(val, 1, 100000, &runs), i++;
+        else if (strcmp(opt, "--size") == 0)  ok = parse_stream_int(val, 1, MAX_TEXT_LENGTH / 1024 - 1, &size_kb), i++;
+        else if (strcmp(opt, "--vocab") == 0) ok = parse_stream_int(val, 1, 1000000, &o.vocab), i++;
+        else if (strcmp(opt, "--seed") == 0)  ok = parse_stream_int(val, 0, 0x7FFFFFFF, &seed), i++;
+        else if (strcmp(opt, "--keep") == 0)  o.keep = 1;
+        else {
+            printf("Error: Unknown verify option: %s\n", opt);
+            return 1;
+        }
+        if (!ok) {
+            printf("Error: Invalid value for %s\n", opt);
+            return 1;
+        }
+    }
+
+    int muted = bench_mute();
+    struct BenchCorpus corpus;
+    int ready = bench_corpus_init(&corpus, &o);
+    analysis_data.stop_count = load_stopwords(analysis_data.stopwords);
+    bench_unmute(muted);
+    if (!ready) return 1;
+
+    const char* path = "verify_corpus.txt";
+    int failures = 0;
+    printf("Verifying %d fuzzed corpora of %d KB (seed %d)...\n", runs, size_kb, seed);
+    for (int run = 0; run < runs; run++) {
+        uint64_t run_seed = (uint64_t)seed + (uint64_t)run;
+        uint64_t rng = bench_seed(run_seed);
+        o.seed = run_seed;
+
+        // Alternate the settings that change which paths run
+        analysis_data.leet_normalisation_enabled = (run % 2) == 0;
+        analysis_data.variant_processing_enabled = (run % 3) != 2;
+
+        muted = bench_mute();
+        int made = verify_generate(path, (long long)size_kb * 1024, &corpus, &o, &rng);
+        if (made) process_text_file(path);
+        bench_unmute(muted);
+        if (!made || !analysis_data.text_filtered) {
+            printf("[X] Run %d (seed %llu): the pipeline did not produce a filtered list\n",
+                run, (unsigned long long)run_seed);
+            failures++;
             break;
-        default:
-            printf("Invalid choice. Please enter 0-9.\n");
         }
-    } while (sub != 0);
+
+        int ok = verify_vocabulary(run, run_seed);
+        ok = verify_search(run, run_seed) && ok;
+        ok = verify_positions(run, run_seed) && ok;
+        ok = verify_toxicity(run, run_seed) && ok;
+        ok = verify_phrases(run, run_seed) && ok;
+        ok = verify_pairs_and_sorts(run, run_seed) && ok;
+        ok = verify_report(run, run_seed, path) && ok;
+        if (!ok) {
+            failures++;
+            if (o.keep) {
+                char kept[64];
+                snprintf(kept, sizeof(kept), "verify_fail_%llu.txt", (unsigned long long)run_seed);
+                rename(path, kept);
+                printf("    Corpus kept as %s\n", kept);
+            }
+        }
+    }
+    remove(path);
+
+    if (failures == 0) printf("All %d runs match the reference implementations.\n", runs);
+    else printf("%d of %d runs diverged.\n", failures, runs);
+    cleanup_analysis_data();
+    bench_corpus_free(&corpus);
+    return failures > 0;
 }
 
-// ====== 8. Start your program ======
-int main() {
+// ====== 10. Start your program ======
+int main(int argc, char** argv) {
     init_basic_variants();
+    init_leet_rules();
+    analysis_data.fuzzy_max_distance = 1;
+
+    // Metrics sink options apply to every mode, the menu included
+    int kept = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-metrics") == 0) {
+            g_metrics_enabled = false;
+        }
+        else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            strncpy(g_metrics_path, argv[++i], sizeof(g_metrics_path) - 1);
+            g_metrics_path[sizeof(g_metrics_path) - 1] = '\0';
+        }
+        else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+
+    // Non-interactive modes
+    int (*mode)(int, char**) = NULL;
+    if (argc > 1) {
+        if (strcmp(argv[1], "--stream") == 0)          mode = run_stream_mode;
+        else if (strcmp(argv[1], "--bench") == 0)      mode = run_bench_mode;
+        else if (strcmp(argv[1], "--bench-sort") == 0) mode = run_sort_bench_mode;
+        else if (strcmp(argv[1], "--verify") == 0)     mode = run_verify_mode;
+    }
+    if (mode) {
+        int rc = mode(argc - 2, argv + 2);
+        toxic_dict_release(g_dict);
+        free_interner();
+        return rc;
+    }
     int userChoice;
 
     for (;;) {
@@ -3799,7 +9241,16 @@ int main() {
         } break;
         case 6:
             printf("Exiting the system... Goodbye!\n");
+            compact_toxic_journal();
             cleanup_analysis_data();
+            toxic_dict_release(g_dict);
+            vocab_free(&g_toxic_vocab);
+            free(g_toxic_ids);
+            free(g_severity_lut);
+            vocab_free(&g_stage4_vocab);
+            sort_hints_free();
+            approx_free(&g_approx);
+            free_interner();
             return 0;
         default:
             printf("Error. %d is an invalid choice. Please enter a number between 1 and 6.\n", userChoice);